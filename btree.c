@@ -397,10 +397,12 @@ static bool imcs_append_page_##TYPE(imcs_page_t** root_page, TYPE val, bool is_t
         if (!imcs_append_page_##TYPE(&child, val, is_timestamp)) {      \
             if (n_items == MAX_NODE_ITEMS(TYPE)) {                      \
                 imcs_page_t* new_page = imcs_new_page();                \
+                int priority = pg->priority;                            \
                 *root_page = new_page;                                  \
                 IMCS_UNLOAD_PAGE(pg);                                   \
                 IMCS_LOAD_NEW_PAGE(new_page);                           \
                 new_page->is_leaf = false;                              \
+                new_page->priority = priority;                          \
                 new_page->n_items = 1;                                  \
                 CHILD(new_page, 0).page = child;                        \
                 CHILD(new_page, 0).count = 1;                           \
@@ -425,10 +427,12 @@ static bool imcs_append_page_##TYPE(imcs_page_t** root_page, TYPE val, bool is_t
         Assert(n_items <= max_items);                                   \
         if (n_items == max_items) {                                     \
             imcs_page_t* new_page = imcs_new_page();                    \
+            int priority = pg->priority;                                \
             *root_page = new_page;                                      \
             IMCS_UNLOAD_PAGE(pg);                                       \
             IMCS_LOAD_NEW_PAGE(new_page);                               \
             new_page->is_leaf = true;                                   \
+            new_page->priority = priority;                              \
             new_page->u.val_##TYPE[0] = val;                            \
             new_page->n_items = 1;                                      \
             IMCS_UNLOAD_PAGE(new_page);                                 \
@@ -449,6 +453,7 @@ void imcs_append_##TYPE(imcs_timeseries_t* ts, TYPE val)                \
         ts->root_page = pg;                                             \
         IMCS_LOAD_NEW_PAGE(pg);                                         \
         pg->is_leaf = true;                                             \
+        pg->priority = ts->priority;                                    \
         pg->u.val_##TYPE[0] = val;                                      \
         ts->count = pg->n_items = 1;                                    \
         IMCS_UNLOAD_PAGE(pg);                                           \
@@ -460,6 +465,7 @@ void imcs_append_##TYPE(imcs_timeseries_t* ts, TYPE val)                \
             ts->root_page = new_root;                                   \
             IMCS_LOAD_NEW_PAGE(new_root);                               \
             new_root->is_leaf = false;                                  \
+            new_root->priority = ts->priority;                          \
             new_root->n_items = 2;                                      \
             CHILD(new_root, 0).page = old_root;                         \
             CHILD(new_root, 0).count = ts->count;                       \
@@ -600,10 +606,12 @@ static bool imcs_append_page_char(imcs_page_t** root_page, char const* val, size
         if (!imcs_append_page_char(&child, val, val_len, elem_size)) {
             if (n_items == MAX_NODE_ITEMS_CHAR()) {
                 imcs_page_t* new_page = imcs_new_page();
+                int priority = pg->priority;
                 *root_page = new_page;
                 IMCS_UNLOAD_PAGE(pg);
                 IMCS_LOAD_NEW_PAGE(new_page);
                 new_page->is_leaf = false;
+                new_page->priority = priority;
                 new_page->n_items = 1;
                 CHILD(new_page, 0).page = child;
                 CHILD(new_page, 0).count = 1;
@@ -622,10 +630,12 @@ static bool imcs_append_page_char(imcs_page_t** root_page, char const* val, size
         Assert(n_items <= max_items);
         if (n_items == max_items) {
             imcs_page_t* new_page = imcs_new_page();
+            int priority = pg->priority;
             *root_page = new_page;
             IMCS_UNLOAD_PAGE(pg);
             IMCS_LOAD_NEW_PAGE(new_page);
             new_page->is_leaf = true;
+            new_page->priority = priority;
             memcpy(new_page->u.val_char, val, val_len);
             memset(new_page->u.val_char + val_len, '\0', elem_size - val_len);
             new_page->n_items = 1;
@@ -653,10 +663,12 @@ static bool imcs_append_page_char_rle(imcs_page_t** root_page, char const* val,
         if (!imcs_append_page_char_rle(&child, val, val_len, elem_size)) {
             if (n_items == MAX_NODE_ITEMS_CHAR()) {
                 imcs_page_t* new_page = imcs_new_page();
+                int priority = pg->priority;
                 *root_page = new_page;
                 IMCS_UNLOAD_PAGE(pg);
                 IMCS_LOAD_NEW_PAGE(new_page);
                 new_page->is_leaf = false;
+                new_page->priority = priority;
                 new_page->n_items = 1;
                 CHILD(new_page, 0).page = child;
                 CHILD(new_page, 0).count = 1;
@@ -680,10 +692,12 @@ static bool imcs_append_page_char_rle(imcs_page_t** root_page, char const* val,
             Assert(n_items <= max_items);
             if (n_items == max_items) {
                 imcs_page_t* new_page = imcs_new_page();
+                int priority = pg->priority;
                 *root_page = new_page;
                 IMCS_UNLOAD_PAGE(pg);
                 IMCS_LOAD_NEW_PAGE(new_page);
                 new_page->is_leaf = true;
+                new_page->priority = priority;
                 new_page->u.val_char[0] = 0;
                 memcpy(new_page->u.val_char + 1, val, val_len);
                 memset(new_page->u.val_char + val_len + 1, '\0', elem_size - val_len);
@@ -714,6 +728,7 @@ void imcs_append_char(imcs_timeseries_t* ts, char const* val, size_t val_len)
         IMCS_LOAD_NEW_PAGE(pg);
         dst = pg->u.val_char;
         pg->is_leaf = true;
+        pg->priority = ts->priority;
         if (imcs_use_rle) {
             *dst++ = 0;
         }
@@ -732,6 +747,7 @@ void imcs_append_char(imcs_timeseries_t* ts, char const* val, size_t val_len)
             ts->root_page = new_root;
             IMCS_LOAD_NEW_PAGE(new_root);
             new_root->is_leaf = false;
+            new_root->priority = ts->priority;
             new_root->n_items = 2;
             CHILD(new_root, 0).page = old_root;
             CHILD(new_root, 0).count = ts->count;
@@ -891,6 +907,53 @@ static void imcs_prune(imcs_page_t* pg)
     imcs_free_page(pg);
 }
 
+static imcs_count_t imcs_pin_page(imcs_page_t* pg, int priority)
+{
+    imcs_count_t n_pages = 1;
+    IMCS_LOAD_PAGE(pg);
+    imcs_set_page_priority(pg, priority);
+    if (!pg->is_leaf) {
+        int i, n;
+        for (i = 0, n = pg->n_items; i < n; i++) {
+            n_pages += imcs_pin_page(CHILD(pg, i).page, priority);
+        }
+    }
+    IMCS_UNLOAD_PAGE(pg);
+    return n_pages;
+}
+
+imcs_count_t imcs_pin(imcs_timeseries_t* ts, int priority)
+{
+    ts->priority = priority;
+    return ts->root_page != NULL ? imcs_pin_page(ts->root_page, priority) : 0;
+}
+
+imcs_page_t* imcs_get_leaf_page(imcs_timeseries_t* ts, imcs_pos_t pos)
+{
+    imcs_page_t* page = ts->root_page;
+    while (page != NULL) {
+        imcs_page_t* pg = page;
+        imcs_page_t* child = NULL;
+        int i, n_items;
+        IMCS_LOAD_PAGE(pg);
+        if (pg->is_leaf) {
+            IMCS_UNLOAD_PAGE(pg);
+            break;
+        }
+        for (i = 0, n_items = pg->n_items; i < n_items; i++) {
+            imcs_count_t count = CHILD(pg, i).count;
+            if (pos < count) {
+                child = CHILD(pg, i).page;
+                break;
+            }
+            pos -= count;
+        }
+        IMCS_UNLOAD_PAGE(pg);
+        page = child;
+    }
+    return page;
+}
+
 imcs_count_t imcs_delete_all(imcs_timeseries_t* ts)
 {
     imcs_page_t* root_page = ts->root_page;
@@ -23,7 +23,8 @@ typedef struct imcs_node_t {
 } imcs_node_t;
 
 struct imcs_page_t_ { 
-    uint32 n_items : 31;    
+    uint32 n_items : 29;    
+    uint32 priority : 2; /* retention priority of page in disk cache assigned by cs_pin (IMCS_PRIORITY_XXX) */
     uint32 is_leaf : 1;
     union {
         char   val_char[2];
@@ -66,6 +67,14 @@ extern imcs_iterator_h imcs_map(imcs_iterator_h ts, imcs_iterator_h map_iterator
 
 extern void imcs_delete(imcs_timeseries_t* ts, imcs_pos_t from, imcs_pos_t till);
 extern imcs_count_t imcs_delete_all(imcs_timeseries_t* ts);
+/* 
+ * Load all pages of timeseries in disk cache and set their retention priority. Returns number of pages.
+ */
+extern imcs_count_t imcs_pin(imcs_timeseries_t* ts, int priority);
+/* 
+ * Get leaf page containing element with specified position (NULL if there is no such element)
+ */
+extern imcs_page_t* imcs_get_leaf_page(imcs_timeseries_t* ts, imcs_pos_t pos);
 
 #define IMCS_BTREE_METHODS(TYPE)                                        \
     extern void imcs_append_##TYPE(imcs_timeseries_t* ts, TYPE val);    \
@@ -0,0 +1,175 @@
+#include "compress.h"
+#include <string.h>
+
+#define IMCS_LZ_HASH_BITS     12
+#define IMCS_LZ_MIN_MATCH     4
+#define IMCS_LZ_LAST_LITERALS 5  /* last bytes are always encoded as literals */
+#define IMCS_LZ_MAX_OFFSET    0xFFFF
+#define IMCS_LZ_RUN_MASK      15
+
+typedef unsigned char  imcs_byte_t;
+typedef unsigned int   imcs_uint32_t;
+
+static imcs_uint32_t imcs_lz_read32(imcs_byte_t const* p)
+{
+    imcs_uint32_t val;
+    memcpy(&val, p, sizeof val);
+    return val;
+}
+
+static size_t imcs_lz_hash(imcs_uint32_t seq)
+{
+    return (seq * 2654435761U) >> (32 - IMCS_LZ_HASH_BITS);
+}
+
+/* 
+ * Write extension of literal or match length: sequence of 255 terminated by byte smaller than 255 
+ */
+static imcs_byte_t* imcs_lz_write_length(imcs_byte_t* op, imcs_byte_t const* end, size_t len)
+{
+    while (len >= 255) { 
+        if (op == end) { 
+            return NULL;
+        }
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op == end) { 
+        return NULL;
+    }
+    *op++ = (imcs_byte_t)len;
+    return op;
+}
+
+static imcs_byte_t* imcs_lz_write_sequence(imcs_byte_t* op, imcs_byte_t const* op_end, imcs_byte_t const* literals, size_t n_literals, size_t offset, size_t match_len)
+{
+    imcs_byte_t* token = op++;
+    size_t ml = match_len - IMCS_LZ_MIN_MATCH;
+    if (op > op_end) { 
+        return NULL;
+    }
+    *token = (imcs_byte_t)(((n_literals < IMCS_LZ_RUN_MASK ? n_literals : IMCS_LZ_RUN_MASK) << 4)
+                           | (ml < IMCS_LZ_RUN_MASK ? ml : IMCS_LZ_RUN_MASK));
+    if (n_literals >= IMCS_LZ_RUN_MASK) { 
+        op = imcs_lz_write_length(op, op_end, n_literals - IMCS_LZ_RUN_MASK);
+        if (op == NULL) { 
+            return NULL;
+        }
+    }
+    if ((size_t)(op_end - op) < n_literals) { 
+        return NULL;
+    }
+    memcpy(op, literals, n_literals);
+    op += n_literals;
+    if (match_len != 0) { 
+        if (op_end - op < 2) { 
+            return NULL;
+        }
+        *op++ = (imcs_byte_t)offset;
+        *op++ = (imcs_byte_t)(offset >> 8);
+        if (ml >= IMCS_LZ_RUN_MASK) { 
+            op = imcs_lz_write_length(op, op_end, ml - IMCS_LZ_RUN_MASK);
+        }
+    }
+    return op;
+}
+
+size_t imcs_compress(char const* src, size_t src_size, char* dst, size_t dst_size)
+{
+    imcs_uint32_t table[1 << IMCS_LZ_HASH_BITS];
+    imcs_byte_t const* base = (imcs_byte_t const*)src;
+    imcs_byte_t const* anchor = base;
+    imcs_byte_t const* ip = base;
+    imcs_byte_t* op = (imcs_byte_t*)dst;
+    imcs_byte_t const* op_end = op + dst_size;
+
+    memset(table, 0, sizeof table);
+    if (src_size > IMCS_LZ_LAST_LITERALS + IMCS_LZ_MIN_MATCH) { 
+        imcs_byte_t const* match_limit = base + src_size - IMCS_LZ_LAST_LITERALS;
+        imcs_byte_t const* ip_limit = match_limit - IMCS_LZ_MIN_MATCH;
+        while (ip <= ip_limit) { 
+            imcs_uint32_t seq = imcs_lz_read32(ip);
+            size_t h = imcs_lz_hash(seq);
+            imcs_byte_t const* ref = base + table[h];
+            table[h] = (imcs_uint32_t)(ip - base);
+            if (ref < ip && ip - ref <= IMCS_LZ_MAX_OFFSET && imcs_lz_read32(ref) == seq) { 
+                size_t len = IMCS_LZ_MIN_MATCH;
+                while (ip + len < match_limit && ip[len] == ref[len]) { 
+                    len += 1;
+                }
+                op = imcs_lz_write_sequence(op, op_end, anchor, ip - anchor, ip - ref, len);
+                if (op == NULL) { 
+                    return 0;
+                }
+                ip += len;
+                anchor = ip;
+            } else { 
+                ip += 1;
+            }
+        }
+    }
+    /* last literals */
+    op = imcs_lz_write_sequence(op, op_end, anchor, base + src_size - anchor, 0, 0);
+    return op == NULL ? 0 : (char*)op - dst;
+}
+
+size_t imcs_decompress(char const* src, size_t src_size, char* dst, size_t dst_size)
+{
+    imcs_byte_t const* ip = (imcs_byte_t const*)src;
+    imcs_byte_t const* ip_end = ip + src_size;
+    imcs_byte_t* op = (imcs_byte_t*)dst;
+    imcs_byte_t* op_end = op + dst_size;
+
+    while (ip < ip_end) { 
+        imcs_byte_t token = *ip++;
+        size_t len = token >> 4;
+        size_t offset;
+        imcs_byte_t const* ref;
+
+        if (len == IMCS_LZ_RUN_MASK) { 
+            imcs_byte_t b;
+            do { 
+                if (ip == ip_end) { 
+                    return 0;
+                }
+                len += b = *ip++;
+            } while (b == 255);
+        }
+        if ((size_t)(ip_end - ip) < len || (size_t)(op_end - op) < len) { 
+            return 0;
+        }
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+        if (ip == ip_end) { /* last sequence contains only literals */
+            break;
+        }
+        if (ip_end - ip < 2) { 
+            return 0;
+        }
+        offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (imcs_byte_t*)dst)) { 
+            return 0;
+        }
+        len = token & IMCS_LZ_RUN_MASK;
+        if (len == IMCS_LZ_RUN_MASK) { 
+            imcs_byte_t b;
+            do { 
+                if (ip == ip_end) { 
+                    return 0;
+                }
+                len += b = *ip++;
+            } while (b == 255);
+        }
+        len += IMCS_LZ_MIN_MATCH;
+        if ((size_t)(op_end - op) < len) { 
+            return 0;
+        }
+        /* match can overlap with output, so copy byte by byte */
+        for (ref = op - offset; len != 0; len--) { 
+            *op++ = *ref++;
+        }
+    }
+    return (char*)op - dst;
+}
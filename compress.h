@@ -0,0 +1,24 @@
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+#include <stddef.h>
+
+/**
+ * Fast LZ77 compression of pages (LZ4-like block format).
+ * It is not intended to provide high compression ratio, but speed of decompression
+ * should be comparable with speed of memcpy.
+ */
+
+/*
+ * Compress src_size bytes from src to dst.
+ * Returns size of compressed data or 0 if data can not be compressed to dst_size bytes.
+ */
+size_t imcs_compress(char const* src, size_t src_size, char* dst, size_t dst_size);
+
+/*
+ * Decompress src_size bytes from src to dst.
+ * Returns size of decompressed data or 0 if compressed data is corrupted or doesn't fit in dst_size bytes.
+ */
+size_t imcs_decompress(char const* src, size_t src_size, char* dst, size_t dst_size);
+
+#endif
@@ -1,9 +1,82 @@
 #include "disk.h"
 #include "btree.h"
 #include "fileio.h"
+#include "compress.h"
+#include "smp.h"
+#include <portability/instr_time.h>
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 static imcs_file_h imcs_file;
 static imcs_disk_cache_t* imcs_disk_cache;
+static char* imcs_io_buffer; /* aligned page buffer used for direct IO of free pages chain */
+static int* imcs_flush_pages; /* int[max_size]: dirty pages taken by imcs_disk_flush */
+
+/*
+ * Page buffers used for compression and decompression of pages. Pages can be concurrently read or written by several threads
+ * of the backend, so each I/O takes buffer from this list and returns it back: number of allocated buffers is limited by
+ * number of concurrent I/O operations. Free buffer is linked in the list through its beginning.
+ */
+typedef struct imcs_page_buffer_t_ { 
+    struct imcs_page_buffer_t_* next;
+    char* chunk; /* allocated memory (buffer itself is aligned) */
+} imcs_page_buffer_t;
+
+static imcs_page_buffer_t* imcs_free_page_buffers;
+static imcs_mutex_t* imcs_page_buffers_mutex;
+
+static imcs_cache_stats_t imcs_backend_stats; /* statistic for this backend (updated under cache->mutex) */
+
+#define IMCS_ALIGN_UP(x, align) (((size_t)(x) + (align) - 1) & ~((size_t)(align) - 1))
+
+/* 
+ * Increment shared and per-backend statistic counter. It should be done under cache->mutex.
+ */
+#define IMCS_CACHE_STAT(cache, counter) ((cache)->stats.counter += 1, imcs_backend_stats.counter += 1)
+
+/* 
+ * Acquire cache spinlock, counting contentions
+ */
+static void imcs_cache_lock(imcs_disk_cache_t* cache)
+{
+    bool contended = !SpinLockFree(&cache->mutex);
+    SpinLockAcquire(&cache->mutex);
+    if (contended) { 
+        IMCS_CACHE_STAT(cache, spinlock_contentions);
+    }
+}
+
+/* 
+ * Time elapsed since start of operation. It should be taken before cache->mutex is acquired: reading clock is not cheap.
+ */
+static uint64 imcs_elapsed_usec(instr_time start)
+{
+    instr_time now;
+    INSTR_TIME_SET_CURRENT(now);
+    INSTR_TIME_SUBTRACT(now, start);
+    return (uint64)INSTR_TIME_GET_MICROSEC(now);
+}
+
+/* This function is called under cache->mutex */
+static void imcs_account_latency(uint64* shared_hist, uint64* backend_hist, uint64 usec)
+{
+    int i;
+    for (i = 0; i < IMCS_LATENCY_BUCKETS-1 && usec >= ((uint64)1 << i); i++);
+    shared_hist[i] += 1;
+    backend_hist[i] += 1;
+}
+
+static void imcs_account_write_latency(instr_time start)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    uint64 usec = imcs_elapsed_usec(start);
+    imcs_cache_lock(cache);
+    imcs_account_latency(cache->stats.write_latency, imcs_backend_stats.write_latency, usec);
+    SpinLockRelease(&cache->mutex);
+}
 
 inline static void imcs_unlink(int pid)
 {
@@ -28,20 +101,422 @@ inline static void imcs_link_after(int after, int pid)
     cache->items[item->prev = after].next = pid;
 }
 
+static char* imcs_alloc_io_buffer(size_t size)
+{
+    char* buf = (char*)malloc(size + IMCS_IO_ALIGNMENT);
+    if (buf == NULL) { 
+        imcs_ereport(ERRCODE_OUT_OF_MEMORY, "failed to allocate IO buffer");
+    }
+    return buf;
+}
+
+static char* imcs_get_io_buffer(void)
+{
+    if (imcs_io_buffer == NULL) { 
+        imcs_io_buffer = (char*)IMCS_ALIGN_UP(imcs_alloc_io_buffer(imcs_page_size), IMCS_IO_ALIGNMENT);
+    }
+    return imcs_io_buffer;
+}
+
+static char* imcs_take_page_buffer(void)
+{
+    imcs_page_buffer_t* pb;
+    char* chunk;
+    imcs_page_buffers_mutex->lock(imcs_page_buffers_mutex);
+    pb = imcs_free_page_buffers;
+    if (pb != NULL) { 
+        imcs_free_page_buffers = pb->next;
+    }
+    imcs_page_buffers_mutex->unlock(imcs_page_buffers_mutex);
+    if (pb != NULL) { 
+        return (char*)pb;
+    }
+    chunk = imcs_alloc_io_buffer(imcs_page_size);
+    pb = (imcs_page_buffer_t*)IMCS_ALIGN_UP(chunk, IMCS_IO_ALIGNMENT);
+    pb->chunk = chunk;
+    return (char*)pb;
+}
+
+static void imcs_return_page_buffer(char* buf)
+{
+    imcs_page_buffer_t* pb = (imcs_page_buffer_t*)buf;
+    imcs_page_buffers_mutex->lock(imcs_page_buffers_mutex);
+    pb->next = imcs_free_page_buffers;
+    imcs_free_page_buffers = pb;
+    imcs_page_buffers_mutex->unlock(imcs_page_buffers_mutex);
+}
+
+static imcs_extent_t* imcs_page_map_entry(uint64 offs)
+{
+    uint64 pno = offs / imcs_page_size;
+    return &imcs_disk_cache->page_map[pno >> IMCS_PAGE_MAP_CHUNK_BITS][pno & (IMCS_PAGE_MAP_CHUNK_SIZE-1)];
+}
+
+/*
+ * Free extents of each size class are linked in L1 list through first 8 bytes of extent.
+ * Links are read and written without holding cache->mutex: under the mutex only head of the list is changed
+ * and version of the list is checked to detect concurrent modification.
+ */
+static uint64 imcs_alloc_extent(int cls)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    char io_buf[IMCS_EXTENT_UNIT + IMCS_IO_ALIGNMENT];
+    char* buf = (char*)IMCS_ALIGN_UP(io_buf, IMCS_IO_ALIGNMENT);
+    uint64 offs, next, version;
+
+    while (true) {
+        imcs_cache_lock(cache);
+        offs = cache->free_extents[cls];
+        if (offs == 0) { /* append extent to the file */
+            offs = cache->file_extent_size;
+            cache->file_extent_size += (uint64)1 << cls;
+            SpinLockRelease(&cache->mutex);
+            return offs;
+        }
+        version = cache->free_extents_version[cls];
+        SpinLockRelease(&cache->mutex);
+
+        if (imcs_file_read(imcs_file, buf, IMCS_EXTENT_UNIT, offs*IMCS_EXTENT_UNIT)) {
+            memcpy(&next, buf, sizeof(uint64));
+        } else {
+            next = 0; /* link can not be read: abandon rest of the list */
+        }
+        imcs_cache_lock(cache);
+        if (cache->free_extents_version[cls] == version) { /* list was not changed by others */
+            cache->free_extents[cls] = next;
+            cache->free_extents_version[cls] += 1;
+            SpinLockRelease(&cache->mutex);
+            return offs;
+        }
+        SpinLockRelease(&cache->mutex);
+    }
+}
+
+static void imcs_free_extent(imcs_extent_t extent)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    int cls = IMCS_EXTENT_CLASS(extent);
+    uint64 offs = IMCS_EXTENT_OFFS(extent);
+    char io_buf[IMCS_EXTENT_UNIT + IMCS_IO_ALIGNMENT];
+    char* buf = (char*)IMCS_ALIGN_UP(io_buf, IMCS_IO_ALIGNMENT);
+    uint64 head, version;
+    bool done;
+
+    memset(buf, 0, IMCS_EXTENT_UNIT);
+    do {
+        imcs_cache_lock(cache);
+        head = cache->free_extents[cls];
+        version = cache->free_extents_version[cls];
+        SpinLockRelease(&cache->mutex);
+
+        memcpy(buf, &head, sizeof(uint64));
+        imcs_file_write(imcs_file, buf, IMCS_EXTENT_UNIT, offs*IMCS_EXTENT_UNIT);
+
+        imcs_cache_lock(cache);
+        done = cache->free_extents_version[cls] == version;
+        if (done) {
+            cache->free_extents[cls] = offs;
+            cache->free_extents_version[cls] += 1;
+        }
+        SpinLockRelease(&cache->mutex);
+    } while (!done);
+}
+
+/* 
+ * Save page in the file. This function is called without holding cache->mutex: page is either pinned 
+ * or marked as busy, so it can not be changed or written by others while it is saved.
+ * If compression is enabled, page is compressed and stored in extent which size class is large enough to hold compressed data.
+ * Extent is reused if page still fits in it, otherwise it is relocated.
+ */
+static void imcs_write_page(imcs_page_t* pg, uint64 offs)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    imcs_extent_t* entry;
+    imcs_extent_t extent, old_extent;
+    size_t size;
+    int n_units, cls;
+    char* buf;
+    char* data;
+    instr_time start;
+    uint64 usec;
+
+    INSTR_TIME_SET_CURRENT(start);
+    if (!imcs_compress_pages) { 
+        imcs_file_write(imcs_file, pg, imcs_page_size, offs);
+        imcs_account_write_latency(start);
+        return;
+    }
+    /* this function can be concurrently called by several threads, so buffer is taken from the list of free page buffers */
+    buf = imcs_take_page_buffer();
+    data = buf;
+    /* compression makes sense only if it saves at least one unit */
+    size = imcs_compress((char*)pg, imcs_page_size, data + sizeof(uint32), imcs_page_size - IMCS_EXTENT_UNIT - sizeof(uint32));
+    if (size != 0) { 
+        size += sizeof(uint32);
+        *(uint32*)data = (uint32)size;
+        n_units = (int)((size + IMCS_EXTENT_UNIT - 1) / IMCS_EXTENT_UNIT);
+        memset(data + size, 0, (size_t)n_units*IMCS_EXTENT_UNIT - size);
+    } else {
+        data = (char*)pg;
+        n_units = imcs_page_size / IMCS_EXTENT_UNIT;
+    }
+    for (cls = 0; (1 << cls) < n_units; cls++);
+
+    /* page map entry of the page is changed only by the thread saving or freeing this page */
+    entry = imcs_page_map_entry(offs);
+    old_extent = *entry;
+    if (old_extent != 0 && IMCS_EXTENT_CLASS(old_extent) >= cls) { /* page still fits in its extent */
+        cls = IMCS_EXTENT_CLASS(old_extent);
+        extent = IMCS_MAKE_EXTENT(IMCS_EXTENT_OFFS(old_extent), n_units, cls);
+        old_extent = 0;
+    } else { 
+        extent = IMCS_MAKE_EXTENT(imcs_alloc_extent(cls), n_units, cls);
+    }
+    if (size == 0) { 
+        extent |= IMCS_EXTENT_RAW;
+    }
+    imcs_file_write(imcs_file, data, (size_t)n_units*IMCS_EXTENT_UNIT, IMCS_EXTENT_OFFS(extent)*IMCS_EXTENT_UNIT);
+    imcs_return_page_buffer(buf);
+
+    usec = imcs_elapsed_usec(start);
+    imcs_cache_lock(cache);
+    *entry = extent;
+    imcs_account_latency(cache->stats.write_latency, imcs_backend_stats.write_latency, usec);
+    SpinLockRelease(&cache->mutex);
+
+    if (old_extent != 0) { /* page was relocated */
+        imcs_free_extent(old_extent);
+    }
+}
+
+/* 
+ * Read page from the file to the cache slot. This function is called without holding cache->mutex
+ * ("extent" is page map entry of compressed page, obtained under cache->mutex).
+ * Returns 0 on success or error code if compressed page can not be read or decompressed.
+ */
+static int imcs_read_page(imcs_page_t* pg, uint64 offs, imcs_extent_t extent)
+{
+    char* buf;
+    size_t size;
+    uint32 compressed_size;
+
+    if (!imcs_compress_pages) { 
+        imcs_file_read(imcs_file, pg, imcs_page_size, offs);
+        return 0;
+    }
+    if (extent == 0) { /* page was never written */
+        memset(pg, 0, imcs_page_size);
+        return 0;
+    }
+    if (extent & IMCS_EXTENT_RAW) { 
+        imcs_file_read(imcs_file, pg, imcs_page_size, IMCS_EXTENT_OFFS(extent)*IMCS_EXTENT_UNIT);
+        return 0;
+    }
+    /* this function can be concurrently called by several threads, so buffer is taken from the list of free page buffers */
+    size = (size_t)IMCS_EXTENT_UNITS(extent)*IMCS_EXTENT_UNIT;
+    buf = imcs_take_page_buffer();
+    if (!imcs_file_read(imcs_file, buf, size, IMCS_EXTENT_OFFS(extent)*IMCS_EXTENT_UNIT)) { 
+        imcs_return_page_buffer(buf);
+        return ERRCODE_IO_ERROR;
+    }
+    memcpy(&compressed_size, buf, sizeof(uint32));
+    if (compressed_size <= sizeof(uint32) || compressed_size > size
+        || imcs_decompress(buf + sizeof(uint32), compressed_size - sizeof(uint32), (char*)pg, imcs_page_size) != (size_t)imcs_page_size) 
+    { 
+        imcs_return_page_buffer(buf);
+        return ERRCODE_DATA_CORRUPTED;
+    }
+    imcs_return_page_buffer(buf);
+    return 0;
+}
+
+/* This function is called under cache->mutex */
+static void imcs_exclude_from_dirty_list(imcs_cache_item_t* item)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    int moved = cache->dirty_pages[--cache->n_dirty_pages];
+    cache->dirty_pages[item->dirty_index-1] = moved;
+    cache->items[moved].dirty_index = item->dirty_index;
+    item->dirty_index = 0;
+}
+
+/* This function is called under cache->mutex */
+static void imcs_exclude_from_hash(int pid)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    imcs_cache_item_t* item = &cache->items[pid];
+    size_t h = (size_t)(item->offs / imcs_page_size) % cache->max_size;    
+    int* pp;
+    for (pp = &cache->hash_table[h]; *pp != pid; pp = &cache->items[*pp].collision) { 
+        Assert(*pp != 0); /* item should be present in collision chain */
+    }
+    *pp = item->collision;
+}
+
+/* This function is called under cache->mutex */
+static void imcs_detach_item(int pid)
+{
+    imcs_cache_item_t* item = &imcs_disk_cache->items[pid];
+    imcs_exclude_from_hash(pid);
+    item->offs = 0;
+    item->priority = IMCS_PRIORITY_NORMAL;
+}
+
+/* 
+ * Throw away page from the cache, saving it if it is dirty. 
+ * Item should be already excluded from LRU list. This function is called under cache->mutex,
+ * but the mutex is released while dirty page is written: item is marked as busy, so lookups of this page wait until it is saved.
+ * Returns true if mutex was released.
+ */
+static bool imcs_evict_item(int pid)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    imcs_cache_item_t* item = &cache->items[pid];
+    bool saved = false;
+
+    /* save dirty page */
+    if (item->dirty_index) { 
+        imcs_exclude_from_dirty_list(item);
+        item->is_busy = true;
+        SpinLockRelease(&cache->mutex);
+        imcs_write_page(IMCS_PAGE_DATA(cache, pid), item->offs);
+        imcs_cache_lock(cache);
+        item->is_busy = false;
+        IMCS_CACHE_STAT(cache, dirty_writes);
+        saved = true;
+    }
+    imcs_detach_item(pid);
+    return saved;
+}
+
+/* 
+ * Return memory of detached cache pages [from, till) to OS (only whole OS pages can be released).
+ * Cache data is located in shared memory, so MADV_REMOVE is needed to really free it.
+ * This function is called under cache->mutex.
+ */
+static void imcs_release_cache_memory(int from, int till)
+{
+#if defined(MADV_REMOVE)
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    size_t os_page_size = (size_t)sysconf(_SC_PAGESIZE);
+    size_t beg = IMCS_ALIGN_UP(cache->data + (size_t)from*imcs_page_size, os_page_size);
+    size_t end = (size_t)(cache->data + (size_t)till*imcs_page_size) & ~(os_page_size - 1);
+    if (beg < end) { 
+        madvise((void*)beg, end - beg, MADV_REMOVE); /* it is just a hint, so ignore errors */
+    }
+#endif
+}
+
+/* 
+ * Return detached item to the list of free items or, if it is beyond the current cache size, its memory to OS.
+ * This function is called under cache->mutex.
+ */
+static void imcs_release_item(int pid)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    if (pid <= cache->size) { 
+        cache->items[pid].next = cache->free_items_chain;
+        cache->free_items_chain = pid;
+    } else { 
+        imcs_release_cache_memory(pid-1, pid);
+    }
+}
+
+/* 
+ * Change number of pages in cache. Cache can not be extended beyond imcs.max_cache_size pages.
+ * When cache is shrunk, pages beyond new size are thrown away (pinned pages - when them are unloaded).
+ * Dirty pages are written after releasing cache->mutex: until then them are marked as busy.
+ */
+int imcs_disk_resize(int new_size)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    int old_size, pid, *pp;
+    int* victims;
+    int i, n_victims = 0;
+
+    if (cache == NULL) { 
+        imcs_ereport(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE, "disk cache is not initialized");
+    }
+    if (new_size < 8 || new_size > cache->max_size) { 
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "cache size should be in range [8, %d]", cache->max_size);
+    }
+    victims = (int*)palloc(cache->max_size*sizeof(int));
+    imcs_cache_lock(cache);
+    old_size = cache->size;
+    cache->size = new_size;
+    if (new_size < old_size) { 
+        /* remove detached items from free list */
+        for (pp = &cache->free_items_chain; *pp != 0;) { 
+            if (*pp > new_size) { 
+                *pp = cache->items[*pp].next;
+            } else { 
+                pp = &cache->items[*pp].next;
+            }
+        }
+        /* throw away unpinned pages and return their memory to OS */
+        for (pid = new_size+1; pid <= cache->n_used_items; pid++) { 
+            imcs_cache_item_t* item = &cache->items[pid];
+            if (item->offs != 0 && item->access_count == 0 && !item->is_busy) { 
+                imcs_unlink(pid);
+                if (item->dirty_index) { /* page will be saved after releasing the mutex */
+                    imcs_exclude_from_dirty_list(item);
+                    item->is_busy = true;
+                    victims[n_victims++] = pid;
+                    continue;
+                }
+                imcs_detach_item(pid);
+            }
+            if (item->offs == 0) { 
+                imcs_release_cache_memory(pid-1, pid);
+            }
+        }
+        if (cache->n_used_items > new_size) { 
+            cache->n_used_items = new_size;
+        }
+    } else { 
+        /* attach released items, skipping still pinned pages */
+        for (pid = new_size; pid > cache->n_used_items; pid--) { 
+            imcs_cache_item_t* item = &cache->items[pid];
+            if (item->offs == 0) { 
+                item->next = cache->free_items_chain;
+                cache->free_items_chain = pid;
+            }
+        }
+        cache->n_used_items = new_size;
+    }
+    SpinLockRelease(&cache->mutex);
+
+    for (i = 0; i < n_victims; i++) { 
+        imcs_cache_item_t* item;
+        pid = victims[i];
+        item = &cache->items[pid];
+        imcs_write_page(IMCS_PAGE_DATA(cache, pid), item->offs);
+        imcs_cache_lock(cache);
+        item->is_busy = false;
+        IMCS_CACHE_STAT(cache, dirty_writes);
+        imcs_detach_item(pid);
+        imcs_release_item(pid); /* cache may be extended again while page was saved */
+        SpinLockRelease(&cache->mutex);
+    }
+    pfree(victims);
+    return old_size;
+}
+
 imcs_page_t* imcs_load_page(imcs_page_t* pg, imcs_page_access_mode_t mode)
 {
     size_t offs = (size_t)pg;
-    size_t h = (offs / imcs_page_size) % imcs_cache_size;    
+    size_t h = (offs / imcs_page_size) % imcs_disk_cache->max_size;    
     size_t pid;
     imcs_cache_item_t* item;
     imcs_disk_cache_t* cache = imcs_disk_cache;
     
   Retry:
-    SpinLockAcquire(&cache->mutex);
+    imcs_cache_lock(cache);
     for (pid = cache->hash_table[h]; pid != 0; pid = item->collision) { 
         item = &cache->items[pid];
         if (item->offs == offs) { 
             while (item->is_busy) { 
+                IMCS_CACHE_STAT(cache, busy_waits);
                 SpinLockRelease(&cache->mutex);
                 SPIN_DELAY();
                 goto Retry;
@@ -49,6 +524,7 @@ imcs_page_t* imcs_load_page(imcs_page_t* pg, imcs_page_access_mode_t mode)
             if (item->access_count++ == 0) { /* pin page in memory: exclude from LRU list */
                 imcs_unlink(pid);
             }
+            IMCS_CACHE_STAT(cache, hits);
             if (mode != PM_READ_ONLY) { /* page will be updated */
                 if (item->dirty_index == 0) { /* page was not yet modified */
                     cache->dirty_pages[cache->n_dirty_pages] = pid; /* include in dirty pages list */
@@ -62,42 +538,52 @@ imcs_page_t* imcs_load_page(imcs_page_t* pg, imcs_page_access_mode_t mode)
     if (cache->free_items_chain != 0) { 
         pid = cache->free_items_chain;
         cache->free_items_chain = cache->items[pid].next;
-    } else if (cache->n_used_items < imcs_cache_size) { 
+    } else if (cache->n_used_items < cache->size) { 
         pid = ++cache->n_used_items;
     } else { /* no free items, replace LRU item */
-        size_t vh;
-        int* pp;
         pid = cache->items->prev; /* LRU victim */
         if (pid == 0) { /* no free pages */
+            SpinLockRelease(&cache->mutex);
             imcs_ereport(ERRCODE_OUT_OF_MEMORY, "no available page in cache");
         }
-        item = &cache->items[pid];
-
-        /* exclude item from hash table */
-        vh = (size_t)(item->offs / imcs_page_size) % imcs_cache_size;    
-        for (pp = &cache->hash_table[vh]; *pp != pid; pp = &cache->items[*pp].collision) { 
-            Assert(*pp != 0); /* item should be present in collision chain */
-        }
-        *pp = item->collision;
-
         /* exclude item from LRU list */
         imcs_unlink(pid);
-
-        /* save dirty page */
-        if (item->dirty_index) { 
-            pg = IMCS_PAGE_DATA(cache, pid);
-            imcs_file_write(imcs_file, pg, imcs_page_size, item->offs);
-            cache->dirty_pages[item->dirty_index-1] = cache->dirty_pages[--cache->n_dirty_pages]; /* exclude from dirty list */
+        IMCS_CACHE_STAT(cache, evictions);
+        if (imcs_evict_item(pid)) { /* mutex was released while victim was saved: requested page may be already loaded by others */
+            imcs_release_item(pid);
+            SpinLockRelease(&cache->mutex);
+            goto Retry;
         }
     }
     item = &cache->items[pid];
+    item->offs = offs; /* mark item as used */
+    item->collision = cache->hash_table[h];
+    cache->hash_table[h] = pid;
     if (mode != PM_NEW) { 
         /* prepare to load page from the disk: mark it as busy to avoid redundant reads */
+        imcs_extent_t extent = imcs_compress_pages ? *imcs_page_map_entry(offs) : 0;
+        instr_time start;
+        uint64 usec;
+        int err_code;
         pg = IMCS_PAGE_DATA(cache, pid);
         item->is_busy = true;    
         SpinLockRelease(&cache->mutex); /* release mutex during IO */
-        imcs_file_read(imcs_file, pg, imcs_page_size, offs); /* read page */
-        SpinLockAcquire(&cache->mutex); 
+        INSTR_TIME_SET_CURRENT(start);
+        err_code = imcs_read_page(pg, offs, extent); /* read page */
+        usec = imcs_elapsed_usec(start);
+        imcs_cache_lock(cache);
+        if (err_code != 0) { /* give slot back, so that it is not left busy */
+            imcs_exclude_from_hash(pid);
+            item->offs = 0;
+            item->is_busy = false;
+            imcs_release_item(pid);
+            SpinLockRelease(&cache->mutex);
+            imcs_ereport(err_code, err_code == ERRCODE_DATA_CORRUPTED ? "Failed to decompress page" : "Failed to read compressed page");
+        }
+        imcs_account_latency(cache->stats.read_latency, imcs_backend_stats.read_latency, usec);
+        IMCS_CACHE_STAT(cache, misses);
+    } else { 
+        IMCS_CACHE_STAT(cache, new_pages);
     }
     if (mode != PM_READ_ONLY) { /* include page in dirty list */
         cache->dirty_pages[cache->n_dirty_pages] = pid;
@@ -105,9 +591,6 @@ imcs_page_t* imcs_load_page(imcs_page_t* pg, imcs_page_access_mode_t mode)
     } else { 
         item->dirty_index = 0;
     }
-    item->offs = offs;
-    item->collision = cache->hash_table[h];
-    cache->hash_table[h] = pid;
     item->access_count = 1;
     item->is_busy = false;  
     SpinLockRelease(&cache->mutex);
@@ -119,38 +602,96 @@ void imcs_unload_page(imcs_page_t* pg)
     imcs_disk_cache_t* cache = imcs_disk_cache;
     size_t pid = ((char*)pg - cache->data)/imcs_page_size + 1;
     imcs_cache_item_t* item = &cache->items[pid];
-    Assert(pid-1 < (size_t)imcs_cache_size);
-    SpinLockAcquire(&cache->mutex); 
-    if (--item->access_count == 0) { /* unpin page */
-        imcs_link_after(pg->is_leaf ? cache->lru_internal : 0, pid);
-        if (!pg->is_leaf && cache->lru_internal == 0) { 
+    Assert(pid-1 < (size_t)cache->max_size);
+    imcs_cache_lock(cache);
+    if (item->priority != pg->priority) { /* page was loaded from the disk or its priority was changed by cs_pin */
+        if (pg->priority == IMCS_PRIORITY_RESIDENT) { /* resident pages are permanently pinned by extra reference */
+            item->access_count += 1;
+        } else if (item->priority == IMCS_PRIORITY_RESIDENT) { 
+            item->access_count -= 1;
+        }
+        item->priority = pg->priority;
+    }
+    if (--item->access_count == 0 && pid > (size_t)cache->size) { /* cache was shrunk while page was pinned */
+        imcs_evict_item(pid);
+        imcs_release_item(pid); /* cache may be extended again while page was saved */
+        SpinLockRelease(&cache->mutex);
+        return;
+    }
+    if (item->access_count == 0) { /* unpin page */
+        /* pages with high priority are placed in LRU list together with internal pages */
+        bool is_leaf = pg->is_leaf && item->priority == IMCS_PRIORITY_NORMAL;
+        imcs_link_after(is_leaf ? cache->lru_internal : 0, pid);
+        if (!is_leaf && cache->lru_internal == 0) { 
             cache->lru_internal = pid;
         }
     }
     SpinLockRelease(&cache->mutex);
 }
 
+/* 
+ * Set retention priority of loaded page. Priority is stored in page header, so that it is preserved when page
+ * is evicted and loaded again: page is marked as dirty and cache item takes the new priority when page is unloaded.
+ */
+void imcs_set_page_priority(imcs_page_t* pg, int priority)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    size_t pid = ((char*)pg - cache->data)/imcs_page_size + 1;
+    imcs_cache_item_t* item = &cache->items[pid];
+    Assert(item->access_count > 0); /* page should be loaded */
+    imcs_cache_lock(cache);
+    if (pg->priority != priority) { 
+        pg->priority = priority;
+        if (item->dirty_index == 0) { 
+            cache->dirty_pages[cache->n_dirty_pages] = pid;
+            item->dirty_index = ++cache->n_dirty_pages;
+        }
+    }
+    SpinLockRelease(&cache->mutex);
+}
+
 void imcs_disk_initialize(imcs_disk_cache_t* cache)
 {
+    int max_size = imcs_max_cache_size > imcs_cache_size ? imcs_max_cache_size : imcs_cache_size;
     memset(cache, 0, sizeof(*cache));
-    cache->items = (imcs_cache_item_t*)ShmemAlloc((imcs_cache_size+1)*sizeof(imcs_cache_item_t));
+    /* 
+     * Space for imcs.max_cache_size pages is reserved, but only imcs.cache_size pages are used.
+     * Untouched pages of shared memory segment are not backed by physical memory.
+     */
+    cache->size = imcs_cache_size;
+    cache->max_size = max_size;
+    cache->items = (imcs_cache_item_t*)ShmemAlloc((max_size+1)*sizeof(imcs_cache_item_t));
     if (cache->items == NULL) { 
         imcs_ereport(ERRCODE_OUT_OF_MEMORY, "not enough shared memory for disk cache");
     }
-    cache->data = (char*)ShmemAlloc((size_t)imcs_cache_size*imcs_page_size);
+    memset(cache->items, 0, (max_size+1)*sizeof(imcs_cache_item_t));
+    if ((imcs_direct_io || imcs_compress_pages) && imcs_page_size % IMCS_EXTENT_UNIT != 0) { 
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "imcs.page_size should be multiple of %d when imcs.direct_io or imcs.compress_pages is used", IMCS_EXTENT_UNIT);
+    }
+    /* align pages in cache to make it possible to use them as direct IO buffers */
+    cache->data = (char*)ShmemAlloc((size_t)max_size*imcs_page_size + IMCS_IO_ALIGNMENT);
     if (cache->data == NULL) { 
         imcs_ereport(ERRCODE_OUT_OF_MEMORY, "not enough shared memory for disk cache");
     }
-    cache->hash_table = (int*)ShmemAlloc(imcs_cache_size*sizeof(int));
+    cache->data = (char*)IMCS_ALIGN_UP(cache->data, IMCS_IO_ALIGNMENT);
+    cache->hash_table = (int*)ShmemAlloc(max_size*sizeof(int));
     if (cache->hash_table == NULL) { 
         imcs_ereport(ERRCODE_OUT_OF_MEMORY, "not enough shared memory for disk cache");
     }
-    memset(cache->hash_table, 0, imcs_cache_size*sizeof(int));
+    memset(cache->hash_table, 0, max_size*sizeof(int));
 
-    cache->dirty_pages = (int*)ShmemAlloc(imcs_cache_size*sizeof(int));
+    cache->dirty_pages = (int*)ShmemAlloc(max_size*sizeof(int));
     if (cache->dirty_pages == NULL) { 
         imcs_ereport(ERRCODE_OUT_OF_MEMORY, "not enough shared memory for disk cache");
     }
+    if (imcs_compress_pages) { 
+        cache->page_map = (imcs_extent_t**)ShmemAlloc(IMCS_PAGE_MAP_DIR_SIZE*sizeof(imcs_extent_t*));
+        if (cache->page_map == NULL) { 
+            imcs_ereport(ERRCODE_OUT_OF_MEMORY, "not enough shared memory for disk cache");
+        }
+        memset(cache->page_map, 0, IMCS_PAGE_MAP_DIR_SIZE*sizeof(imcs_extent_t*));
+        cache->file_extent_size = 1; /* zero offset is used as end of free extents list */
+    }
     cache->file_size = imcs_page_size; /* reserve first page to make address not NULL */
     SpinLockInit(&cache->mutex);
     imcs_disk_cache = cache;
@@ -159,12 +700,29 @@ void imcs_disk_initialize(imcs_disk_cache_t* cache)
     
 void imcs_disk_open(void)
 {
-    imcs_file = imcs_file_open(imcs_file_path);
+    imcs_file = imcs_file_open(imcs_file_path, imcs_direct_io);
+    imcs_page_buffers_mutex = imcs_create_mutex();
+    if (imcs_compress_pages) { 
+        imcs_return_page_buffer(imcs_take_page_buffer());
+    }
 }
 
 void imcs_disk_close(void)
 {
     imcs_file_close(imcs_file);
+    if (imcs_page_buffers_mutex != NULL) { 
+        while (imcs_free_page_buffers != NULL) { 
+            imcs_page_buffer_t* pb = imcs_free_page_buffers;
+            imcs_free_page_buffers = pb->next;
+            free(pb->chunk);
+        }
+        imcs_page_buffers_mutex->destroy(imcs_page_buffers_mutex);
+        imcs_page_buffers_mutex = NULL;
+    }
+    if (imcs_flush_pages != NULL) { 
+        free(imcs_flush_pages);
+        imcs_flush_pages = NULL;
+    }
 }
 
 static int compare_page_offset(void const* p, void const* q) 
@@ -177,22 +735,106 @@ static int compare_page_offset(void const* p, void const* q)
 void imcs_disk_flush(void)
 {
     imcs_disk_cache_t* cache = imcs_disk_cache;
-    int i, n;
-    SpinLockAcquire(&cache->mutex);
+    void const* batch[IMCS_MAX_IO_BATCH];
+    int* dirty_pages;
+    instr_time start;
+    int i, j, n;
+
+    if (imcs_flush_pages == NULL) { /* size of the cache is fixed when shared memory is allocated, so array is allocated once */
+        imcs_flush_pages = (int*)malloc(cache->max_size*sizeof(int));
+        if (imcs_flush_pages == NULL) { 
+            imcs_ereport(ERRCODE_OUT_OF_MEMORY, "failed to allocate list of dirty pages");
+        }
+    }
+    dirty_pages = imcs_flush_pages;
+
+    /* take dirty pages and pin them, so that them are not evicted while written without holding the mutex */
+    imcs_cache_lock(cache);
     n = cache->n_dirty_pages;
-    if (n != 0) { 
+    for (i = 0; i < n; i++) { 
+        int pid = cache->dirty_pages[i];
+        imcs_cache_item_t* item = &cache->items[pid];
+        dirty_pages[i] = pid;
+        item->dirty_index = 0;
+        if (item->access_count++ == 0) { 
+            imcs_unlink(pid);
+        }
+    }
+    cache->n_dirty_pages = 0;
+    SpinLockRelease(&cache->mutex);
+
+    if (imcs_compress_pages) { 
+        /* compressed pages are placed in extents of different size, so them are written one by one */
+        for (i = 0; i < n; i++) { 
+            int pid = dirty_pages[i];
+            imcs_write_page(IMCS_PAGE_DATA(cache, pid), cache->items[pid].offs);
+        }
+    } else { 
         /* sort dirty pages by offset so that them will be written in more or less sequential order */
-        qsort(cache->dirty_pages, n, sizeof(int), compare_page_offset);
-        for (i = 0; i < n; i++) {
-            int pid = cache->dirty_pages[i];
-            imcs_cache_item_t* item = &cache->items[pid];
-            imcs_page_t* pg = IMCS_PAGE_DATA(cache, pid);
-            imcs_file_write(imcs_file, pg, imcs_page_size, item->offs);
-            item->dirty_index = 0;
+        qsort(dirty_pages, n, sizeof(int), compare_page_offset);
+        for (i = 0; i < n; i = j) {
+            /* group pages with adjacent offsets in one write request */
+            uint64 offs = cache->items[dirty_pages[i]].offs;
+            for (j = i; j < n && j - i < IMCS_MAX_IO_BATCH; j++) { 
+                int pid = dirty_pages[j];
+                if (cache->items[pid].offs != offs + (uint64)(j - i)*imcs_page_size) { 
+                    break;
+                }
+                batch[j - i] = IMCS_PAGE_DATA(cache, pid);
+            }
+            INSTR_TIME_SET_CURRENT(start);
+            if (j == i + 1) { 
+                imcs_file_write(imcs_file, batch[0], imcs_page_size, offs);
+            } else { 
+                imcs_file_writev(imcs_file, batch, j - i, imcs_page_size, offs);
+            }
+            imcs_account_write_latency(start);
         }
-        cache->n_dirty_pages = 0;
     }
+    imcs_cache_lock(cache);
+    cache->stats.flush_writes += n;
+    imcs_backend_stats.flush_writes += n;
     SpinLockRelease(&cache->mutex);
+
+    for (i = 0; i < n; i++) { 
+        imcs_unload_page(IMCS_PAGE_DATA(cache, dirty_pages[i]));
+    }
+}
+
+/* 
+ * Free pages are linked in L1 list through first 8 bytes of the page.
+ * Direct IO requires aligned buffers and sizes, so in this case the whole page is read/written using aligned buffer.
+ */
+static bool imcs_read_page_link(uint64* link, uint64 addr)
+{
+    if (imcs_compress_pages) { /* logical pages are not present in the file: link is stored in page map */
+        *link = (*imcs_page_map_entry(addr) & ~IMCS_EXTENT_FREE) * imcs_page_size;
+        return true;
+    }
+    if (imcs_direct_io) { 
+        char* buf = imcs_get_io_buffer();
+        if (!imcs_file_read(imcs_file, buf, imcs_page_size, addr)) { 
+            return false;
+        }
+        memcpy(link, buf, sizeof(*link));
+        return true;
+    }
+    return imcs_file_read(imcs_file, link, sizeof(*link), addr);
+}
+
+static void imcs_write_page_link(uint64 link, uint64 addr)
+{
+    if (imcs_compress_pages) { 
+        *imcs_page_map_entry(addr) = IMCS_EXTENT_FREE | (link / imcs_page_size);
+        return;
+    }
+    if (imcs_direct_io) { 
+        char* buf = imcs_get_io_buffer();
+        memcpy(buf, &link, sizeof(link));
+        imcs_file_write(imcs_file, buf, imcs_page_size, addr);
+    } else {
+        imcs_file_write(imcs_file, &link, sizeof(link), addr);
+    }
 }
 
 /* This function is called in context protected by imcs->lock */
@@ -205,14 +847,31 @@ imcs_page_t* imcs_new_page(void)
             /* free page list is now empty */
             cache->free_pages_chain_head = cache->free_pages_chain_tail = 0;
         } else { 
-            if (!imcs_file_read(imcs_file, &cache->free_pages_chain_head, sizeof cache->free_pages_chain_head, addr)) { 
+            if (!imcs_read_page_link(&cache->free_pages_chain_head, addr)) { 
                 imcs_ereport(ERRCODE_IO_ERROR, "Failed to read free page");
             }
             Assert(cache->free_pages_chain_tail != 0);
         }
+        if (imcs_compress_pages) { /* page is not yet written */
+            *imcs_page_map_entry(addr) = 0;
+        }
     } else { 
         addr = cache->file_size;
         cache->file_size += imcs_page_size;
+        if (imcs_compress_pages) { 
+            uint64 chunk = addr / imcs_page_size >> IMCS_PAGE_MAP_CHUNK_BITS;
+            if (chunk >= IMCS_PAGE_MAP_DIR_SIZE) { 
+                imcs_ereport(ERRCODE_PROGRAM_LIMIT_EXCEEDED, "too many pages in IMCS file");
+            }
+            if (cache->page_map[chunk] == NULL) { 
+                imcs_extent_t* map = (imcs_extent_t*)ShmemAlloc(IMCS_PAGE_MAP_CHUNK_SIZE*sizeof(imcs_extent_t));
+                if (map == NULL) { 
+                    imcs_ereport(ERRCODE_OUT_OF_MEMORY, "not enough shared memory for page map");
+                }
+                memset(map, 0, IMCS_PAGE_MAP_CHUNK_SIZE*sizeof(imcs_extent_t));
+                cache->page_map[chunk] = map;
+            }
+        }
     }
     cache->n_used_pages += 1;
     return (imcs_page_t*)(size_t)addr;
@@ -227,34 +886,44 @@ void imcs_free_page(imcs_page_t* pg)
     imcs_disk_cache_t* cache = imcs_disk_cache;
     size_t pid = ((char*)pg - cache->data)/imcs_page_size + 1;
     imcs_cache_item_t* item = &cache->items[pid];
-    int* pp;
-    size_t h = (size_t)(item->offs / imcs_page_size) % imcs_cache_size;    
+    uint64 offs = item->offs;
+    imcs_extent_t extent = 0;
 
-    Assert(pid-1 < (size_t)imcs_cache_size);
-    Assert(item->access_count == 1); /* removed page is pinned */
+    Assert(pid-1 < (size_t)cache->max_size);
+    Assert(item->access_count == (item->priority == IMCS_PRIORITY_RESIDENT ? 2 : 1)); /* removed page is pinned */
     
+    imcs_cache_lock(cache);
     /* remove item from hash table */
-    for (pp = &cache->hash_table[h]; *pp != pid; pp = &cache->items[*pp].collision) { 
-        Assert(*pp != 0); /* item should be present in collision chain */
-    }
-    *pp = item->collision;
+    imcs_exclude_from_hash(pid);
 
     /* exclude page from dirty list */
     if (item->dirty_index) { 
-        cache->dirty_pages[item->dirty_index-1] = cache->dirty_pages[--cache->n_dirty_pages];
+        imcs_exclude_from_dirty_list(item);
     }
+    item->offs = 0;
+    item->access_count = 0;
+    item->priority = IMCS_PRIORITY_NORMAL;
      
-    /* include item in free items list */
-    item->next = cache->free_items_chain;
-    cache->free_items_chain = pid;
+    /* include item in free items list (if it was not detached by cache resize) */
+    imcs_release_item(pid);
+    if (imcs_compress_pages) { /* release extent occupied by the page */
+        imcs_extent_t* entry = imcs_page_map_entry(offs);
+        extent = *entry;
+        *entry = IMCS_EXTENT_FREE;
+    }
+    SpinLockRelease(&cache->mutex);
+
+    if (extent != 0) { 
+        imcs_free_extent(extent);
+    }
 
     /* append page to free pages list */
     if (cache->free_pages_chain_tail != 0) { 
-        imcs_file_write(imcs_file, &item->offs, sizeof item->offs, cache->free_pages_chain_tail);
+        imcs_write_page_link(offs, cache->free_pages_chain_tail);
     } else { 
-        cache->free_pages_chain_head = item->offs;
+        cache->free_pages_chain_head = offs;
     }
-    cache->free_pages_chain_tail = item->offs;
+    cache->free_pages_chain_tail = offs;
     cache->n_used_pages -= 1;
 }
 
@@ -262,3 +931,25 @@ uint64 imcs_used_memory(void)
 {
     return imcs_disk_cache == NULL ? 0 : imcs_disk_cache->n_used_pages*imcs_page_size;
 }
+
+bool imcs_disk_get_stats(imcs_cache_stats_t* stats, bool per_backend, bool reset)
+{
+    imcs_disk_cache_t* cache = imcs_disk_cache;
+    if (cache == NULL) { 
+        return false;
+    }
+    SpinLockAcquire(&cache->mutex);
+    if (per_backend) { 
+        *stats = imcs_backend_stats;
+        if (reset) { 
+            memset(&imcs_backend_stats, 0, sizeof(imcs_backend_stats));
+        }
+    } else { 
+        *stats = cache->stats;
+        if (reset) { 
+            memset(&cache->stats, 0, sizeof(cache->stats));
+        }
+    }
+    SpinLockRelease(&cache->mutex);
+    return true;
+}
@@ -19,23 +19,81 @@ typedef struct imcs_cache_item_t_
     int    prev;
     int    dirty_index; /* for dirty page index of page in dirty_pages + 1, 0 otherwise  */
     int    access_count; /* page access counter */
+    int    priority; /* retention priority assigned by cs_pin (IMCS_PRIORITY_XXX) */
     volatile bool is_busy; /* page is currently loaded */
 } imcs_cache_item_t;
 
+/*
+ * Retention priorities of pages.
+ * Pages with IMCS_PRIORITY_HIGH are kept in LRU list together with internal pages, so them are not thrown away by sequential scans.
+ * Pages with IMCS_PRIORITY_RESIDENT are permanently pinned in the cache and never evicted.
+ */
+#define IMCS_PRIORITY_NORMAL   0
+#define IMCS_PRIORITY_HIGH     1
+#define IMCS_PRIORITY_RESIDENT 2
+
+/*
+ * When compression of pages is enabled, logical page address is mapped to the variable size extent in the file.
+ * Extent descriptor contains offset of extent (in IMCS_EXTENT_UNIT units), number of used units, 
+ * size class of extent (extent of class K contains 2^K units) and flag of raw (not compressed) page.
+ * Page map entry of free page contains IMCS_EXTENT_FREE flag and number of next free page in the list.
+ */
+typedef uint64 imcs_extent_t;
+
+#define IMCS_EXTENT_UNIT       512
+#define IMCS_EXTENT_CLASSES    9 /* 2^8 units = 128kb > maximal page size */
+#define IMCS_EXTENT_OFFS(e)    ((e) & (((uint64)1 << 48) - 1))
+#define IMCS_EXTENT_UNITS(e)   ((int)((e) >> 48) & 0xFF)
+#define IMCS_EXTENT_CLASS(e)   ((int)((e) >> 56) & 0xF)
+#define IMCS_EXTENT_RAW        ((uint64)1 << 60)
+#define IMCS_EXTENT_FREE       ((uint64)1 << 63)
+#define IMCS_MAKE_EXTENT(offs, units, cls) ((offs) | ((uint64)(units) << 48) | ((uint64)(cls) << 56))
+
+#define IMCS_PAGE_MAP_CHUNK_BITS 16
+#define IMCS_PAGE_MAP_CHUNK_SIZE (1 << IMCS_PAGE_MAP_CHUNK_BITS)
+#define IMCS_PAGE_MAP_DIR_SIZE   (1 << 16)
+
+/*
+ * Disk cache statistic. Latency histograms are logarithmic: bucket i counts operations which take less than 2^i microseconds
+ * (and not less than 2^(i-1)), last bucket counts all longer operations.
+ */
+#define IMCS_LATENCY_BUCKETS 16
+
+typedef struct 
+{
+    uint64 hits;          /* page is found in cache */
+    uint64 misses;        /* page is read from the disk */
+    uint64 new_pages;     /* new page is allocated in cache */
+    uint64 evictions;     /* page is thrown away from cache by LRU replacement */
+    uint64 dirty_writes;  /* dirty page is written on eviction (from the query path) */
+    uint64 flush_writes;  /* dirty page is written by imcs_disk_flush */
+    uint64 busy_waits;    /* waits for page which is concurrently loaded by other backend */
+    uint64 spinlock_contentions; /* cache spinlock is locked by other process at the moment of acquire */
+    uint64 read_latency[IMCS_LATENCY_BUCKETS];
+    uint64 write_latency[IMCS_LATENCY_BUCKETS];
+} imcs_cache_stats_t;
+
 typedef struct 
 {
-    imcs_cache_item_t* items; /* imcs_cache_item_t[imcs_cache_size+1], first item is used as head of LRU list */
-    char*   data; /* char[imcs_cache_size*imcs_page_size] */
-    int*    dirty_pages;  /* int[imcs_cache_size] */
-    int*    hash_table; /* int[imcs_cache_size] */
+    imcs_cache_item_t* items; /* imcs_cache_item_t[max_size+1], first item is used as head of LRU list */
+    char*   data; /* char[max_size*imcs_page_size] */
+    int*    dirty_pages;  /* int[max_size] */
+    int*    hash_table; /* int[max_size] */
+    int     size; /* current number of pages in cache (can be changed by imcs_disk_resize) */
+    int     max_size; /* number of pages for which space is reserved */
     int     n_dirty_pages; /* number of used items in array dirty_page */ 
-    int     n_used_items; /* number of used items in cache (<= imcs_cache_size), initially 0 */
+    int     n_used_items; /* number of used items in cache (<= size), initially 0 */
     int     free_items_chain; /* L1 list of free pages (linked by "next" field) */
     int     lru_internal; /* index of least recently used internal page: it is used to separate in LRU list leaf pages from internal pages */
     uint64  n_used_pages;
     uint64  file_size;  /* size of data file */
     uint64  free_pages_chain_head; /* head of L1-list of free pages */
     uint64  free_pages_chain_tail; /* tail of L1-list of free pages */
+    imcs_extent_t** page_map; /* directory of page map chunks (used only for compressed pages) */
+    uint64  file_extent_size; /* size of data file in extent units (used only for compressed pages) */
+    uint64  free_extents[IMCS_EXTENT_CLASSES]; /* heads of L1-lists of free extents of each size class */
+    uint64  free_extents_version[IMCS_EXTENT_CLASSES]; /* incremented on each change of free extents list */
+    imcs_cache_stats_t stats; /* statistic for all backends */
     slock_t mutex; /* spinlock synchronizing access to the cache */
 } imcs_disk_cache_t;
 
@@ -60,6 +118,13 @@ void imcs_disk_initialize(imcs_disk_cache_t* cache);
 void imcs_disk_open(void);
 void imcs_disk_close(void);
 void imcs_disk_flush(void);
+int  imcs_disk_resize(int new_size);
+void imcs_set_page_priority(imcs_page_t* pg, int priority);
+/* 
+ * Get statistic of disk cache for all backends or for the current backend. 
+ * Returns false if disk cache is not initialized.
+ */
+bool imcs_disk_get_stats(imcs_cache_stats_t* stats, bool per_backend, bool reset);
 
 #else
 
@@ -72,6 +137,9 @@ void imcs_disk_flush(void);
 #define imcs_disk_open()
 #define imcs_disk_close()
 #define imcs_disk_flush()
+#define imcs_disk_resize(new_size) (imcs_ereport(ERRCODE_FEATURE_NOT_SUPPORTED, "IMCS was built without disk support"), 0)
+#define imcs_set_page_priority(pg, priority)
+#define imcs_disk_get_stats(stats, per_backend, reset) false
 
 #endif
 
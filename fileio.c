@@ -3,10 +3,11 @@
 
 #ifdef _WIN32
 
-imcs_file_h imcs_file_open(char const* path)
+imcs_file_h imcs_file_open(char const* path, bool direct_io)
 {
     HANDLE h = CreateFile(path, GENERIC_READ | GENERIC_WRITE,
-                          FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, 0, NULL);
+                          FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_ALWAYS, 
+                          direct_io ? FILE_FLAG_NO_BUFFERING|FILE_FLAG_WRITE_THROUGH : 0, NULL);
 
     if (h == INVALID_HANDLE_VALUE) { 
         imcs_ereport(ERRCODE_UNDEFINED_FILE, "Failed to open file '%s': %d", path, GetLastError());
@@ -55,6 +56,14 @@ void imcs_file_write(imcs_file_h file, void const* buf, size_t size, off_t pos)
     }
 }
 
+void imcs_file_writev(imcs_file_h file, void const* const* bufs, int n_bufs, size_t size, off_t pos)
+{
+    int i;
+    for (i = 0; i < n_bufs; i++) { 
+        imcs_file_write(file, bufs[i], size, pos + (off_t)i*size);
+    }
+}
+
 void   imcs_file_close(imcs_file_h file)
 {
     if (!CloseHandle(file)) {
@@ -69,17 +78,30 @@ void   imcs_file_close(imcs_file_h file)
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 #ifndef O_LARGEFILE
     #define O_LARGEFILE 0
 #endif
 
-imcs_file_h imcs_file_open(char const* path)
+imcs_file_h imcs_file_open(char const* path, bool direct_io)
 {
-    int rc = open(path, O_LARGEFILE | O_RDWR | O_CREAT, 0600);
+    int flags = O_LARGEFILE | O_RDWR | O_CREAT;
+    int rc;
+    if (direct_io) { 
+#ifdef O_DIRECT
+        flags |= O_DIRECT;
+#endif
+    }
+    rc = open(path, flags, 0600);
     if (rc < 0) { 
         imcs_ereport(ERRCODE_UNDEFINED_FILE, "Failed to open file '%s': %d", path, errno);
     }
+#if defined(F_NOCACHE)
+    if (direct_io) { /* OS/X has no O_DIRECT, but allows to disable caching for the opened file */
+        fcntl(rc, F_NOCACHE, 1);
+    }
+#endif
     return rc;
 }
 
@@ -101,6 +123,29 @@ void imcs_file_write(imcs_file_h file, void const* buf, size_t size, off_t pos)
     }
 }
 
+void imcs_file_writev(imcs_file_h file, void const* const* bufs, int n_bufs, size_t size, off_t pos)
+{
+#if defined(__linux__) || defined(__FreeBSD__)
+    struct iovec iov[IMCS_MAX_IO_BATCH];
+    ssize_t rc;
+    int i;
+    Assert(n_bufs <= IMCS_MAX_IO_BATCH);
+    for (i = 0; i < n_bufs; i++) { 
+        iov[i].iov_base = (void*)bufs[i];
+        iov[i].iov_len = size;
+    }
+    rc = pwritev(file, iov, n_bufs, pos);
+    if (rc != (ssize_t)(size*n_bufs)) { 
+        imcs_ereport(ERRCODE_IO_ERROR, "File write failed: %d", errno);
+    }
+#else
+    int i;
+    for (i = 0; i < n_bufs; i++) { 
+        imcs_file_write(file, bufs[i], size, pos + (off_t)i*size);
+    }
+#endif
+}
+
 void imcs_file_close(imcs_file_h file)
 {
     if (close(file) < 0) {
@@ -15,9 +15,23 @@ typedef void* imcs_file_h;
 typedef int imcs_file_h;
 #endif
 
-imcs_file_h imcs_file_open(char const* path);
+/* 
+ * Alignment of buffers, offsets and sizes required for direct (unbuffered) IO
+ */
+#define IMCS_IO_ALIGNMENT 4096
+/* 
+ * Maximal number of pages written by one imcs_file_writev call 
+ */
+#define IMCS_MAX_IO_BATCH 64
+
+imcs_file_h imcs_file_open(char const* path, bool direct_io);
 bool imcs_file_read(imcs_file_h file, void* buf, size_t size, off_t pos);
 void imcs_file_write(imcs_file_h file, void const* buf, size_t size, off_t pos);
+/* 
+ * Write n_bufs buffers of the same size to the adjacent locations of the file starting from "pos"
+ * (n_bufs should not be greater than IMCS_MAX_IO_BATCH)
+ */
+void imcs_file_writev(imcs_file_h file, void const* const* bufs, int n_bufs, size_t size, off_t pos);
 void imcs_file_close(imcs_file_h file);
 
 #endif
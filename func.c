@@ -1,5 +1,7 @@
 #include "func.h"
 #include "btree.h"
+#include "smp.h"
+#include "simd.h"
 #if PG_VERSION_NUM>=120000
 #include "utils/float.h"
 #endif
@@ -103,10 +105,10 @@ bool imcs_next_char(imcs_iterator_h iterator, void* val)
 }
 
 
-#define IMCS_BINARY_DEF(RET_TYPE, TYPE, MNEM, APPLY, OPERATOR)          \
+#define IMCS_BINARY_ITERATOR_DEF(RET_TYPE, TYPE, MNEM, KERNEL)         \
 static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
 {                                                                       \
-    size_t i, tile_size;                                                \
+    size_t tile_size;                                                   \
     if (!iterator->opd[0]->next(iterator->opd[0])) {                    \
         return false;                                                   \
     }                                                                   \
@@ -117,9 +119,7 @@ static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
     if (tile_size > iterator->opd[1]->tile_size) {                      \
         tile_size = iterator->opd[1]->tile_size;                        \
     }                                                                   \
-    for (i = 0; i < tile_size; i++) {                                   \
-        iterator->tile.arr_##RET_TYPE[i] = APPLY(OPERATOR, iterator->opd[0]->tile.arr_##TYPE[i], iterator->opd[1]->tile.arr_##TYPE[i]); \
-    }                                                                   \
+    KERNEL(iterator->tile.arr_##RET_TYPE, iterator->opd[0]->tile.arr_##TYPE, iterator->opd[1]->tile.arr_##TYPE, tile_size); \
     iterator->tile_size = tile_size;                                    \
     iterator->next_pos += tile_size;                                    \
     return true;                                                        \
@@ -138,36 +138,47 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h left, imcs_iterator_h right
     return result;                                                      \
 }
 
-#define IMCS_BIN_OP(OP, x, y) (x) OP (y)
-#define IMCS_BIN_FUNC(OP, x, y) OP(x, y)
-
-IMCS_BINARY_DEF(int8, int8, add, IMCS_BIN_OP, +)
-IMCS_BINARY_DEF(int16, int16, add, IMCS_BIN_OP, +)
-IMCS_BINARY_DEF(int32, int32, add, IMCS_BIN_OP, +)
-IMCS_BINARY_DEF(int64, int64, add, IMCS_BIN_OP, +)
-IMCS_BINARY_DEF(float, float, add, IMCS_BIN_OP, +)
-IMCS_BINARY_DEF(double, double, add, IMCS_BIN_OP, +)
-
-IMCS_BINARY_DEF(int8, int8, sub, IMCS_BIN_OP, -)
-IMCS_BINARY_DEF(int16, int16, sub, IMCS_BIN_OP, -)
-IMCS_BINARY_DEF(int32, int32, sub, IMCS_BIN_OP, -)
-IMCS_BINARY_DEF(int64, int64, sub, IMCS_BIN_OP, -)
-IMCS_BINARY_DEF(float, float, sub, IMCS_BIN_OP, -)
-IMCS_BINARY_DEF(double, double, sub, IMCS_BIN_OP, -)
-
-IMCS_BINARY_DEF(int8, int8, mul, IMCS_BIN_OP, *)
-IMCS_BINARY_DEF(int16, int16, mul, IMCS_BIN_OP, *)
-IMCS_BINARY_DEF(int32, int32, mul, IMCS_BIN_OP, *)
-IMCS_BINARY_DEF(int64, int64, mul, IMCS_BIN_OP, *)
-IMCS_BINARY_DEF(float, float, mul, IMCS_BIN_OP, *)
-IMCS_BINARY_DEF(double, double, mul, IMCS_BIN_OP, *)
+/* Operator with scalar loop */
+#define IMCS_BINARY_DEF(RET_TYPE, TYPE, MNEM, APPLY, OPERATOR)          \
+static void imcs_##MNEM##_##TYPE##_kernel(RET_TYPE* dst, TYPE const* x, TYPE const* y, size_t n) \
+{                                                                       \
+    size_t i;                                                           \
+    for (i = 0; i < n; i++) {                                           \
+        dst[i] = APPLY(OPERATOR, x[i], y[i]);                           \
+    }                                                                   \
+}                                                                       \
+IMCS_BINARY_ITERATOR_DEF(RET_TYPE, TYPE, MNEM, imcs_##MNEM##_##TYPE##_kernel)
+
+/* Operator with vectorized kernel from simd.c */
+#define IMCS_BINARY_SIMD_DEF(RET_TYPE, TYPE, MNEM) IMCS_BINARY_ITERATOR_DEF(RET_TYPE, TYPE, MNEM, imcs_simd_##MNEM##_##TYPE)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, add)
+IMCS_BINARY_SIMD_DEF(int16, int16, add)
+IMCS_BINARY_SIMD_DEF(int32, int32, add)
+IMCS_BINARY_SIMD_DEF(int64, int64, add)
+IMCS_BINARY_SIMD_DEF(float, float, add)
+IMCS_BINARY_SIMD_DEF(double, double, add)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, sub)
+IMCS_BINARY_SIMD_DEF(int16, int16, sub)
+IMCS_BINARY_SIMD_DEF(int32, int32, sub)
+IMCS_BINARY_SIMD_DEF(int64, int64, sub)
+IMCS_BINARY_SIMD_DEF(float, float, sub)
+IMCS_BINARY_SIMD_DEF(double, double, sub)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, mul)
+IMCS_BINARY_SIMD_DEF(int16, int16, mul)
+IMCS_BINARY_SIMD_DEF(int32, int32, mul)
+IMCS_BINARY_SIMD_DEF(int64, int64, mul)
+IMCS_BINARY_SIMD_DEF(float, float, mul)
+IMCS_BINARY_SIMD_DEF(double, double, mul)
 
 IMCS_BINARY_DEF(int8, int8, div, IMCS_BIN_OP, /)
 IMCS_BINARY_DEF(int16, int16, div, IMCS_BIN_OP, /)
 IMCS_BINARY_DEF(int32, int32, div, IMCS_BIN_OP, /)
 IMCS_BINARY_DEF(int64, int64, div, IMCS_BIN_OP, /)
-IMCS_BINARY_DEF(float, float, div, IMCS_BIN_OP, /)
-IMCS_BINARY_DEF(double, double, div, IMCS_BIN_OP, /)
+IMCS_BINARY_SIMD_DEF(float, float, div)
+IMCS_BINARY_SIMD_DEF(double, double, div)
 
 IMCS_BINARY_DEF(int8, int8, mod, IMCS_BIN_OP, %)
 IMCS_BINARY_DEF(int16, int16, mod, IMCS_BIN_OP, %)
@@ -183,89 +194,85 @@ IMCS_BINARY_DEF(double, int64, pow, IMCS_BIN_FUNC, pow)
 IMCS_BINARY_DEF(double, float, pow, IMCS_BIN_FUNC, pow)
 IMCS_BINARY_DEF(double, double, pow, IMCS_BIN_FUNC, pow)
 
-IMCS_BINARY_DEF(int8, int8, eq, IMCS_BIN_OP, ==)
-IMCS_BINARY_DEF(int8, int16, eq, IMCS_BIN_OP, ==)
-IMCS_BINARY_DEF(int8, int32, eq, IMCS_BIN_OP, ==)
-IMCS_BINARY_DEF(int8, int64, eq, IMCS_BIN_OP, ==)
-IMCS_BINARY_DEF(int8, float, eq, IMCS_BIN_OP, ==)
-IMCS_BINARY_DEF(int8, double, eq, IMCS_BIN_OP, ==)
-
-IMCS_BINARY_DEF(int8, int8, ne, IMCS_BIN_OP, !=)
-IMCS_BINARY_DEF(int8, int16, ne, IMCS_BIN_OP, !=)
-IMCS_BINARY_DEF(int8, int32, ne, IMCS_BIN_OP, !=)
-IMCS_BINARY_DEF(int8, int64, ne, IMCS_BIN_OP, !=)
-IMCS_BINARY_DEF(int8, float, ne, IMCS_BIN_OP, !=)
-IMCS_BINARY_DEF(int8, double, ne, IMCS_BIN_OP, !=)
-
-IMCS_BINARY_DEF(int8, int8, ge, IMCS_BIN_OP, >=)
-IMCS_BINARY_DEF(int8, int16, ge, IMCS_BIN_OP, >=)
-IMCS_BINARY_DEF(int8, int32, ge, IMCS_BIN_OP, >=)
-IMCS_BINARY_DEF(int8, int64, ge, IMCS_BIN_OP, >=)
-IMCS_BINARY_DEF(int8, float, ge, IMCS_BIN_OP, >=)
-IMCS_BINARY_DEF(int8, double, ge, IMCS_BIN_OP, >=)
-
-IMCS_BINARY_DEF(int8, int8, le, IMCS_BIN_OP, <=)
-IMCS_BINARY_DEF(int8, int16, le, IMCS_BIN_OP, <=)
-IMCS_BINARY_DEF(int8, int32, le, IMCS_BIN_OP, <=)
-IMCS_BINARY_DEF(int8, int64, le, IMCS_BIN_OP, <=)
-IMCS_BINARY_DEF(int8, float, le, IMCS_BIN_OP, <=)
-IMCS_BINARY_DEF(int8, double, le, IMCS_BIN_OP, <=)
-
-IMCS_BINARY_DEF(int8, int8, gt, IMCS_BIN_OP, >)
-IMCS_BINARY_DEF(int8, int16, gt, IMCS_BIN_OP, >)
-IMCS_BINARY_DEF(int8, int32, gt, IMCS_BIN_OP, >)
-IMCS_BINARY_DEF(int8, int64, gt, IMCS_BIN_OP, >)
-IMCS_BINARY_DEF(int8, float, gt, IMCS_BIN_OP, >)
-IMCS_BINARY_DEF(int8, double, gt, IMCS_BIN_OP, >)
-
-IMCS_BINARY_DEF(int8, int8, lt, IMCS_BIN_OP, <)
-IMCS_BINARY_DEF(int8, int16, lt, IMCS_BIN_OP, <)
-IMCS_BINARY_DEF(int8, int32, lt, IMCS_BIN_OP, <)
-IMCS_BINARY_DEF(int8, int64, lt, IMCS_BIN_OP, <)
-IMCS_BINARY_DEF(int8, float, lt, IMCS_BIN_OP, <)
-IMCS_BINARY_DEF(int8, double, lt, IMCS_BIN_OP, <)
-
-IMCS_BINARY_DEF(int8, int8, and, IMCS_BIN_OP, &)
-IMCS_BINARY_DEF(int16, int16, and, IMCS_BIN_OP, &)
-IMCS_BINARY_DEF(int32, int32, and, IMCS_BIN_OP, &)
-IMCS_BINARY_DEF(int64, int64, and, IMCS_BIN_OP, &)
-IMCS_BINARY_DEF(int8, int8, or, IMCS_BIN_OP, |)
-IMCS_BINARY_DEF(int16, int16, or, IMCS_BIN_OP, |)
-IMCS_BINARY_DEF(int32, int32, or, IMCS_BIN_OP, |)
-IMCS_BINARY_DEF(int64, int64, or, IMCS_BIN_OP, |)
-IMCS_BINARY_DEF(int8, int8, xor, IMCS_BIN_OP, ^)
-IMCS_BINARY_DEF(int16, int16, xor, IMCS_BIN_OP, ^)
-IMCS_BINARY_DEF(int32, int32, xor, IMCS_BIN_OP, ^)
-IMCS_BINARY_DEF(int64, int64, xor, IMCS_BIN_OP, ^)
-
-#define IMCS_COND(OP, x, y) ((x) OP (y) ? (x) : (y))
-
-IMCS_BINARY_DEF(int8, int8, maxof, IMCS_COND, >)
-IMCS_BINARY_DEF(int16, int16, maxof, IMCS_COND, >)
-IMCS_BINARY_DEF(int32, int32, maxof, IMCS_COND, >)
-IMCS_BINARY_DEF(int64, int64, maxof, IMCS_COND, >)
-IMCS_BINARY_DEF(float, float, maxof, IMCS_COND, >)
-IMCS_BINARY_DEF(double, double, maxof, IMCS_COND, >)
-
-IMCS_BINARY_DEF(int8, int8, minof, IMCS_COND, <)
-IMCS_BINARY_DEF(int16, int16, minof, IMCS_COND, <)
-IMCS_BINARY_DEF(int32, int32, minof, IMCS_COND, <)
-IMCS_BINARY_DEF(int64, int64, minof, IMCS_COND, <)
-IMCS_BINARY_DEF(float, float, minof, IMCS_COND, <)
-IMCS_BINARY_DEF(double, double, minof, IMCS_COND, <)
-
-
-#define IMCS_UNARY_DEF(RES_TYPE, TYPE, MNEM, OPERATION)                 \
+IMCS_BINARY_SIMD_DEF(int8, int8, eq)
+IMCS_BINARY_SIMD_DEF(int8, int16, eq)
+IMCS_BINARY_SIMD_DEF(int8, int32, eq)
+IMCS_BINARY_SIMD_DEF(int8, int64, eq)
+IMCS_BINARY_SIMD_DEF(int8, float, eq)
+IMCS_BINARY_SIMD_DEF(int8, double, eq)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, ne)
+IMCS_BINARY_SIMD_DEF(int8, int16, ne)
+IMCS_BINARY_SIMD_DEF(int8, int32, ne)
+IMCS_BINARY_SIMD_DEF(int8, int64, ne)
+IMCS_BINARY_SIMD_DEF(int8, float, ne)
+IMCS_BINARY_SIMD_DEF(int8, double, ne)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, ge)
+IMCS_BINARY_SIMD_DEF(int8, int16, ge)
+IMCS_BINARY_SIMD_DEF(int8, int32, ge)
+IMCS_BINARY_SIMD_DEF(int8, int64, ge)
+IMCS_BINARY_SIMD_DEF(int8, float, ge)
+IMCS_BINARY_SIMD_DEF(int8, double, ge)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, le)
+IMCS_BINARY_SIMD_DEF(int8, int16, le)
+IMCS_BINARY_SIMD_DEF(int8, int32, le)
+IMCS_BINARY_SIMD_DEF(int8, int64, le)
+IMCS_BINARY_SIMD_DEF(int8, float, le)
+IMCS_BINARY_SIMD_DEF(int8, double, le)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, gt)
+IMCS_BINARY_SIMD_DEF(int8, int16, gt)
+IMCS_BINARY_SIMD_DEF(int8, int32, gt)
+IMCS_BINARY_SIMD_DEF(int8, int64, gt)
+IMCS_BINARY_SIMD_DEF(int8, float, gt)
+IMCS_BINARY_SIMD_DEF(int8, double, gt)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, lt)
+IMCS_BINARY_SIMD_DEF(int8, int16, lt)
+IMCS_BINARY_SIMD_DEF(int8, int32, lt)
+IMCS_BINARY_SIMD_DEF(int8, int64, lt)
+IMCS_BINARY_SIMD_DEF(int8, float, lt)
+IMCS_BINARY_SIMD_DEF(int8, double, lt)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, and)
+IMCS_BINARY_SIMD_DEF(int16, int16, and)
+IMCS_BINARY_SIMD_DEF(int32, int32, and)
+IMCS_BINARY_SIMD_DEF(int64, int64, and)
+IMCS_BINARY_SIMD_DEF(int8, int8, or)
+IMCS_BINARY_SIMD_DEF(int16, int16, or)
+IMCS_BINARY_SIMD_DEF(int32, int32, or)
+IMCS_BINARY_SIMD_DEF(int64, int64, or)
+IMCS_BINARY_SIMD_DEF(int8, int8, xor)
+IMCS_BINARY_SIMD_DEF(int16, int16, xor)
+IMCS_BINARY_SIMD_DEF(int32, int32, xor)
+IMCS_BINARY_SIMD_DEF(int64, int64, xor)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, maxof)
+IMCS_BINARY_SIMD_DEF(int16, int16, maxof)
+IMCS_BINARY_SIMD_DEF(int32, int32, maxof)
+IMCS_BINARY_SIMD_DEF(int64, int64, maxof)
+IMCS_BINARY_SIMD_DEF(float, float, maxof)
+IMCS_BINARY_SIMD_DEF(double, double, maxof)
+
+IMCS_BINARY_SIMD_DEF(int8, int8, minof)
+IMCS_BINARY_SIMD_DEF(int16, int16, minof)
+IMCS_BINARY_SIMD_DEF(int32, int32, minof)
+IMCS_BINARY_SIMD_DEF(int64, int64, minof)
+IMCS_BINARY_SIMD_DEF(float, float, minof)
+IMCS_BINARY_SIMD_DEF(double, double, minof)
+
+
+#define IMCS_UNARY_ITERATOR_DEF(RES_TYPE, TYPE, MNEM, KERNEL)          \
 static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
 {                                                                       \
-    size_t i, tile_size;                                                \
+    size_t tile_size;                                                   \
     if (!iterator->opd[0]->next(iterator->opd[0])) {                    \
         return false;                                                   \
     }                                                                   \
     tile_size = iterator->opd[0]->tile_size;                            \
-    for (i = 0; i < tile_size; i++) {                                   \
-        iterator->tile.arr_##RES_TYPE[i] = OPERATION(iterator->opd[0]->tile.arr_##TYPE[i]); \
-    }                                                                   \
+    KERNEL(iterator->tile.arr_##RES_TYPE, iterator->opd[0]->tile.arr_##TYPE, tile_size); \
     iterator->tile_size = tile_size;                                    \
     iterator->next_pos += tile_size;                                    \
     return true;                                                        \
@@ -282,34 +289,44 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input)             \
     return result;                                                      \
 }
 
-#define IMCS_ABS(x) (x < 0 ? -x : x)
-IMCS_UNARY_DEF(int8, int8, abs, IMCS_ABS)
-IMCS_UNARY_DEF(int16, int16, abs, IMCS_ABS)
-IMCS_UNARY_DEF(int32, int32, abs, IMCS_ABS)
-IMCS_UNARY_DEF(int64, int64, abs, IMCS_ABS)
-IMCS_UNARY_DEF(float, float, abs, IMCS_ABS)
-IMCS_UNARY_DEF(double, double, abs, IMCS_ABS)
+/* Operator with scalar loop */
+#define IMCS_UNARY_DEF(RES_TYPE, TYPE, MNEM, OPERATION)                 \
+static void imcs_##MNEM##_##TYPE##_kernel(RES_TYPE* dst, TYPE const* src, size_t n) \
+{                                                                       \
+    size_t i;                                                           \
+    for (i = 0; i < n; i++) {                                           \
+        dst[i] = OPERATION(src[i]);                                     \
+    }                                                                   \
+}                                                                       \
+IMCS_UNARY_ITERATOR_DEF(RES_TYPE, TYPE, MNEM, imcs_##MNEM##_##TYPE##_kernel)
+
+/* Operator with vectorized kernel from simd.c */
+#define IMCS_UNARY_SIMD_DEF(RES_TYPE, TYPE, MNEM) IMCS_UNARY_ITERATOR_DEF(RES_TYPE, TYPE, MNEM, imcs_simd_##MNEM##_##TYPE)
 
-#define IMCS_NEG(x) (-x)
-IMCS_UNARY_DEF(int8, int8, neg, IMCS_NEG)
-IMCS_UNARY_DEF(int16, int16, neg, IMCS_NEG)
-IMCS_UNARY_DEF(int32, int32, neg, IMCS_NEG)
-IMCS_UNARY_DEF(int64, int64, neg, IMCS_NEG)
-IMCS_UNARY_DEF(float, float, neg, IMCS_NEG)
-IMCS_UNARY_DEF(double, double, neg, IMCS_NEG)
+IMCS_UNARY_SIMD_DEF(int8, int8, abs)
+IMCS_UNARY_SIMD_DEF(int16, int16, abs)
+IMCS_UNARY_SIMD_DEF(int32, int32, abs)
+IMCS_UNARY_SIMD_DEF(int64, int64, abs)
+IMCS_UNARY_SIMD_DEF(float, float, abs)
+IMCS_UNARY_SIMD_DEF(double, double, abs)
 
+IMCS_UNARY_SIMD_DEF(int8, int8, neg)
+IMCS_UNARY_SIMD_DEF(int16, int16, neg)
+IMCS_UNARY_SIMD_DEF(int32, int32, neg)
+IMCS_UNARY_SIMD_DEF(int64, int64, neg)
+IMCS_UNARY_SIMD_DEF(float, float, neg)
+IMCS_UNARY_SIMD_DEF(double, double, neg)
 
-#define IMCS_LOGICAL_NOT(x) !(x)
-IMCS_UNARY_DEF(int8, int8, not, IMCS_LOGICAL_NOT)
-IMCS_UNARY_DEF(int8, int16, not, IMCS_LOGICAL_NOT)
-IMCS_UNARY_DEF(int8, int32, not, IMCS_LOGICAL_NOT)
-IMCS_UNARY_DEF(int8, int64, not, IMCS_LOGICAL_NOT)
 
-#define IMCS_BIT_NOT(x) ~(x)
-IMCS_UNARY_DEF(int8, int8, bit_not, IMCS_BIT_NOT)
-IMCS_UNARY_DEF(int16, int16, bit_not, IMCS_BIT_NOT)
-IMCS_UNARY_DEF(int32, int32, bit_not, IMCS_BIT_NOT)
-IMCS_UNARY_DEF(int64, int64, bit_not, IMCS_BIT_NOT)
+IMCS_UNARY_SIMD_DEF(int8, int8, not)
+IMCS_UNARY_SIMD_DEF(int8, int16, not)
+IMCS_UNARY_SIMD_DEF(int8, int32, not)
+IMCS_UNARY_SIMD_DEF(int8, int64, not)
+
+IMCS_UNARY_SIMD_DEF(int8, int8, bit_not)
+IMCS_UNARY_SIMD_DEF(int16, int16, bit_not)
+IMCS_UNARY_SIMD_DEF(int32, int32, bit_not)
+IMCS_UNARY_SIMD_DEF(int64, int64, bit_not)
 
 #define IMCS_ISNAN(x) isnan(x)
 IMCS_UNARY_DEF(int8, float, isnan, IMCS_ISNAN)
@@ -1001,14 +1018,12 @@ IMCS_COMPARE_CHAR_DEF(ge, >=)
 #define IMCS_CAST_DEF(FROM_TYPE, TO_TYPE)                               \
 static bool imcs_##TO_TYPE##_from_##FROM_TYPE##_next(imcs_iterator_h iterator) \
 {                                                                       \
-    size_t i, tile_size;                                                \
+    size_t tile_size;                                                   \
     if (!iterator->opd[0]->next(iterator->opd[0])) {                    \
         return false;                                                   \
     }                                                                   \
     tile_size = iterator->opd[0]->tile_size;                            \
-    for (i = 0; i < tile_size; i++) {                                   \
-        iterator->tile.arr_##TO_TYPE[i] = (TO_TYPE)iterator->opd[0]->tile.arr_##FROM_TYPE[i]; \
-    }                                                                   \
+    imcs_simd_##TO_TYPE##_from_##FROM_TYPE(iterator->tile.arr_##TO_TYPE, iterator->opd[0]->tile.arr_##FROM_TYPE, tile_size); \
     iterator->tile_size = tile_size;                                    \
     iterator->next_pos += tile_size;                                    \
     return true;                                                        \
@@ -1417,31 +1432,115 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input)             \
     return result;                                                      \
 }
 
+/*
+ * Aggregate which whole tile is processed by reduction kernel from simd.c.
+ * INIT is applied to the first tile, ACCUMULATE_TILE - to each tile and FINISH - after the last tile.
+ */
+#define IMCS_TILE_AGG_DEF(TYPE, AGG_TYPE, MNEM, INIT, ACCUMULATE_TILE, FINISH, ACCUMULATE, RESULT) \
+typedef struct {                                                        \
+    AGG_TYPE agg;                                                       \
+    double norm;                                                        \
+    imcs_count_t count;                                                 \
+    imcs_float_sum_t sum;                                               \
+} imcs_##MNEM##_##TYPE##_context_t;                                     \
+static void imcs_##MNEM##_##TYPE##_merge(imcs_iterator_h dst, imcs_iterator_h src) \
+{                                                                       \
+    imcs_##MNEM##_##TYPE##_context_t* src_ctx = (imcs_##MNEM##_##TYPE##_context_t*)src->context; \
+    imcs_##MNEM##_##TYPE##_context_t* dst_ctx = (imcs_##MNEM##_##TYPE##_context_t*)dst->context; \
+    double norm = 0;                                                    \
+    dst_ctx->agg = ACCUMULATE(dst_ctx->agg, src_ctx->agg);              \
+    dst_ctx->count += src_ctx->count;                                   \
+    norm = dst_ctx->norm + src_ctx->norm;                               \
+    dst_ctx->norm = norm;                                               \
+    dst->tile.arr_##AGG_TYPE[0] = RESULT(dst_ctx->agg, dst_ctx->count); \
+}                                                                       \
+static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
+{                                                                       \
+    imcs_##MNEM##_##TYPE##_context_t* ctx = (imcs_##MNEM##_##TYPE##_context_t*)iterator->context; \
+    size_t tile_size;                                                   \
+    imcs_count_t count = 0;                                             \
+    AGG_TYPE agg = 0;                                                   \
+    double norm = 0;                                                    \
+    if (iterator->flags & FLAG_PREPARED) {                              \
+        return iterator->tile_size != 0;                                \
+    }                                                                   \
+    if (iterator->next_pos != 0) {                                      \
+        return false;                                                   \
+    }                                                                   \
+    if (!iterator->opd[0]->next(iterator->opd[0])) {                    \
+        return false;                                                   \
+    }                                                                   \
+    INIT(TYPE, iterator->opd[0]->tile.arr_##TYPE);                      \
+    do {                                                                \
+        tile_size = iterator->opd[0]->tile_size;                        \
+        count += tile_size;                                             \
+        ACCUMULATE_TILE(TYPE, iterator->opd[0]->tile.arr_##TYPE, tile_size); \
+    } while (iterator->opd[0]->next(iterator->opd[0]));                 \
+    FINISH(TYPE);                                                       \
+    Assert(count != 0);                                                 \
+    iterator->next_pos = 1;                                             \
+    iterator->tile_size = 1;                                            \
+    iterator->tile.arr_##AGG_TYPE[0] = RESULT(agg, count);              \
+    ctx->agg = agg;                                                     \
+    ctx->norm = norm;                                                   \
+    ctx->count = count;                                                 \
+    return true;                                                        \
+}                                                                       \
+                                                                        \
+imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input)             \
+{                                                                       \
+    imcs_iterator_h result = imcs_new_iterator(sizeof(AGG_TYPE), sizeof(imcs_##MNEM##_##TYPE##_context_t)); \
+    imcs_##MNEM##_##TYPE##_context_t* ctx = (imcs_##MNEM##_##TYPE##_context_t*)result->context; \
+    IMCS_CHECK_TYPE(input->elem_type, TID_##TYPE);                      \
+    result->elem_type = TID_##AGG_TYPE;                                 \
+    result->opd[0] = imcs_operand(input);                               \
+    result->next = imcs_##MNEM##_##TYPE##_next;                         \
+    result->prepare = imcs_##MNEM##_##TYPE##_next;                      \
+    result->merge = imcs_##MNEM##_##TYPE##_merge;                       \
+    ctx->count = 0;                                                     \
+    return result;                                                      \
+}
+
+#define IMCS_TILE_NOP(TYPE)
+#define IMCS_TILE_NOP_INIT(TYPE, tile)
+#define IMCS_TILE_FIRST_INIT(TYPE, tile) (agg = (tile)[0])
+#define IMCS_TILE_MAX(TYPE, tile, n) do { TYPE tile_max = imcs_simd_max_##TYPE(tile, n); agg = IMCS_MAX_ACCUMULATE(agg, tile_max); } while (0)
+#define IMCS_TILE_MIN(TYPE, tile, n) do { TYPE tile_min = imcs_simd_min_##TYPE(tile, n); agg = IMCS_MIN_ACCUMULATE(agg, tile_min); } while (0)
+#define IMCS_TILE_SUM(TYPE, tile, n) (agg += imcs_simd_sum_##TYPE(tile, n))
+#define IMCS_TILE_DSUM(TYPE, tile, n) (agg += imcs_simd_dsum_##TYPE(tile, n))
+#define IMCS_TILE_SUM2(TYPE, tile, n) imcs_simd_sum2_##TYPE(tile, n, &agg, &norm)
+/* Summation of floating point values by method specified by imcs.float_sum */
+#define IMCS_TILE_FLOAT_SUM_INIT(TYPE, tile) imcs_float_sum_init(&ctx->sum)
+#define IMCS_TILE_FLOAT_SUM(TYPE, tile, n) imcs_float_sum_##TYPE(&ctx->sum, tile, n, imcs_float_sum)
+#define IMCS_TILE_FLOAT_SUM_FINISH(TYPE) (agg = imcs_float_sum_result(&ctx->sum))
+/* Partial sums of parallel workers are merged by accumulators, so compensation of Kahan summation is not lost */
+#define IMCS_FLOAT_SUM_MERGE(agg, val) (imcs_float_sum_merge(&dst_ctx->sum, &src_ctx->sum, imcs_float_sum), imcs_float_sum_result(&dst_ctx->sum))
+
 #define IMCS_AGG_INIT(val) (val)
 #define IMCS_MAX_ACCUMULATE(agg, val) (agg < val ? val : agg)
 #define IMCS_AGG_RESULT(agg, count) (agg)
-IMCS_AGG_DEF(int8, int8, max, IMCS_AGG_INIT, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int16, int16, max, IMCS_AGG_INIT, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int32, int32, max, IMCS_AGG_INIT, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int64, int64, max, IMCS_AGG_INIT, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(float, float, max, IMCS_AGG_INIT, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(double, double, max, IMCS_AGG_INIT, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int8, int8, max, IMCS_TILE_FIRST_INIT, IMCS_TILE_MAX, IMCS_TILE_NOP, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int16, int16, max, IMCS_TILE_FIRST_INIT, IMCS_TILE_MAX, IMCS_TILE_NOP, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int32, int32, max, IMCS_TILE_FIRST_INIT, IMCS_TILE_MAX, IMCS_TILE_NOP, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int64, int64, max, IMCS_TILE_FIRST_INIT, IMCS_TILE_MAX, IMCS_TILE_NOP, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(float, float, max, IMCS_TILE_FIRST_INIT, IMCS_TILE_MAX, IMCS_TILE_NOP, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(double, double, max, IMCS_TILE_FIRST_INIT, IMCS_TILE_MAX, IMCS_TILE_NOP, IMCS_MAX_ACCUMULATE, IMCS_AGG_RESULT)
 
 #define IMCS_MIN_ACCUMULATE(agg, val) (agg > val ? val : agg)
-IMCS_AGG_DEF(int8, int8, min, IMCS_AGG_INIT, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int16, int16, min, IMCS_AGG_INIT, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int32, int32, min, IMCS_AGG_INIT, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int64, int64, min, IMCS_AGG_INIT, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(float, float, min, IMCS_AGG_INIT, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(double, double, min, IMCS_AGG_INIT, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int8, int8, min, IMCS_TILE_FIRST_INIT, IMCS_TILE_MIN, IMCS_TILE_NOP, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int16, int16, min, IMCS_TILE_FIRST_INIT, IMCS_TILE_MIN, IMCS_TILE_NOP, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int32, int32, min, IMCS_TILE_FIRST_INIT, IMCS_TILE_MIN, IMCS_TILE_NOP, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int64, int64, min, IMCS_TILE_FIRST_INIT, IMCS_TILE_MIN, IMCS_TILE_NOP, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(float, float, min, IMCS_TILE_FIRST_INIT, IMCS_TILE_MIN, IMCS_TILE_NOP, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(double, double, min, IMCS_TILE_FIRST_INIT, IMCS_TILE_MIN, IMCS_TILE_NOP, IMCS_MIN_ACCUMULATE, IMCS_AGG_RESULT)
 
 #define IMCS_SUM_ACCUMULATE(agg, val) (agg + val)
-IMCS_AGG_DEF(int8, int64, sum, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int16, int64, sum, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int32, int64, sum, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(int64, int64, sum, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(float, double, sum, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
-IMCS_AGG_DEF(double, double, sum, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int8, int64, sum, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int16, int64, sum, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int32, int64, sum, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(int64, int64, sum, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(float, double, sum, IMCS_TILE_FLOAT_SUM_INIT, IMCS_TILE_FLOAT_SUM, IMCS_TILE_FLOAT_SUM_FINISH, IMCS_FLOAT_SUM_MERGE, IMCS_AGG_RESULT)
+IMCS_TILE_AGG_DEF(double, double, sum, IMCS_TILE_FLOAT_SUM_INIT, IMCS_TILE_FLOAT_SUM, IMCS_TILE_FLOAT_SUM_FINISH, IMCS_FLOAT_SUM_MERGE, IMCS_AGG_RESULT)
 
 #define IMCS_ALL_ACCUMULATE(agg, val) (agg & val)
 IMCS_AGG_DEF(int8, int8, all, IMCS_AGG_INIT, IMCS_ALL_ACCUMULATE, IMCS_AGG_RESULT)
@@ -1465,30 +1564,28 @@ IMCS_AGG_DEF(double, double, prd, IMCS_AGG_INIT, IMCS_PRD_ACCUMULATE, IMCS_AGG_R
 
 
 #define IMCS_AVG_RESULT(agg, count) (agg/count)
-IMCS_AGG_DEF(int8, double, avg, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
-IMCS_AGG_DEF(int16, double, avg, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
-IMCS_AGG_DEF(int32, double, avg, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
-IMCS_AGG_DEF(int64, double, avg, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
-IMCS_AGG_DEF(float, double, avg, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
-IMCS_AGG_DEF(double, double, avg, IMCS_AGG_INIT, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
-
-#define IMCS_VAR_INIT(val) (norm = (double)val*val, val)
-#define IMCS_VAR_ACCUMULATE(agg, val) (norm += (double)val*val, agg + val)
+IMCS_TILE_AGG_DEF(int8, double, avg, IMCS_TILE_NOP_INIT, IMCS_TILE_DSUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
+IMCS_TILE_AGG_DEF(int16, double, avg, IMCS_TILE_NOP_INIT, IMCS_TILE_DSUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
+IMCS_TILE_AGG_DEF(int32, double, avg, IMCS_TILE_NOP_INIT, IMCS_TILE_DSUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
+IMCS_TILE_AGG_DEF(int64, double, avg, IMCS_TILE_NOP_INIT, IMCS_TILE_DSUM, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_AVG_RESULT)
+IMCS_TILE_AGG_DEF(float, double, avg, IMCS_TILE_FLOAT_SUM_INIT, IMCS_TILE_FLOAT_SUM, IMCS_TILE_FLOAT_SUM_FINISH, IMCS_FLOAT_SUM_MERGE, IMCS_AVG_RESULT)
+IMCS_TILE_AGG_DEF(double, double, avg, IMCS_TILE_FLOAT_SUM_INIT, IMCS_TILE_FLOAT_SUM, IMCS_TILE_FLOAT_SUM_FINISH, IMCS_FLOAT_SUM_MERGE, IMCS_AVG_RESULT)
+
 #define IMCS_VAR_RESULT(agg, count) ((norm - agg*agg/count)/count)
-IMCS_AGG_DEF(int8, double, var, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_VAR_RESULT)
-IMCS_AGG_DEF(int16, double, var, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_VAR_RESULT)
-IMCS_AGG_DEF(int32, double, var, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_VAR_RESULT)
-IMCS_AGG_DEF(int64, double, var, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_VAR_RESULT)
-IMCS_AGG_DEF(float, double, var, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_VAR_RESULT)
-IMCS_AGG_DEF(double, double, var, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_VAR_RESULT)
+IMCS_TILE_AGG_DEF(int8, double, var, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_VAR_RESULT)
+IMCS_TILE_AGG_DEF(int16, double, var, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_VAR_RESULT)
+IMCS_TILE_AGG_DEF(int32, double, var, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_VAR_RESULT)
+IMCS_TILE_AGG_DEF(int64, double, var, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_VAR_RESULT)
+IMCS_TILE_AGG_DEF(float, double, var, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_VAR_RESULT)
+IMCS_TILE_AGG_DEF(double, double, var, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_VAR_RESULT)
 
 #define IMCS_DEV_RESULT(agg, count) sqrt((norm - agg*agg/count)/count)
-IMCS_AGG_DEF(int8, double, dev, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_DEV_RESULT)
-IMCS_AGG_DEF(int16, double, dev, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_DEV_RESULT)
-IMCS_AGG_DEF(int32, double, dev, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_DEV_RESULT)
-IMCS_AGG_DEF(int64, double, dev, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_DEV_RESULT)
-IMCS_AGG_DEF(float, double, dev, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_DEV_RESULT)
-IMCS_AGG_DEF(double, double, dev, IMCS_VAR_INIT, IMCS_VAR_ACCUMULATE, IMCS_DEV_RESULT)
+IMCS_TILE_AGG_DEF(int8, double, dev, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_DEV_RESULT)
+IMCS_TILE_AGG_DEF(int16, double, dev, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_DEV_RESULT)
+IMCS_TILE_AGG_DEF(int32, double, dev, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_DEV_RESULT)
+IMCS_TILE_AGG_DEF(int64, double, dev, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_DEV_RESULT)
+IMCS_TILE_AGG_DEF(float, double, dev, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_DEV_RESULT)
+IMCS_TILE_AGG_DEF(double, double, dev, IMCS_TILE_NOP_INIT, IMCS_TILE_SUM2, IMCS_TILE_NOP, IMCS_SUM_ACCUMULATE, IMCS_DEV_RESULT)
 
 typedef struct {
     double sx;
@@ -1629,7 +1726,7 @@ typedef struct imcs_agg_context_t_
 } imcs_agg_context_t;
 
 
-#define IMCS_WINDOW_AGG_DEF(TYPE, AGG_TYPE, MNEM, NEXT, INIT)           \
+#define IMCS_WINDOW_AGG_DEF(TYPE, AGG_TYPE, MNEM, NEXT, INIT, FLAGS)    \
 static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
 {                                                                       \
 size_t i, tile_size;                                                    \
@@ -1666,6 +1763,8 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, size_t interval) \
     ctx->interval = interval;                                           \
     result->next = imcs_##MNEM##_##TYPE##_next;                         \
     result->reset = imcs_##MNEM##_##TYPE##_reset;                       \
+    result->flags = FLAGS;                                              \
+    result->interval = interval;                                        \
     imcs_##MNEM##_##TYPE##_reset(result);                               \
     return result;                                                      \
 }
@@ -1673,92 +1772,171 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, size_t interval) \
 
 #define IMCS_WINDOW_SUM_NEXT(TYPE, AGG_TYPE, result, acc, hist, val) (acc -= hist, result = acc += hist = val)
 
-IMCS_WINDOW_AGG_DEF(int8, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, double, window_sum, IMCS_WINDOW_SUM_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_sum, IMCS_WINDOW_SUM_NEXT, 0)
+IMCS_WINDOW_AGG_DEF(int8, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int16, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int32, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int64, int64, window_sum, IMCS_WINDOW_SUM_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(float, double, window_sum, IMCS_WINDOW_SUM_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(double, double, window_sum, IMCS_WINDOW_SUM_NEXT, 0, FLAG_WINDOW)
 
 #define IMCS_WINDOW_AVG_NEXT(TYPE, AGG_TYPE, result, acc, hist, val) (acc -= hist, result = (acc += hist = val) / ctx->interval)
 
-IMCS_WINDOW_AGG_DEF(int8, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0)
-
-#define IMCS_WINDOW_MIN_NEXT(TYPE, AGG_TYPE, result, acc, hist, val) {  \
-    TYPE old = hist;                                                    \
-    hist = val;                                                         \
-    if (val < acc) {                                                    \
-        acc = val;                                                      \
-    } else if (old == acc) {                                            \
-        size_t j, n;                                                    \
-        TYPE min;                                                       \
-        min = ctx->history.arr_##TYPE[0];                               \
-        for (j = 1, n = ctx->interval; j < n; j++) {                    \
-            if (ctx->history.arr_##TYPE[j] < min) {                     \
-                min = ctx->history.arr_##TYPE[j];                       \
-            }                                                           \
+IMCS_WINDOW_AGG_DEF(int8, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int16, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int32, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int64, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(float, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(double, double, window_avg, IMCS_WINDOW_AVG_NEXT, 0, FLAG_WINDOW)
+
+/*
+ * Moving window minimum/maximum. Windows not larger than tile are calculated for the whole tile using van Herk/Gil-Werman algorithm:
+ * elements of the tile (prepended with last interval-1 elements of previous tile) are split into blocks of interval elements
+ * and extremum of window is combined from suffix extremum of one block and prefix extremum of the next block.
+ * Larger windows use monotonic deque of candidates (elements which are better than all subsequent elements of the window).
+ * In both cases elements preceding the start of timeseries are assumed to be zero, as for other window aggregates.
+ */
+#define IMCS_WINDOW_EXTREMUM_DEF(TYPE, MNEM, CMP)                       \
+static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
+{                                                                       \
+    size_t i, tile_size;                                                \
+    imcs_agg_context_t* ctx = (imcs_agg_context_t*)iterator->context;   \
+    size_t interval = ctx->interval;                                    \
+    TYPE* src;                                                          \
+    TYPE* dst = iterator->tile.arr_##TYPE;                              \
+    if (!iterator->opd[0]->next(iterator->opd[0])) {                    \
+        return false;                                                   \
+    }                                                                   \
+    tile_size = iterator->opd[0]->tile_size;                            \
+    src = iterator->opd[0]->tile.arr_##TYPE;                            \
+    if (interval <= (size_t)imcs_tile_size) {                           \
+        size_t n = interval - 1 + tile_size;                            \
+        TYPE* buf = ctx->history.arr_##TYPE;                            \
+        TYPE* prefix = buf + interval - 1 + imcs_tile_size;             \
+        TYPE* suffix = prefix + interval - 1 + imcs_tile_size;          \
+        memcpy(buf + interval - 1, src, tile_size*sizeof(TYPE));        \
+        for (i = 0; i < n; i++) {                                       \
+            prefix[i] = (i % interval == 0 || buf[i] CMP prefix[i-1]) ? buf[i] : prefix[i-1]; \
         }                                                               \
-        acc = min;                                                      \
-    }                                                                   \
-    result = acc;                                                       \
-}
-
-IMCS_WINDOW_AGG_DEF(int8, int8, window_min, IMCS_WINDOW_MIN_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, int16, window_min, IMCS_WINDOW_MIN_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, int32, window_min, IMCS_WINDOW_MIN_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, int64, window_min, IMCS_WINDOW_MIN_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, float, window_min, IMCS_WINDOW_MIN_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_min, IMCS_WINDOW_MIN_NEXT, 0)
-
-#define IMCS_WINDOW_MAX_NEXT(TYPE, AGG_TYPE, result, acc, hist, val) {  \
-    TYPE old = hist;                                                    \
-    hist = val;                                                         \
-    if (val > acc) {                                                    \
-        acc = val;                                                      \
-    } else if (old == acc) {                                            \
-        size_t j, n;                                                    \
-        TYPE max;                                                       \
-        max = ctx->history.arr_##TYPE[0];                               \
-        for (j = 1, n = ctx->interval; j < n; j++) {                    \
-            if (ctx->history.arr_##TYPE[j] > max) {                     \
-                max = ctx->history.arr_##TYPE[j];                       \
+        suffix[n-1] = buf[n-1];                                         \
+        for (i = n-1; i-- != 0;) {                                      \
+            suffix[i] = (i % interval == interval-1 || buf[i] CMP suffix[i+1]) ? buf[i] : suffix[i+1]; \
+        }                                                               \
+        for (i = 0; i < tile_size; i++) {                               \
+            dst[i] = suffix[i] CMP prefix[i + interval - 1] ? suffix[i] : prefix[i + interval - 1]; \
+        }                                                               \
+        memmove(buf, buf + tile_size, (interval - 1)*sizeof(TYPE));     \
+    } else {                                                            \
+        imcs_pos_t* positions = (imcs_pos_t*)ctx->history.arr_int64;    \
+        TYPE* values = (TYPE*)(positions + interval);                   \
+        size_t head = ctx->offset;                                      \
+        size_t count = ctx->count;                                      \
+        for (i = 0; i < tile_size; i++) {                               \
+            TYPE val = src[i];                                          \
+            imcs_pos_t pos = iterator->next_pos + i + interval; /* shifted to make positions of preceding zero elements positive */ \
+            size_t tail;                                                \
+            if (positions[head] + interval <= pos) { /* element is out of window */ \
+                head = (head + 1 == interval) ? 0 : head + 1;           \
+                count -= 1;                                             \
+            }                                                           \
+            while (count != 0) {                                        \
+                tail = head + count - 1;                                \
+                if (tail >= interval) {                                 \
+                    tail -= interval;                                   \
+                }                                                       \
+                if (values[tail] CMP val) {                             \
+                    break;                                              \
+                }                                                       \
+                count -= 1;                                             \
             }                                                           \
+            tail = head + count;                                        \
+            if (tail >= interval) {                                     \
+                tail -= interval;                                       \
+            }                                                           \
+            values[tail] = val;                                         \
+            positions[tail] = pos;                                      \
+            count += 1;                                                 \
+            dst[i] = values[head];                                      \
+        }                                                               \
+        ctx->offset = head;                                             \
+        ctx->count = count;                                             \
+    }                                                                   \
+    iterator->next_pos += tile_size;                                    \
+    iterator->tile_size = tile_size;                                    \
+    return true;                                                        \
+}                                                                       \
+static void imcs_##MNEM##_##TYPE##_reset(imcs_iterator_h iterator)      \
+{                                                                       \
+    imcs_agg_context_t* ctx = (imcs_agg_context_t*)iterator->context;   \
+    size_t interval = ctx->interval;                                    \
+    if (interval <= (size_t)imcs_tile_size) {                           \
+        size_t i;                                                       \
+        for (i = 0; i < interval - 1; i++) {                            \
+            ctx->history.arr_##TYPE[i] = 0;                             \
         }                                                               \
-        acc = max;                                                      \
+    } else {                                                            \
+        imcs_pos_t* positions = (imcs_pos_t*)ctx->history.arr_int64;    \
+        TYPE* values = (TYPE*)(positions + interval);                   \
+        positions[0] = interval - 1; /* zero element preceding first element of timeseries */ \
+        values[0] = 0;                                                  \
+        ctx->offset = 0;                                                \
+        ctx->count = 1;                                                 \
+    }                                                                   \
+    imcs_reset_iterator(iterator);                                      \
+}                                                                       \
+imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, size_t interval) \
+{                                                                       \
+    imcs_iterator_h result;                                             \
+    imcs_agg_context_t* ctx;                                            \
+    IMCS_CHECK_TYPE(input->elem_type, TID_##TYPE);                      \
+    if (interval == 0) {                                                \
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Window size should be positive"); \
     }                                                                   \
-    result = acc;                                                       \
+    result = imcs_new_iterator(sizeof(TYPE), sizeof(imcs_agg_context_t) + (interval <= (size_t)imcs_tile_size \
+                               ? (interval - 1 + imcs_tile_size)*3*sizeof(TYPE) : (sizeof(imcs_pos_t) + sizeof(TYPE))*interval)); \
+    ctx = (imcs_agg_context_t*)result->context;                         \
+    result->elem_type = TID_##TYPE;                                     \
+    result->opd[0] = imcs_operand(input);                               \
+    ctx->interval = interval;                                           \
+    result->next = imcs_##MNEM##_##TYPE##_next;                         \
+    result->reset = imcs_##MNEM##_##TYPE##_reset;                       \
+    result->flags = FLAG_WINDOW;                                        \
+    result->interval = interval;                                        \
+    imcs_##MNEM##_##TYPE##_reset(result);                               \
+    return result;                                                      \
 }
 
-IMCS_WINDOW_AGG_DEF(int8, int8, window_max, IMCS_WINDOW_MAX_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, int16, window_max, IMCS_WINDOW_MAX_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, int32, window_max, IMCS_WINDOW_MAX_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, int64, window_max, IMCS_WINDOW_MAX_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, float, window_max, IMCS_WINDOW_MAX_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_max, IMCS_WINDOW_MAX_NEXT, 0)
+IMCS_WINDOW_EXTREMUM_DEF(int8, window_min, <)
+IMCS_WINDOW_EXTREMUM_DEF(int16, window_min, <)
+IMCS_WINDOW_EXTREMUM_DEF(int32, window_min, <)
+IMCS_WINDOW_EXTREMUM_DEF(int64, window_min, <)
+IMCS_WINDOW_EXTREMUM_DEF(float, window_min, <)
+IMCS_WINDOW_EXTREMUM_DEF(double, window_min, <)
+
+IMCS_WINDOW_EXTREMUM_DEF(int8, window_max, >)
+IMCS_WINDOW_EXTREMUM_DEF(int16, window_max, >)
+IMCS_WINDOW_EXTREMUM_DEF(int32, window_max, >)
+IMCS_WINDOW_EXTREMUM_DEF(int64, window_max, >)
+IMCS_WINDOW_EXTREMUM_DEF(float, window_max, >)
+IMCS_WINDOW_EXTREMUM_DEF(double, window_max, >)
 
 
 #define IMCS_WINDOW_VAR_NEXT(TYPE, AGG_TYPE, result, acc, hist, val) (acc -= hist, ctx->norm -= (AGG_TYPE)hist*hist, hist = val, acc += val, ctx->norm += (AGG_TYPE)val*val, result = (ctx->norm - acc*acc/ctx->interval)/ctx->interval)
 
-IMCS_WINDOW_AGG_DEF(int8, double, window_var, IMCS_WINDOW_VAR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, double, window_var, IMCS_WINDOW_VAR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, double, window_var, IMCS_WINDOW_VAR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, double, window_var, IMCS_WINDOW_VAR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, double, window_var, IMCS_WINDOW_VAR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_var, IMCS_WINDOW_VAR_NEXT, 0)
+IMCS_WINDOW_AGG_DEF(int8, double, window_var, IMCS_WINDOW_VAR_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int16, double, window_var, IMCS_WINDOW_VAR_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int32, double, window_var, IMCS_WINDOW_VAR_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int64, double, window_var, IMCS_WINDOW_VAR_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(float, double, window_var, IMCS_WINDOW_VAR_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(double, double, window_var, IMCS_WINDOW_VAR_NEXT, 0, FLAG_WINDOW)
 
 #define IMCS_WINDOW_DEV_NEXT(TYPE, AGG_TYPE, result, acc, hist, val) (acc -= hist, ctx->norm -= (AGG_TYPE)hist*hist, hist = val, acc += val, ctx->norm += (AGG_TYPE)val*val, result = sqrt((ctx->norm - acc*acc/ctx->interval)/ctx->interval))
 
-IMCS_WINDOW_AGG_DEF(int8, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0)
+IMCS_WINDOW_AGG_DEF(int8, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int16, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int32, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(int64, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(float, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0, FLAG_WINDOW)
+IMCS_WINDOW_AGG_DEF(double, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0, FLAG_WINDOW)
 
 
 #define IMCS_WINDOW_EMA_NEXT(TYPE, AGG_TYPE, result, acc, hist, val)    \
@@ -1769,26 +1947,291 @@ IMCS_WINDOW_AGG_DEF(double, double, window_dev, IMCS_WINDOW_DEV_NEXT, 0)
         result = acc = val*p + acc * (1 - p);                           \
     }
 
-IMCS_WINDOW_AGG_DEF(int8, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0)
+IMCS_WINDOW_AGG_DEF(int8, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(int16, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(int32, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(int64, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(float, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(double, double, window_ema, IMCS_WINDOW_EMA_NEXT, 0, 0)
 
 #define IMCS_WINDOW_ATR_NEXT(TYPE, AGG_TYPE, result, acc, hist, val)   \
    size_t n = iterator->next_pos < ctx->interval ? iterator->next_pos+1 : ctx->interval; \
    result = acc = (acc * (n-1) + val) / n
 
-IMCS_WINDOW_AGG_DEF(int8, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int16, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int32, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(int64, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(float, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0)
-IMCS_WINDOW_AGG_DEF(double, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0)
+IMCS_WINDOW_AGG_DEF(int8, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(int16, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(int32, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(int64, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(float, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0, 0)
+IMCS_WINDOW_AGG_DEF(double, double, window_atr, IMCS_WINDOW_ATR_NEXT, 0, 0)
 
 
-#define IMCS_CUMULATIVE_AGG_DEF(TYPE, AGG_TYPE, MNEM, INIT, NEXT)       \
+/*
+ * Moving window aggregates over time: window of each element contains all preceding elements with timestamp
+ * greater than timestamp of this element minus window duration. Timestamps should be in ascending order.
+ * Elements of the window are kept in ring buffer: its head is advanced while timestamp at the head leaves the window,
+ * so each element is added to and removed from the window exactly once.
+ */
+typedef struct imcs_time_window_context_t_
+{
+    int64 duration;
+    int64 last_ts;
+    size_t head;      /* index of the oldest element of the window in ring buffer */
+    size_t count;     /* number of elements in ring buffer */
+    size_t allocated; /* capacity of ring buffer */
+    int64* timestamps;
+    char*  values;
+    imcs_key_t accumulator;
+    double norm;
+} imcs_time_window_context_t;
+
+static void imcs_time_window_reset(imcs_iterator_h iterator)
+{
+    imcs_time_window_context_t* ctx = (imcs_time_window_context_t*)iterator->context;
+    ctx->last_ts = IMCS_MIN_int64;
+    ctx->head = ctx->count = 0;
+    ctx->accumulator.val_int64 = 0;
+    ctx->accumulator.val_double = 0;
+    ctx->norm = 0;
+    imcs_reset_iterator(iterator);
+}
+
+/* Get next tile of values and timestamps, returns number of elements in the tile or 0 at the end of sequence */
+static size_t imcs_time_window_fetch(imcs_iterator_h iterator)
+{
+    size_t tile_size;
+    if (!iterator->opd[0]->next(iterator->opd[0]) || !iterator->opd[1]->next(iterator->opd[1])) {
+        return 0;
+    }
+    tile_size = iterator->opd[0]->tile_size;
+    if (tile_size > iterator->opd[1]->tile_size) {
+        tile_size = iterator->opd[1]->tile_size;
+    }
+    return tile_size;
+}
+
+/* Timestamps are expected to be in ascending order */
+static void imcs_time_window_check_order(imcs_time_window_context_t* ctx, int64 ts)
+{
+    if (ts < ctx->last_ts) {
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Timestamps should be in ascending order");
+    }
+    ctx->last_ts = ts;
+}
+
+/* Append element to the tail of ring buffer, returns index of the element slot */
+static size_t imcs_time_window_push(imcs_time_window_context_t* ctx, size_t elem_size)
+{
+    if (ctx->count == ctx->allocated) {
+        size_t new_allocated = ctx->allocated*2;
+        int64* new_timestamps = (int64*)imcs_alloc(new_allocated*sizeof(int64));
+        char* new_values = (char*)imcs_alloc(new_allocated*elem_size);
+        size_t n = ctx->allocated - ctx->head; /* elements till the end of buffer */
+        memcpy(new_timestamps, ctx->timestamps + ctx->head, n*sizeof(int64));
+        memcpy(new_timestamps + n, ctx->timestamps, ctx->head*sizeof(int64));
+        memcpy(new_values, ctx->values + ctx->head*elem_size, n*elem_size);
+        memcpy(new_values + n*elem_size, ctx->values, ctx->head*elem_size);
+        imcs_free(ctx->timestamps);
+        imcs_free(ctx->values);
+        ctx->timestamps = new_timestamps;
+        ctx->values = new_values;
+        ctx->allocated = new_allocated;
+        ctx->head = 0;
+    }
+    return (ctx->head + ctx->count++) % ctx->allocated;
+}
+
+static imcs_iterator_h imcs_time_window_create(imcs_iterator_h input, imcs_iterator_h ts, int64 duration, size_t agg_size)
+{
+    imcs_iterator_h result = imcs_new_iterator(agg_size, sizeof(imcs_time_window_context_t));
+    imcs_time_window_context_t* ctx = (imcs_time_window_context_t*)result->context;
+    IMCS_CHECK_TYPE(ts->elem_type, TID_int64);
+    if (duration <= 0) {
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Window duration should be positive");
+    }
+    result->opd[0] = imcs_operand(input);
+    result->opd[1] = imcs_operand(ts);
+    result->reset = imcs_time_window_reset;
+    ctx->duration = duration;
+    ctx->allocated = imcs_tile_size;
+    ctx->timestamps = (int64*)imcs_alloc(ctx->allocated*sizeof(int64));
+    ctx->values = (char*)imcs_alloc(ctx->allocated*input->elem_size);
+    imcs_time_window_reset(result);
+    return result;
+}
+
+#define IMCS_WINDOW_TIME_AGG_DEF(TYPE, AGG_TYPE, MNEM, ADD, REMOVE, RESULT) \
+static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
+{                                                                       \
+    size_t i, tile_size;                                                \
+    imcs_time_window_context_t* ctx = (imcs_time_window_context_t*)iterator->context; \
+    AGG_TYPE acc = ctx->accumulator.val_##AGG_TYPE;                     \
+    if ((tile_size = imcs_time_window_fetch(iterator)) == 0) {          \
+        return false;                                                   \
+    }                                                                   \
+    for (i = 0; i < tile_size; i++) {                                   \
+        int64 ts = iterator->opd[1]->tile.arr_int64[i];                 \
+        TYPE val = iterator->opd[0]->tile.arr_##TYPE[i];                \
+        size_t slot;                                                    \
+        imcs_time_window_check_order(ctx, ts);                          \
+        while (ctx->count != 0 && ctx->timestamps[ctx->head] <= ts - ctx->duration) { \
+            TYPE old = ((TYPE*)ctx->values)[ctx->head];                 \
+            REMOVE(acc, old);                                           \
+            ctx->head = (ctx->head + 1) % ctx->allocated;               \
+            ctx->count -= 1;                                            \
+        }                                                               \
+        slot = imcs_time_window_push(ctx, sizeof(TYPE));                \
+        ctx->timestamps[slot] = ts;                                     \
+        ((TYPE*)ctx->values)[slot] = val;                               \
+        ADD(acc, val);                                                  \
+        iterator->tile.arr_##AGG_TYPE[i] = RESULT(acc, ctx->count);     \
+    }                                                                   \
+    ctx->accumulator.val_##AGG_TYPE = acc;                              \
+    iterator->tile_size = tile_size;                                    \
+    iterator->next_pos += tile_size;                                    \
+    return true;                                                        \
+}                                                                       \
+imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration) \
+{                                                                       \
+    imcs_iterator_h result;                                             \
+    IMCS_CHECK_TYPE(input->elem_type, TID_##TYPE);                      \
+    result = imcs_time_window_create(input, ts, duration, sizeof(AGG_TYPE)); \
+    result->elem_type = TID_##AGG_TYPE;                                 \
+    result->next = imcs_##MNEM##_##TYPE##_next;                         \
+    return result;                                                      \
+}
+
+#define IMCS_WINDOW_TIME_SUM_ADD(acc, val) (acc += val)
+#define IMCS_WINDOW_TIME_SUM_REMOVE(acc, val) (acc -= val)
+#define IMCS_WINDOW_TIME_SUM_RESULT(acc, count) (acc)
+IMCS_WINDOW_TIME_AGG_DEF(int8, int64, window_sum_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_SUM_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int16, int64, window_sum_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_SUM_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int32, int64, window_sum_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_SUM_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int64, int64, window_sum_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_SUM_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(float, double, window_sum_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_SUM_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(double, double, window_sum_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_SUM_RESULT)
+
+#define IMCS_WINDOW_TIME_AVG_RESULT(acc, count) (acc / count)
+IMCS_WINDOW_TIME_AGG_DEF(int8, double, window_avg_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_AVG_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int16, double, window_avg_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_AVG_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int32, double, window_avg_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_AVG_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int64, double, window_avg_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_AVG_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(float, double, window_avg_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_AVG_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(double, double, window_avg_time, IMCS_WINDOW_TIME_SUM_ADD, IMCS_WINDOW_TIME_SUM_REMOVE, IMCS_WINDOW_TIME_AVG_RESULT)
+
+#define IMCS_WINDOW_TIME_VAR_ADD(acc, val) (acc += val, ctx->norm += (double)val*val)
+#define IMCS_WINDOW_TIME_VAR_REMOVE(acc, val) (acc -= val, ctx->norm -= (double)val*val)
+#define IMCS_WINDOW_TIME_VAR_RESULT(acc, count) ((ctx->norm - acc*acc/count)/count)
+IMCS_WINDOW_TIME_AGG_DEF(int8, double, window_var_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_VAR_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int16, double, window_var_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_VAR_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int32, double, window_var_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_VAR_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int64, double, window_var_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_VAR_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(float, double, window_var_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_VAR_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(double, double, window_var_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_VAR_RESULT)
+
+#define IMCS_WINDOW_TIME_DEV_RESULT(acc, count) sqrt((ctx->norm - acc*acc/count)/count)
+IMCS_WINDOW_TIME_AGG_DEF(int8, double, window_dev_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_DEV_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int16, double, window_dev_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_DEV_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int32, double, window_dev_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_DEV_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(int64, double, window_dev_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_DEV_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(float, double, window_dev_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_DEV_RESULT)
+IMCS_WINDOW_TIME_AGG_DEF(double, double, window_dev_time, IMCS_WINDOW_TIME_VAR_ADD, IMCS_WINDOW_TIME_VAR_REMOVE, IMCS_WINDOW_TIME_DEV_RESULT)
+
+/*
+ * Moving window minimum/maximum over time: ring buffer is used as monotonic deque of candidates,
+ * elements which are not better than the new element are removed from the tail of the deque.
+ */
+#define IMCS_WINDOW_TIME_EXTREMUM_DEF(TYPE, MNEM, CMP)                  \
+static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
+{                                                                       \
+    size_t i, tile_size;                                                \
+    imcs_time_window_context_t* ctx = (imcs_time_window_context_t*)iterator->context; \
+    if ((tile_size = imcs_time_window_fetch(iterator)) == 0) {          \
+        return false;                                                   \
+    }                                                                   \
+    for (i = 0; i < tile_size; i++) {                                   \
+        int64 ts = iterator->opd[1]->tile.arr_int64[i];                 \
+        TYPE val = iterator->opd[0]->tile.arr_##TYPE[i];                \
+        size_t slot;                                                    \
+        imcs_time_window_check_order(ctx, ts);                          \
+        while (ctx->count != 0 && ctx->timestamps[ctx->head] <= ts - ctx->duration) { \
+            ctx->head = (ctx->head + 1) % ctx->allocated;               \
+            ctx->count -= 1;                                            \
+        }                                                               \
+        while (ctx->count != 0 && !(((TYPE*)ctx->values)[(ctx->head + ctx->count - 1) % ctx->allocated] CMP val)) { \
+            ctx->count -= 1;                                            \
+        }                                                               \
+        slot = imcs_time_window_push(ctx, sizeof(TYPE));                \
+        ctx->timestamps[slot] = ts;                                     \
+        ((TYPE*)ctx->values)[slot] = val;                               \
+        iterator->tile.arr_##TYPE[i] = ((TYPE*)ctx->values)[ctx->head]; \
+    }                                                                   \
+    iterator->tile_size = tile_size;                                    \
+    iterator->next_pos += tile_size;                                    \
+    return true;                                                        \
+}                                                                       \
+imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration) \
+{                                                                       \
+    imcs_iterator_h result;                                             \
+    IMCS_CHECK_TYPE(input->elem_type, TID_##TYPE);                      \
+    result = imcs_time_window_create(input, ts, duration, sizeof(TYPE)); \
+    result->elem_type = TID_##TYPE;                                     \
+    result->next = imcs_##MNEM##_##TYPE##_next;                         \
+    return result;                                                      \
+}
+
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int8, window_min_time, <)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int16, window_min_time, <)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int32, window_min_time, <)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int64, window_min_time, <)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(float, window_min_time, <)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(double, window_min_time, <)
+
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int8, window_max_time, >)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int16, window_max_time, >)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int32, window_max_time, >)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(int64, window_max_time, >)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(float, window_max_time, >)
+IMCS_WINDOW_TIME_EXTREMUM_DEF(double, window_max_time, >)
+
+/*
+ * Number of time bucket of each timestamp: floor(ts/step). Grid aggregates over time are calculated as grouped aggregates
+ * with bucket numbers used as grouping key, so only non-empty buckets are present in the result.
+ */
+static bool imcs_time_bucket_next(imcs_iterator_h iterator)
+{
+    size_t i, tile_size;
+    int64 step = *(int64*)iterator->context;
+    if (!iterator->opd[0]->next(iterator->opd[0])) {
+        return false;
+    }
+    tile_size = iterator->opd[0]->tile_size;
+    for (i = 0; i < tile_size; i++) {
+        int64 ts = iterator->opd[0]->tile.arr_int64[i];
+        iterator->tile.arr_int64[i] = (ts >= 0 ? ts : ts - step + 1) / step;
+    }
+    iterator->tile_size = tile_size;
+    iterator->next_pos += tile_size;
+    return true;
+}
+
+imcs_iterator_h imcs_time_bucket(imcs_iterator_h ts, int64 step)
+{
+    imcs_iterator_h result = imcs_new_iterator(sizeof(int64), sizeof(int64));
+    IMCS_CHECK_TYPE(ts->elem_type, TID_int64);
+    if (step <= 0) {
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Grid step should be positive");
+    }
+    *(int64*)result->context = step;
+    result->elem_type = TID_int64;
+    result->opd[0] = imcs_operand(ts);
+    result->next = imcs_time_bucket_next;
+    result->flags = FLAG_CONTEXT_FREE;
+    return result;
+}
+
+
+#define IMCS_CUMULATIVE_AGG_DEF(TYPE, AGG_TYPE, MNEM, INIT, NEXT, MERGE) \
 static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
 {                                                                       \
     size_t i = 0, tile_size;                                            \
@@ -1810,6 +2253,13 @@ static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
     return true;                                                        \
 }                                                                       \
                                                                         \
+static void imcs_##MNEM##_##TYPE##_merge(imcs_iterator_h dst, imcs_iterator_h src) \
+{                                                                       \
+    imcs_agg_context_t* dst_ctx = (imcs_agg_context_t*)dst->context;   \
+    imcs_agg_context_t* src_ctx = (imcs_agg_context_t*)src->context;   \
+    MERGE(dst_ctx->accumulator.val_##AGG_TYPE, src_ctx->accumulator.val_##AGG_TYPE); \
+}                                                                       \
+                                                                        \
 imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input)             \
 {                                                                       \
     imcs_iterator_h result = imcs_new_iterator(sizeof(AGG_TYPE), sizeof(imcs_agg_context_t)); \
@@ -1817,74 +2267,82 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input)             \
     result->elem_type = TID_##AGG_TYPE;                                 \
     result->opd[0] = imcs_operand(input);                               \
     result->next = imcs_##MNEM##_##TYPE##_next;                         \
+    result->merge = imcs_##MNEM##_##TYPE##_merge;                       \
+    result->flags = FLAG_CUMULATIVE;                                    \
     return result;                                                      \
 }
 
 
 #define IMCS_CUMULATIVE_AGG_INIT(acc, val) (acc = val)
 #define IMCS_CUMULATIVE_SUM_NEXT(acc, val) (acc += val)
+#define IMCS_CUMULATIVE_SUM_MERGE(acc, other) (acc += other)
 
-IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(float, double, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(double, double, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT)
+IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT, IMCS_CUMULATIVE_SUM_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT, IMCS_CUMULATIVE_SUM_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT, IMCS_CUMULATIVE_SUM_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT, IMCS_CUMULATIVE_SUM_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(float, double, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT, IMCS_CUMULATIVE_SUM_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(double, double, cum_sum, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_SUM_NEXT, IMCS_CUMULATIVE_SUM_MERGE)
 
 #define IMCS_CUMULATIVE_AVG_NEXT(acc, val) (acc = (val + (iterator->next_pos-1)*acc)/iterator->next_pos)
+#define IMCS_CUMULATIVE_AVG_MERGE(acc, other) (acc = (acc*dst->next_pos + other*src->next_pos)/(dst->next_pos + src->next_pos))
 
-IMCS_CUMULATIVE_AGG_DEF(int8, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int16, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int32, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int64, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(float, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(double, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT)
+IMCS_CUMULATIVE_AGG_DEF(int8, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT, IMCS_CUMULATIVE_AVG_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int16, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT, IMCS_CUMULATIVE_AVG_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int32, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT, IMCS_CUMULATIVE_AVG_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int64, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT, IMCS_CUMULATIVE_AVG_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(float, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT, IMCS_CUMULATIVE_AVG_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(double, double, cum_avg, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_AVG_NEXT, IMCS_CUMULATIVE_AVG_MERGE)
 
 #define IMCS_CUMULATIVE_VAR_INIT(acc, val) (acc = val, ctx->norm = val*val, 0)
 #define IMCS_CUMULATIVE_VAR_NEXT(acc, val) (acc += val, ctx->norm += val*val, (ctx->norm - acc*acc/iterator->next_pos)/iterator->next_pos)
+#define IMCS_CUMULATIVE_VAR_MERGE(acc, other) (acc += other, dst_ctx->norm += src_ctx->norm)
 
-IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(float, double, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(double, double, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT)
+IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(float, double, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(double, double, cum_var, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_VAR_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
 
 #define IMCS_CUMULATIVE_DEV_NEXT(acc, val) (acc += val, ctx->norm += val*val, sqrt((ctx->norm - acc*acc/iterator->next_pos)/iterator->next_pos))
 
-IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(float, double, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(double, double, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT)
+IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(float, double, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(double, double, cum_dev, IMCS_CUMULATIVE_VAR_INIT, IMCS_CUMULATIVE_DEV_NEXT, IMCS_CUMULATIVE_VAR_MERGE)
 
 #define IMCS_CUMULATIVE_PRD_NEXT(acc, val) (acc *= val)
+#define IMCS_CUMULATIVE_PRD_MERGE(acc, other) (acc *= other)
 
-IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(float, double, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(double, double, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT)
+IMCS_CUMULATIVE_AGG_DEF(int8, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT, IMCS_CUMULATIVE_PRD_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int16, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT, IMCS_CUMULATIVE_PRD_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int32, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT, IMCS_CUMULATIVE_PRD_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT, IMCS_CUMULATIVE_PRD_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(float, double, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT, IMCS_CUMULATIVE_PRD_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(double, double, cum_prd, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_PRD_NEXT, IMCS_CUMULATIVE_PRD_MERGE)
 
 #define IMCS_CUMULATIVE_MAX_NEXT(acc, val) (acc = val > acc ? val : acc)
+#define IMCS_CUMULATIVE_MAX_MERGE(acc, other) (acc = other > acc ? other : acc)
 
-IMCS_CUMULATIVE_AGG_DEF(int8, int8, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int16, int16, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int32, int32, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(float, float, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(double, double, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT)
+IMCS_CUMULATIVE_AGG_DEF(int8, int8, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT, IMCS_CUMULATIVE_MAX_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int16, int16, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT, IMCS_CUMULATIVE_MAX_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int32, int32, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT, IMCS_CUMULATIVE_MAX_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT, IMCS_CUMULATIVE_MAX_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(float, float, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT, IMCS_CUMULATIVE_MAX_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(double, double, cum_max, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MAX_NEXT, IMCS_CUMULATIVE_MAX_MERGE)
 
 #define IMCS_CUMULATIVE_MIN_NEXT(acc, val) (acc = val < acc ? val : acc)
+#define IMCS_CUMULATIVE_MIN_MERGE(acc, other) (acc = other < acc ? other : acc)
 
-IMCS_CUMULATIVE_AGG_DEF(int8, int8, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int16, int16, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int32, int32, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(float, float, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT)
-IMCS_CUMULATIVE_AGG_DEF(double, double, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT)
+IMCS_CUMULATIVE_AGG_DEF(int8, int8, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT, IMCS_CUMULATIVE_MIN_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int16, int16, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT, IMCS_CUMULATIVE_MIN_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int32, int32, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT, IMCS_CUMULATIVE_MIN_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(int64, int64, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT, IMCS_CUMULATIVE_MIN_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(float, float, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT, IMCS_CUMULATIVE_MIN_MERGE)
+IMCS_CUMULATIVE_AGG_DEF(double, double, cum_min, IMCS_CUMULATIVE_AGG_INIT, IMCS_CUMULATIVE_MIN_NEXT, IMCS_CUMULATIVE_MIN_MERGE)
 
 
 static void imcs_reset_binary_agg_iterator(imcs_iterator_h iterator)
@@ -1978,6 +2436,7 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, imcs_iterator_h grou
     result->opd[1] = imcs_operand(group_by);                            \
     result->next = imcs_##MNEM##_##TYPE##_next;                         \
     result->reset = imcs_reset_binary_agg_iterator;                     \
+    result->flags = FLAG_GROUPED;                                       \
     ctx->offset = ctx->count = 0;                                       \
     return result;                                                      \
 }
@@ -2162,10 +2621,262 @@ imcs_iterator_h imcs_group_count(imcs_iterator_h group_by)
     result->opd[0] = imcs_operand(group_by);
     result->next = imcs_group_agg_count_next;
     result->reset = imcs_reset_unary_agg_iterator;
+    result->flags = FLAG_GROUPED;
     ctx->offset = ctx->count = 0;
     return result;
 }
 
+/*
+ * Multi-aggregate: all requested aggregates of each group are calculated by single pass through input and group-by sequences.
+ * Results of all aggregates are accumulated in buffers of shared state by the first invocation of next() of any
+ * of result iterators, then each result iterator just returns content of its buffer.
+ * Input and group-by sequences are opd[0] and opd[1] (NULL for grand aggregate) of all result iterators.
+ */
+typedef struct imcs_multi_agg_state_t_
+{
+    void (*evaluate)(imcs_iterator_h iterator);
+    int n_aggs;
+    imcs_multi_agg_t* aggs;
+    char** results;           /* buffer of each aggregate */
+    size_t* elem_sizes;       /* size of element of each result */
+    size_t n_groups;
+    size_t allocated;
+    bool evaluated;
+} imcs_multi_agg_state_t;
+
+typedef struct imcs_multi_agg_context_t_
+{
+    imcs_multi_agg_state_t* state;
+    int agg_no;
+} imcs_multi_agg_context_t;
+
+/* Reserve space for one more group in result buffers, returns index of the group */
+static size_t imcs_multi_agg_new_group(imcs_multi_agg_state_t* state)
+{
+    if (state->n_groups == state->allocated) {
+        int i;
+        state->allocated *= 2;
+        for (i = 0; i < state->n_aggs; i++) {
+            char* new_buf = (char*)imcs_alloc(state->allocated*state->elem_sizes[i]);
+            memcpy(new_buf, state->results[i], state->n_groups*state->elem_sizes[i]);
+            imcs_free(state->results[i]);
+            state->results[i] = new_buf;
+        }
+    }
+    return state->n_groups++;
+}
+
+/* Check if i-th element of group-by tile belongs to the same group as previous one (stored in "prev") */
+static bool imcs_multi_agg_same_group(imcs_iterator_h group_by, size_t i, char* prev)
+{
+    bool same;
+    size_t elem_size = group_by->elem_size;
+    switch (elem_size) {
+      case 1:
+        same = *(int8*)prev == group_by->tile.arr_int8[i];
+        *(int8*)prev = group_by->tile.arr_int8[i];
+        break;
+      case 2:
+        same = *(int16*)prev == group_by->tile.arr_int16[i];
+        *(int16*)prev = group_by->tile.arr_int16[i];
+        break;
+      case 4:
+        same = *(int32*)prev == group_by->tile.arr_int32[i];
+        *(int32*)prev = group_by->tile.arr_int32[i];
+        break;
+      case 8:
+        same = *(int64*)prev == group_by->tile.arr_int64[i];
+        *(int64*)prev = group_by->tile.arr_int64[i];
+        break;
+      default:
+        same = memcmp(prev, &group_by->tile.arr_char[i*elem_size], elem_size) == 0;
+        memcpy(prev, &group_by->tile.arr_char[i*elem_size], elem_size);
+    }
+    return same;
+}
+
+#define IMCS_MULTI_AGG_DEF(TYPE, SUM_TYPE)                              \
+static void imcs_multi_agg_##TYPE##_store(imcs_multi_agg_state_t* state, TYPE first, TYPE last, TYPE min, TYPE max, SUM_TYPE sum, double norm, imcs_count_t count) \
+{                                                                       \
+    size_t g = imcs_multi_agg_new_group(state);                         \
+    int i;                                                              \
+    for (i = 0; i < state->n_aggs; i++) {                               \
+        char* buf = state->results[i];                                  \
+        switch (state->aggs[i]) {                                       \
+          case IMCS_MULTI_AGG_FIRST:                                    \
+            ((TYPE*)buf)[g] = first;                                    \
+            break;                                                      \
+          case IMCS_MULTI_AGG_LAST:                                     \
+            ((TYPE*)buf)[g] = last;                                     \
+            break;                                                      \
+          case IMCS_MULTI_AGG_MIN:                                      \
+            ((TYPE*)buf)[g] = min;                                      \
+            break;                                                      \
+          case IMCS_MULTI_AGG_MAX:                                      \
+            ((TYPE*)buf)[g] = max;                                      \
+            break;                                                      \
+          case IMCS_MULTI_AGG_SUM:                                      \
+            ((SUM_TYPE*)buf)[g] = sum;                                  \
+            break;                                                      \
+          case IMCS_MULTI_AGG_AVG:                                      \
+            ((double*)buf)[g] = (double)sum/count;                      \
+            break;                                                      \
+          case IMCS_MULTI_AGG_VAR:                                      \
+            ((double*)buf)[g] = (norm - (double)sum*sum/count)/count;   \
+            break;                                                      \
+          case IMCS_MULTI_AGG_DEV:                                      \
+            ((double*)buf)[g] = sqrt((norm - (double)sum*sum/count)/count); \
+            break;                                                      \
+          case IMCS_MULTI_AGG_COUNT:                                    \
+            ((int64*)buf)[g] = count;                                   \
+            break;                                                      \
+        }                                                               \
+    }                                                                   \
+}                                                                       \
+static void imcs_multi_agg_##TYPE##_evaluate(imcs_iterator_h iterator)  \
+{                                                                       \
+    imcs_multi_agg_state_t* state = ((imcs_multi_agg_context_t*)iterator->context)->state; \
+    imcs_iterator_h input = iterator->opd[0];                           \
+    imcs_iterator_h group_by = iterator->opd[1];                        \
+    char* prev = group_by != NULL ? (char*)imcs_alloc(group_by->elem_size) : NULL; \
+    TYPE first = 0, last = 0, min = 0, max = 0;                         \
+    SUM_TYPE sum = 0;                                                   \
+    double norm = 0;                                                    \
+    imcs_count_t count = 0;                                             \
+    while (input->next(input)) {                                        \
+        size_t i, tile_size = input->tile_size;                         \
+        if (group_by != NULL) {                                         \
+            if (!group_by->next(group_by)) {                            \
+                break;                                                  \
+            }                                                           \
+            if (tile_size > group_by->tile_size) {                      \
+                tile_size = group_by->tile_size;                        \
+            }                                                           \
+        }                                                               \
+        for (i = 0; i < tile_size; i++) {                               \
+            TYPE val = input->tile.arr_##TYPE[i];                       \
+            if (group_by != NULL && !imcs_multi_agg_same_group(group_by, i, prev) && count != 0) { \
+                imcs_multi_agg_##TYPE##_store(state, first, last, min, max, sum, norm, count); \
+                count = 0;                                              \
+            }                                                           \
+            if (count == 0) {                                           \
+                first = min = max = val;                                \
+                sum = 0;                                                \
+                norm = 0;                                               \
+            } else {                                                    \
+                if (val < min) {                                        \
+                    min = val;                                          \
+                }                                                       \
+                if (val > max) {                                        \
+                    max = val;                                          \
+                }                                                       \
+            }                                                           \
+            last = val;                                                 \
+            sum += val;                                                 \
+            norm += (double)val*val;                                    \
+            count += 1;                                                 \
+        }                                                               \
+    }                                                                   \
+    if (count != 0) {                                                   \
+        imcs_multi_agg_##TYPE##_store(state, first, last, min, max, sum, norm, count); \
+    }                                                                   \
+    if (prev != NULL) {                                                 \
+        imcs_free(prev);                                                \
+    }                                                                   \
+}                                                                       \
+void imcs_group_agg_##TYPE(imcs_iterator_h* result, imcs_iterator_h input, imcs_iterator_h group_by, int n_aggs, imcs_multi_agg_t const* aggs) \
+{                                                                       \
+    IMCS_CHECK_TYPE(input->elem_type, TID_##TYPE);                      \
+    imcs_multi_agg(result, input, group_by, n_aggs, aggs, imcs_multi_agg_##TYPE##_evaluate, sizeof(SUM_TYPE), TID_##SUM_TYPE); \
+}                                                                       \
+void imcs_agg_##TYPE(imcs_iterator_h* result, imcs_iterator_h input, int n_aggs, imcs_multi_agg_t const* aggs) \
+{                                                                       \
+    imcs_group_agg_##TYPE(result, input, NULL, n_aggs, aggs);           \
+}
+
+static bool imcs_multi_agg_next(imcs_iterator_h iterator)
+{
+    imcs_multi_agg_context_t* ctx = (imcs_multi_agg_context_t*)iterator->context;
+    imcs_multi_agg_state_t* state = ctx->state;
+    size_t tile_size;
+    if (!state->evaluated) {
+        state->evaluate(iterator);
+        state->evaluated = true;
+    }
+    if (iterator->next_pos >= state->n_groups) {
+        return false;
+    }
+    tile_size = state->n_groups - iterator->next_pos;
+    if (tile_size > imcs_tile_size) {
+        tile_size = imcs_tile_size;
+    }
+    memcpy(iterator->tile.arr_char, state->results[ctx->agg_no] + iterator->next_pos*iterator->elem_size, tile_size*iterator->elem_size);
+    iterator->tile_size = tile_size;
+    iterator->next_pos += tile_size;
+    return true;
+}
+
+static void imcs_multi_agg(imcs_iterator_h* result, imcs_iterator_h input, imcs_iterator_h group_by, int n_aggs, imcs_multi_agg_t const* aggs,
+                           void (*evaluate)(imcs_iterator_h iterator), size_t sum_size, imcs_elem_typeid_t sum_type)
+{
+    int i;
+    imcs_multi_agg_state_t* state = (imcs_multi_agg_state_t*)imcs_alloc(sizeof(imcs_multi_agg_state_t));
+    imcs_iterator_h input_opd = imcs_operand(input);
+    imcs_iterator_h group_by_opd = group_by != NULL ? imcs_operand(group_by) : NULL;
+    state->evaluate = evaluate;
+    state->n_aggs = n_aggs;
+    state->aggs = (imcs_multi_agg_t*)imcs_alloc(n_aggs*sizeof(imcs_multi_agg_t));
+    state->results = (char**)imcs_alloc(n_aggs*sizeof(char*));
+    state->elem_sizes = (size_t*)imcs_alloc(n_aggs*sizeof(size_t));
+    state->n_groups = 0;
+    state->allocated = group_by != NULL ? imcs_tile_size : 1;
+    state->evaluated = false;
+    for (i = 0; i < n_aggs; i++) {
+        imcs_elem_typeid_t elem_type;
+        size_t elem_size;
+        imcs_multi_agg_context_t* ctx;
+        switch (aggs[i]) {
+          case IMCS_MULTI_AGG_FIRST:
+          case IMCS_MULTI_AGG_LAST:
+          case IMCS_MULTI_AGG_MIN:
+          case IMCS_MULTI_AGG_MAX:
+            elem_type = input->elem_type;
+            elem_size = input->elem_size;
+            break;
+          case IMCS_MULTI_AGG_SUM:
+            elem_type = sum_type;
+            elem_size = sum_size;
+            break;
+          case IMCS_MULTI_AGG_COUNT:
+            elem_type = TID_int64;
+            elem_size = sizeof(int64);
+            break;
+          default:
+            elem_type = TID_double;
+            elem_size = sizeof(double);
+        }
+        state->aggs[i] = aggs[i];
+        state->elem_sizes[i] = elem_size;
+        state->results[i] = (char*)imcs_alloc(state->allocated*elem_size);
+        result[i] = imcs_new_iterator(elem_size, sizeof(imcs_multi_agg_context_t));
+        result[i]->elem_type = elem_type;
+        result[i]->opd[0] = input_opd;
+        result[i]->opd[1] = group_by_opd;
+        result[i]->next = imcs_multi_agg_next;
+        ctx = (imcs_multi_agg_context_t*)result[i]->context;
+        ctx->state = state;
+        ctx->agg_no = i;
+    }
+}
+
+IMCS_MULTI_AGG_DEF(int8, int64)
+IMCS_MULTI_AGG_DEF(int16, int64)
+IMCS_MULTI_AGG_DEF(int32, int64)
+IMCS_MULTI_AGG_DEF(int64, int64)
+IMCS_MULTI_AGG_DEF(float, double)
+IMCS_MULTI_AGG_DEF(double, double)
+
+
 
 #define IMCS_GRID_AGG_DEF(TYPE, AGG_TYPE, MNEM, INIT, ACCUMULATE, RESULT) \
 static bool imcs_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)       \
@@ -2218,6 +2929,8 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, size_t interval) \
     result->opd[0] = imcs_operand(input);                               \
     result->next = imcs_##MNEM##_##TYPE##_next;                         \
     result->reset = imcs_reset_unary_agg_iterator;                      \
+    result->flags = FLAG_GRID;                                          \
+    result->interval = interval;                                        \
     ctx->interval = interval;                                           \
     ctx->offset = ctx->count = 0;                                       \
     return result;                                                      \
@@ -2668,24 +3381,58 @@ imcs_iterator_h imcs_if_char(imcs_iterator_h cond, imcs_iterator_h then_iter, im
     return result;
 }
 
+/*
+ * Filters compact the whole run of input tile at once. When selected elements may not fit in the rest of the output tile,
+ * the run is compacted into carry buffer (tile_size elements allocated at the end of iterator context)
+ * and elements which do not fit are returned at the beginning of the next tile.
+ */
+typedef struct imcs_filter_carry_t_ {
+    size_t offs;
+    size_t size;
+    union {
+        char arr_char[1];
+        int8 arr_int8[1];
+        int16 arr_int16[1];
+        int32 arr_int32[1];
+        int64 arr_int64[1];
+        float arr_float[1];
+        double arr_double[1];
+    } buf;
+} imcs_filter_carry_t;
+
+static size_t imcs_filter_take_carry(imcs_iterator_h iterator, imcs_filter_carry_t* carry, size_t tile_size)
+{
+    size_t elem_size = iterator->elem_size;
+    size_t n = carry->size - carry->offs;
+    if (n > imcs_tile_size - tile_size) {
+        n = imcs_tile_size - tile_size;
+    }
+    memcpy(iterator->tile.arr_char + tile_size*elem_size, carry->buf.arr_char + carry->offs*elem_size, n*elem_size);
+    carry->offs += n;
+    return tile_size + n;
+}
+
 typedef struct imcs_filter_context_t_ {
     size_t left_offs;
     size_t right_offs;
+    imcs_filter_carry_t carry;
 } imcs_filter_context_t;
 
 static void imcs_filter_reset(imcs_iterator_h iterator)
 {
     imcs_filter_context_t* ctx = (imcs_filter_context_t*)iterator->context;
     ctx->left_offs = ctx->right_offs = 0;
+    ctx->carry.offs = ctx->carry.size = 0;
     imcs_reset_iterator(iterator);
 }
 #define IMCS_FILTER_DEF(TYPE)                                           \
 static bool imcs_filter_##TYPE##_next(imcs_iterator_h iterator)         \
 {                                                                       \
-    size_t i, n, tile_size = 0;                                         \
+    size_t n;                                                           \
     imcs_filter_context_t* ctx = (imcs_filter_context_t*)iterator->context; \
     size_t this_tile_size = imcs_tile_size;                             \
-    do {                                                                \
+    size_t tile_size = imcs_filter_take_carry(iterator, &ctx->carry, 0); \
+    while (tile_size < this_tile_size) {                                \
         if (ctx->left_offs >= iterator->opd[0]->tile_size) {            \
             if (!iterator->opd[0]->next(iterator->opd[0])) {            \
                 if (tile_size != 0) {                                   \
@@ -2712,18 +3459,20 @@ static bool imcs_filter_##TYPE##_next(imcs_iterator_h iterator)         \
         if (n > iterator->opd[1]->tile_size - ctx->right_offs) {        \
             n = iterator->opd[1]->tile_size - ctx->right_offs;          \
         }                                                               \
-        for (i = 0; i < n; i++) {                                       \
-            if (iterator->opd[0]->tile.arr_int8[ctx->left_offs + i]) { \
-                iterator->tile.arr_##TYPE[tile_size] = iterator->opd[1]->tile.arr_##TYPE[ctx->right_offs + i];\
-                if (++tile_size == this_tile_size) {                    \
-                    i += 1;                                             \
-                    break;                                              \
-                }                                                       \
-            }                                                           \
+        if (n <= this_tile_size - tile_size) {                          \
+            tile_size += imcs_simd_select_##TYPE(iterator->tile.arr_##TYPE + tile_size, \
+                                                 iterator->opd[1]->tile.arr_##TYPE + ctx->right_offs, \
+                                                 iterator->opd[0]->tile.arr_int8 + ctx->left_offs, n); \
+        } else {                                                        \
+            ctx->carry.size = imcs_simd_select_##TYPE(ctx->carry.buf.arr_##TYPE, \
+                                                      iterator->opd[1]->tile.arr_##TYPE + ctx->right_offs, \
+                                                      iterator->opd[0]->tile.arr_int8 + ctx->left_offs, n); \
+            ctx->carry.offs = 0;                                        \
+            tile_size = imcs_filter_take_carry(iterator, &ctx->carry, tile_size); \
         }                                                               \
-        ctx->left_offs += i;                                            \
-        ctx->right_offs += i;                                           \
-    } while (tile_size < this_tile_size);                               \
+        ctx->left_offs += n;                                            \
+        ctx->right_offs += n;                                           \
+    }                                                                   \
     iterator->tile_size = tile_size;                                    \
     iterator->next_pos += tile_size;                                    \
     return true;                                                        \
@@ -2731,7 +3480,7 @@ static bool imcs_filter_##TYPE##_next(imcs_iterator_h iterator)         \
                                                                         \
 imcs_iterator_h imcs_filter_##TYPE(imcs_iterator_h cond, imcs_iterator_h input) \
 {                                                                       \
-    imcs_iterator_h result = imcs_new_iterator(sizeof(TYPE), sizeof(imcs_filter_context_t)); \
+    imcs_iterator_h result = imcs_new_iterator(sizeof(TYPE), sizeof(imcs_filter_context_t) + imcs_tile_size*sizeof(TYPE)); \
     imcs_filter_context_t* ctx = (imcs_filter_context_t*)result->context; \
     IMCS_CHECK_TYPE(cond->elem_type, TID_int8);                         \
     IMCS_CHECK_TYPE(input->elem_type, TID_##TYPE);                      \
@@ -2742,6 +3491,7 @@ imcs_iterator_h imcs_filter_##TYPE(imcs_iterator_h cond, imcs_iterator_h input)
     result->reset = imcs_filter_reset;                                  \
     result->flags = FLAG_CONTEXT_FREE|(input->flags & FLAG_TRANSLATED); \
     ctx->left_offs = ctx->right_offs = 0;                               \
+    ctx->carry.offs = ctx->carry.size = 0;                              \
     return result;                                                      \
 }
 
@@ -2815,6 +3565,7 @@ imcs_iterator_h imcs_filter_char(imcs_iterator_h cond, imcs_iterator_h input)
     result->reset = imcs_filter_reset;
     result->flags = FLAG_CONTEXT_FREE;
     ctx->left_offs = ctx->right_offs = 0;
+    ctx->carry.offs = ctx->carry.size = 0;
     return result;
 }
 
@@ -2822,6 +3573,7 @@ imcs_iterator_h imcs_filter_char(imcs_iterator_h cond, imcs_iterator_h input)
 typedef struct imcs_filter_pos_context_t_ {
     size_t     offs;
     imcs_pos_t origin;
+    imcs_filter_carry_t carry;
 } imcs_filter_pos_context_t;
 
 
@@ -2829,15 +3581,17 @@ static void imcs_filter_pos_reset(imcs_iterator_h iterator)
 {
     imcs_filter_pos_context_t* ctx = (imcs_filter_pos_context_t*)iterator->context;
     ctx->offs = 0;
+    ctx->carry.offs = ctx->carry.size = 0;
     imcs_reset_iterator(iterator);
 }
 static bool imcs_filter_pos_next(imcs_iterator_h iterator)
 {
-    size_t i, n, tile_size = 0;
+    size_t n;
     size_t this_tile_size = imcs_tile_size;
     imcs_filter_pos_context_t* ctx = (imcs_filter_pos_context_t*)iterator->context;
+    size_t tile_size = imcs_filter_take_carry(iterator, &ctx->carry, 0);
     int64 pos;
-    do {
+    while (tile_size < this_tile_size) {
         if (ctx->offs >= iterator->opd[0]->tile_size) {
             if (!iterator->opd[0]->next(iterator->opd[0])) {
                 if (tile_size != 0) {
@@ -2851,35 +3605,168 @@ static bool imcs_filter_pos_next(imcs_iterator_h iterator)
         }
         n = iterator->opd[0]->tile_size - ctx->offs;
         pos = iterator->opd[0]->next_pos - n - ctx->origin;
-        for (i = 0; i < n; i++) {
-            if (iterator->opd[0]->tile.arr_int8[ctx->offs + i]) {
-                iterator->tile.arr_int64[tile_size] = pos + i;
-                if (++tile_size == this_tile_size) {
-                    i += 1;
-                    break;
-                }
-            }
+        if (n <= this_tile_size - tile_size) {
+            tile_size += imcs_simd_select_pos(iterator->tile.arr_int64 + tile_size, pos, iterator->opd[0]->tile.arr_int8 + ctx->offs, n);
+        } else {
+            ctx->carry.size = imcs_simd_select_pos(ctx->carry.buf.arr_int64, pos, iterator->opd[0]->tile.arr_int8 + ctx->offs, n);
+            ctx->carry.offs = 0;
+            tile_size = imcs_filter_take_carry(iterator, &ctx->carry, tile_size);
         }
-        ctx->offs += i;
-    } while (tile_size < this_tile_size);
+        ctx->offs += n;
+    }
     iterator->tile_size = tile_size;
     iterator->next_pos += tile_size;
     return true;
 }
 
-imcs_iterator_h imcs_filter_pos(imcs_iterator_h cond)
+imcs_iterator_h imcs_filter_pos(imcs_iterator_h cond)
+{
+    imcs_iterator_h result = imcs_new_iterator(sizeof(imcs_pos_t), sizeof(imcs_filter_pos_context_t) + imcs_tile_size*sizeof(imcs_pos_t));
+    imcs_filter_pos_context_t* ctx = (imcs_filter_pos_context_t*)result->context;
+    IMCS_CHECK_TYPE(cond->elem_type, TID_int8);
+    result->elem_type = TID_int64;
+    result->opd[0] = imcs_operand(cond);
+    result->next = imcs_filter_pos_next;
+    result->reset = imcs_filter_pos_reset;
+    result->flags = FLAG_CONTEXT_FREE;
+    ctx->offs = 0;
+    ctx->carry.offs = ctx->carry.size = 0;
+    ctx->origin = cond->first_pos;
+    return result;
+}
+
+/*
+ * Fused scan of stored timeseries and comparison with constant: positions of matched elements are produced
+ * directly from tiles of the timeseries, without materializing tiles of constant and of comparison results.
+ */
+typedef struct imcs_scan_filter_pos_context_t_ {
+    size_t     offs;
+    imcs_pos_t origin;
+    imcs_key_t val;
+    imcs_filter_carry_t carry;
+} imcs_scan_filter_pos_context_t;
+
+static void imcs_scan_filter_pos_reset(imcs_iterator_h iterator)
+{
+    imcs_scan_filter_pos_context_t* ctx = (imcs_scan_filter_pos_context_t*)iterator->context;
+    ctx->offs = 0;
+    ctx->carry.offs = ctx->carry.size = 0;
+    imcs_reset_iterator(iterator);
+}
+
+#define IMCS_SCAN_FILTER_POS_DEF(TYPE, MNEM)                            \
+static bool imcs_scan_##MNEM##_##TYPE##_next(imcs_iterator_h iterator)  \
+{                                                                       \
+    size_t n;                                                           \
+    size_t this_tile_size = imcs_tile_size;                             \
+    imcs_scan_filter_pos_context_t* ctx = (imcs_scan_filter_pos_context_t*)iterator->context; \
+    size_t tile_size = imcs_filter_take_carry(iterator, &ctx->carry, 0); \
+    int64 pos;                                                          \
+    while (tile_size < this_tile_size) {                                \
+        if (ctx->offs >= iterator->opd[0]->tile_size) {                 \
+            if (!iterator->opd[0]->next(iterator->opd[0])) {            \
+                if (tile_size != 0) {                                   \
+                    iterator->tile_size = tile_size;                    \
+                    iterator->next_pos += tile_size;                    \
+                    return true;                                        \
+                }                                                       \
+                return false;                                           \
+            }                                                           \
+            ctx->offs = 0;                                              \
+        }                                                               \
+        n = iterator->opd[0]->tile_size - ctx->offs;                    \
+        pos = iterator->opd[0]->next_pos - n - ctx->origin;             \
+        if (n <= this_tile_size - tile_size) {                          \
+            tile_size += imcs_simd_select_pos_##MNEM##_##TYPE(iterator->tile.arr_int64 + tile_size, pos, \
+                                                              iterator->opd[0]->tile.arr_##TYPE + ctx->offs, \
+                                                              ctx->val.val_##TYPE, n); \
+        } else {                                                        \
+            ctx->carry.size = imcs_simd_select_pos_##MNEM##_##TYPE(ctx->carry.buf.arr_int64, pos, \
+                                                                   iterator->opd[0]->tile.arr_##TYPE + ctx->offs, \
+                                                                   ctx->val.val_##TYPE, n); \
+            ctx->carry.offs = 0;                                        \
+            tile_size = imcs_filter_take_carry(iterator, &ctx->carry, tile_size); \
+        }                                                               \
+        ctx->offs += n;                                                 \
+    }                                                                   \
+    iterator->tile_size = tile_size;                                    \
+    iterator->next_pos += tile_size;                                    \
+    return true;                                                        \
+}
+
+#define IMCS_SCAN_FILTER_POS_TYPE_DEF(TYPE)     \
+    IMCS_SCAN_FILTER_POS_DEF(TYPE, eq)          \
+    IMCS_SCAN_FILTER_POS_DEF(TYPE, ne)          \
+    IMCS_SCAN_FILTER_POS_DEF(TYPE, ge)          \
+    IMCS_SCAN_FILTER_POS_DEF(TYPE, le)          \
+    IMCS_SCAN_FILTER_POS_DEF(TYPE, gt)          \
+    IMCS_SCAN_FILTER_POS_DEF(TYPE, lt)
+
+IMCS_SCAN_FILTER_POS_TYPE_DEF(int8)
+IMCS_SCAN_FILTER_POS_TYPE_DEF(int16)
+IMCS_SCAN_FILTER_POS_TYPE_DEF(int32)
+IMCS_SCAN_FILTER_POS_TYPE_DEF(int64)
+IMCS_SCAN_FILTER_POS_TYPE_DEF(float)
+IMCS_SCAN_FILTER_POS_TYPE_DEF(double)
+
+/* Comparison operator which can be fused with scan: "swapped" scan is used when constant is left operand */
+typedef struct {
+    imcs_iterator_next_t compare;
+    imcs_iterator_next_t scan;
+    imcs_iterator_next_t swapped_scan;
+} imcs_scan_filter_pos_method_t;
+
+#define IMCS_SCAN_FILTER_POS_METHODS(TYPE)                                                      \
+    {imcs_eq_##TYPE##_next, imcs_scan_eq_##TYPE##_next, imcs_scan_eq_##TYPE##_next},            \
+    {imcs_ne_##TYPE##_next, imcs_scan_ne_##TYPE##_next, imcs_scan_ne_##TYPE##_next},            \
+    {imcs_ge_##TYPE##_next, imcs_scan_ge_##TYPE##_next, imcs_scan_le_##TYPE##_next},            \
+    {imcs_le_##TYPE##_next, imcs_scan_le_##TYPE##_next, imcs_scan_ge_##TYPE##_next},            \
+    {imcs_gt_##TYPE##_next, imcs_scan_gt_##TYPE##_next, imcs_scan_lt_##TYPE##_next},            \
+    {imcs_lt_##TYPE##_next, imcs_scan_lt_##TYPE##_next, imcs_scan_gt_##TYPE##_next}
+
+static const imcs_scan_filter_pos_method_t imcs_scan_filter_pos_methods[] =
 {
-    imcs_iterator_h result = imcs_new_iterator(sizeof(imcs_pos_t), sizeof(imcs_filter_pos_context_t));
-    imcs_filter_pos_context_t* ctx = (imcs_filter_pos_context_t*)result->context;
-    IMCS_CHECK_TYPE(cond->elem_type, TID_int8);
-    result->elem_type = TID_int64;
-    result->opd[0] = imcs_operand(cond);
-    result->next = imcs_filter_pos_next;
-    result->reset = imcs_filter_pos_reset;
-    result->flags = FLAG_CONTEXT_FREE;
-    ctx->offs = 0;
-    ctx->origin = cond->first_pos;
-    return result;
+    IMCS_SCAN_FILTER_POS_METHODS(int8),
+    IMCS_SCAN_FILTER_POS_METHODS(int16),
+    IMCS_SCAN_FILTER_POS_METHODS(int32),
+    IMCS_SCAN_FILTER_POS_METHODS(int64),
+    IMCS_SCAN_FILTER_POS_METHODS(float),
+    IMCS_SCAN_FILTER_POS_METHODS(double)
+};
+
+imcs_iterator_h imcs_scan_filter_pos(imcs_iterator_h cond)
+{
+    size_t i;
+    for (i = 0; i < lengthof(imcs_scan_filter_pos_methods); i++) {
+        if (cond->next == imcs_scan_filter_pos_methods[i].compare) {
+            imcs_iterator_h column = cond->opd[0];
+            imcs_iterator_h constant = cond->opd[1];
+            imcs_iterator_next_t scan = imcs_scan_filter_pos_methods[i].scan;
+            imcs_iterator_h result;
+            imcs_scan_filter_pos_context_t* ctx;
+            if (column->flags & FLAG_CONSTANT) {
+                column = cond->opd[1];
+                constant = cond->opd[0];
+                scan = imcs_scan_filter_pos_methods[i].swapped_scan;
+            }
+            if (column->cs_hdr == NULL || column->next_pos != column->first_pos || !(constant->flags & FLAG_CONSTANT)) {
+                return NULL;
+            }
+            result = imcs_new_iterator(sizeof(imcs_pos_t), sizeof(imcs_scan_filter_pos_context_t) + imcs_tile_size*sizeof(imcs_pos_t));
+            ctx = (imcs_scan_filter_pos_context_t*)result->context;
+            result->elem_type = TID_int64;
+            result->opd[0] = imcs_operand(column);
+            result->next = scan;
+            result->reset = imcs_scan_filter_pos_reset;
+            result->flags = FLAG_CONTEXT_FREE;
+            memcpy(&ctx->val, constant->tile.arr_char, column->elem_size);
+            ctx->offs = 0;
+            ctx->carry.offs = ctx->carry.size = 0;
+            ctx->origin = column->first_pos;
+            return result;
+        }
+    }
+    return NULL;
 }
 
 
@@ -3214,6 +4101,198 @@ typedef struct {
     imcs_order_t order;
 } imcs_sort_context_t;
 
+/* State of parallel sort: array is split into chunks which are sorted concurrently and then merged by pairs */
+typedef struct {
+    void const* data;
+    imcs_pos_t* src;
+    imcs_pos_t* dst;
+    size_t n_elems;
+    int n_chunks;  /* power of two */
+    int width;     /* number of chunks in each of runs merged at this round */
+    imcs_order_t order;
+} imcs_parallel_sort_t;
+
+#define IMCS_SORT_CHUNK_BOUND(ps, chunk) ((size_t)((uint64)(ps)->n_elems*(chunk)/(ps)->n_chunks))
+
+static int imcs_compare_pos(void const* p, void const* q)
+{
+    imcs_pos_t pos1 = *(imcs_pos_t const*)p;
+    imcs_pos_t pos2 = *(imcs_pos_t const*)q;
+    return pos1 < pos2 ? -1 : pos1 == pos2 ? 0 : 1;
+}
+
+static void imcs_reverse_pos(imcs_pos_t* permutation, size_t n_elems)
+{
+    size_t i, j;
+    for (i = 0, j = n_elems; i + 1 < j; i++, j--) {
+        imcs_pos_t tmp = permutation[i];
+        permutation[i] = permutation[j-1];
+        permutation[j-1] = tmp;
+    }
+}
+
+/*
+ * NaN is not comparable with other values, so sort places it after all other values
+ * both in ascending and in descending order.
+ */
+#define IMCS_INT_IS_NAN_DEF(TYPE)                                       \
+static inline bool imcs_is_nan_##TYPE(TYPE val)                         \
+{                                                                       \
+    return false;                                                       \
+}
+IMCS_INT_IS_NAN_DEF(int8)
+IMCS_INT_IS_NAN_DEF(int16)
+IMCS_INT_IS_NAN_DEF(int32)
+IMCS_INT_IS_NAN_DEF(int64)
+
+static inline bool imcs_is_nan_float(float val)
+{
+    return isnan(val);
+}
+
+static inline bool imcs_is_nan_double(double val)
+{
+    return isnan(val);
+}
+
+/* Check if value x precedes value y in the specified order */
+#define IMCS_SORT_PRECEDES(TYPE, x, y, order) \
+    (imcs_is_nan_##TYPE(y) ? !imcs_is_nan_##TYPE(x) : (order) == IMCS_ASC_ORDER ? (x) < (y) : (x) > (y))
+
+/* Arrays with smaller number of elements are sorted using comparison sort */
+#define IMCS_RADIX_SORT_THRESHOLD 256
+
+/*
+ * Transform value into unsigned integer preserving order, used as key of radix sort.
+ * Sign bit of integers is inverted, floating point values are transformed in the same way
+ * but all bits of negative values are inverted. Negative zero gets the key of positive zero
+ * and all NaNs get the maximal key, so that they are ordered in the same way as by comparison sort.
+ */
+#define IMCS_RADIX_INT_KEY_DEF(TYPE)                                    \
+static inline uint64 imcs_radix_key_##TYPE(TYPE val)                    \
+{                                                                       \
+    uint64 key = (uint64)(int64)val + ((uint64)1 << (sizeof(TYPE)*8-1)); \
+    return key & (~(uint64)0 >> (64 - sizeof(TYPE)*8));                 \
+}
+IMCS_RADIX_INT_KEY_DEF(int8)
+IMCS_RADIX_INT_KEY_DEF(int16)
+IMCS_RADIX_INT_KEY_DEF(int32)
+IMCS_RADIX_INT_KEY_DEF(int64)
+
+static inline uint64 imcs_radix_key_float(float val)
+{
+    uint32 bits;
+    if (isnan(val)) {
+        return 0xFFFFFFFFU;
+    }
+    if (val == 0) {
+        val = 0;
+    }
+    memcpy(&bits, &val, sizeof bits);
+    return (bits & 0x80000000U) ? ~bits : bits | 0x80000000U;
+}
+
+static inline uint64 imcs_radix_key_double(double val)
+{
+    uint64 bits;
+    if (isnan(val)) {
+        return ~(uint64)0;
+    }
+    if (val == 0) {
+        val = 0;
+    }
+    memcpy(&bits, &val, sizeof bits);
+    return (bits & ((uint64)1 << 63)) ? ~bits : bits | ((uint64)1 << 63);
+}
+
+/*
+ * LSD radix sort of (key, position) pairs. Histograms of all bytes are calculated in one pass and
+ * passes for bytes which are the same for all keys are skipped. Sort is stable: positions of equal keys are in ascending order.
+ */
+static void imcs_radix_sort(uint64* keys, imcs_pos_t* permutation, size_t n_elems, int key_size)
+{
+    size_t count[8][256];
+    uint64* src_keys = keys;
+    imcs_pos_t* src_pos = permutation;
+    uint64* dst_keys = (uint64*)imcs_alloc(n_elems*sizeof(uint64));
+    imcs_pos_t* dst_pos = (imcs_pos_t*)imcs_alloc(n_elems*sizeof(imcs_pos_t));
+    uint64* tmp_keys = dst_keys;
+    imcs_pos_t* tmp_pos = dst_pos;
+    size_t i;
+    int byte;
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n_elems; i++) {
+        uint64 key = keys[i];
+        for (byte = 0; byte < key_size; byte++) {
+            count[byte][(key >> (byte*8)) & 0xFF] += 1;
+        }
+    }
+    for (byte = 0; byte < key_size; byte++) {
+        int shift = byte*8;
+        size_t offs = 0;
+        if (count[byte][(src_keys[0] >> shift) & 0xFF] == n_elems) { /* all keys have the same value of this byte */
+            continue;
+        }
+        for (i = 0; i < 256; i++) {
+            size_t n = count[byte][i];
+            count[byte][i] = offs;
+            offs += n;
+        }
+        for (i = 0; i < n_elems; i++) {
+            size_t dst = count[byte][(src_keys[i] >> shift) & 0xFF]++;
+            dst_keys[dst] = src_keys[i];
+            dst_pos[dst] = src_pos[i];
+        }
+        tmp_keys = src_keys; src_keys = dst_keys; dst_keys = tmp_keys;
+        tmp_pos = src_pos; src_pos = dst_pos; dst_pos = tmp_pos;
+    }
+    if (src_pos != permutation) {
+        memcpy(permutation, src_pos, n_elems*sizeof(imcs_pos_t));
+        imcs_free(src_keys);
+        imcs_free(src_pos);
+    } else {
+        imcs_free(dst_keys);
+        imcs_free(dst_pos);
+    }
+}
+
+/* Ranges with smaller number of elements are sorted by insertion sort during selection */
+#define IMCS_SELECT_INSERTION_THRESHOLD 16
+
+/*
+ * Evaluate input sequence once, storing its elements in buffer which is extended when needed.
+ * It is used instead of imcs_count+imcs_to_array pair which evaluates input twice.
+ * Returns number of elements, buffer should be deallocated by imcs_free.
+ */
+static size_t imcs_fetch_all(imcs_iterator_h input, void** buf)
+{
+    size_t elem_size = input->elem_size;
+    size_t allocated = imcs_tile_size;
+    size_t used = 0;
+    char* arr;
+    input = imcs_parallel_materialize(input);
+    input->reset(input);
+    arr = (char*)imcs_alloc(allocated*elem_size);
+    while (input->next(input)) {
+        size_t available = input->tile_size;
+        if (used + available > allocated) {
+            char* new_arr;
+            do {
+                allocated *= 2;
+            } while (used + available > allocated);
+            new_arr = (char*)imcs_alloc(allocated*elem_size);
+            memcpy(new_arr, arr, used*elem_size);
+            imcs_free(arr);
+            arr = new_arr;
+        }
+        memcpy(arr + used*elem_size, input->tile.arr_char, available*elem_size);
+        used += available;
+    }
+    *buf = arr;
+    return used;
+}
+
 #define IMCS_SORT_DEF(TYPE)                                             \
     static void insertion_sort_##TYPE(TYPE const* data, imcs_pos_t* permutation, size_t n_elems) \
     {                                                                   \
@@ -3412,9 +4491,24 @@ typedef struct {
             }                                                           \
         }                                                               \
     }                                                                   \
-    static void imcs_sort_array_##TYPE(TYPE const* data, imcs_pos_t* permutation, size_t n_elems, imcs_order_t order) \
+    /* Keys of descending sort are inverted except keys of NaNs, so sort remains stable and NaNs are placed at the end */ \
+    static void radix_sort_##TYPE(TYPE const* data, imcs_pos_t* permutation, size_t n_elems, imcs_order_t order) \
     {                                                                   \
-        size_t i, j, d, n;                                              \
+        uint64* keys = (uint64*)imcs_alloc(n_elems*sizeof(uint64));     \
+        uint64 mask = ~(uint64)0 >> (64 - sizeof(TYPE)*8);              \
+        size_t i;                                                       \
+        for (i = 0; i < n_elems; i++) {                                 \
+            uint64 key = imcs_radix_key_##TYPE(data[i]);                \
+            keys[i] = (order == IMCS_DESC_ORDER && !imcs_is_nan_##TYPE(data[i])) ? ~key & mask : key; \
+            permutation[i] = i;                                         \
+        }                                                               \
+        imcs_radix_sort(keys, permutation, n_elems, sizeof(TYPE));      \
+        imcs_free(keys);                                                \
+    }                                                                   \
+    /* Sort values which are not NaN in ascending order */              \
+    static void imcs_sort_values_##TYPE(TYPE const* data, imcs_pos_t* permutation, size_t n_elems) \
+    {                                                                   \
+        size_t d, n;                                                    \
         if (n_elems > 1 && !sorted_##TYPE(data, n_elems)) {             \
             if (!rev_sorted_##TYPE(data, n_elems)) {                    \
                 n = n_elems / 4;                                        \
@@ -3425,18 +4519,155 @@ typedef struct {
                 }                                                       \
                 init_permutation_##TYPE(permutation, n_elems, IMCS_ASC_ORDER); \
                 qloop_##TYPE(data, permutation, n_elems, 2 * d);        \
-                if (order == IMCS_DESC_ORDER) {                         \
-                    for (i = 0, j = n_elems-1; i < j; i++, j--) {       \
-                        imcs_pos_t tmp = permutation[i];                \
-                        permutation[i] = permutation[j];                \
-                        permutation[j] = tmp;                           \
-                    }                                                   \
+            } else {                                                    \
+                init_permutation_##TYPE(permutation, n_elems, IMCS_DESC_ORDER); \
+            }                                                           \
+        } else {                                                        \
+            init_permutation_##TYPE(permutation, n_elems, IMCS_ASC_ORDER); \
+        }                                                               \
+    }                                                                   \
+    /* NaNs are placed after all other values, elements with the same value are ordered by position */ \
+    static void imcs_sequential_sort_##TYPE(TYPE const* data, imcs_pos_t* permutation, size_t n_elems, imcs_order_t order) \
+    {                                                                   \
+        size_t i, j, k, m = 0;                                          \
+        for (i = 0; i < n_elems; i++) {                                 \
+            m += !imcs_is_nan_##TYPE(data[i]);                          \
+        }                                                               \
+        if (n_elems >= IMCS_RADIX_SORT_THRESHOLD                        \
+            && !(m == n_elems && (sorted_##TYPE(data, n_elems) || rev_sorted_##TYPE(data, n_elems)))) \
+        {                                                               \
+            radix_sort_##TYPE(data, permutation, n_elems, order);       \
+            return;                                                     \
+        }                                                               \
+        if (m == n_elems) {                                             \
+            imcs_sort_values_##TYPE(data, permutation, n_elems);        \
+        } else { /* NaN is not comparable with other values: sort only other values */ \
+            TYPE* values = (TYPE*)imcs_alloc(m*sizeof(TYPE));           \
+            imcs_pos_t* positions = (imcs_pos_t*)imcs_alloc(m*sizeof(imcs_pos_t)); \
+            for (i = 0, j = 0, k = m; i < n_elems; i++) {               \
+                if (imcs_is_nan_##TYPE(data[i])) {                      \
+                    permutation[k++] = i;                               \
+                } else {                                                \
+                    values[j] = data[i];                                \
+                    positions[j++] = i;                                 \
                 }                                                       \
+            }                                                           \
+            imcs_sort_values_##TYPE(values, permutation, m);            \
+            for (i = 0; i < m; i++) {                                   \
+                permutation[i] = positions[permutation[i]];             \
+            }                                                           \
+            imcs_free(values);                                          \
+            imcs_free(positions);                                       \
+        }                                                               \
+        for (i = 0; i < m; i = j) {                                     \
+            bool ordered = true;                                        \
+            for (j = i + 1; j < m && data[permutation[j]] == data[permutation[i]]; j++) { \
+                ordered &= permutation[j-1] < permutation[j];           \
+            }                                                           \
+            if (!ordered) { /* comparison sort is not stable */         \
+                qsort(permutation + i, j - i, sizeof(imcs_pos_t), imcs_compare_pos); \
+            }                                                           \
+        }                                                               \
+        if (order == IMCS_DESC_ORDER) { /* reverse values but not positions of equal values */ \
+            imcs_reverse_pos(permutation, m);                           \
+            for (i = 0; i < m; i = j) {                                 \
+                for (j = i + 1; j < m && data[permutation[j]] == data[permutation[i]]; j++); \
+                imcs_reverse_pos(permutation + i, j - i);               \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    /* Sort chunk of the array, merge of sorted chunks preserves order of their elements */ \
+    static void imcs_sort_chunk_##TYPE(int chunk, int n_chunks, void* arg) \
+    {                                                                   \
+        imcs_parallel_sort_t* ps = (imcs_parallel_sort_t*)arg;          \
+        TYPE const* data = (TYPE const*)ps->data;                       \
+        size_t from = IMCS_SORT_CHUNK_BOUND(ps, chunk);                 \
+        size_t n = IMCS_SORT_CHUNK_BOUND(ps, chunk+1) - from;           \
+        imcs_pos_t* permutation = ps->src + from;                       \
+        size_t i;                                                       \
+        imcs_sequential_sort_##TYPE(data + from, permutation, n, ps->order); \
+        for (i = 0; i < n; i++) {                                       \
+            permutation[i] += from;                                     \
+        }                                                               \
+    }                                                                   \
+    /* Find how much elements of "a" precede k-th element of merge of "a" and "b" (elements of "a" precede equal elements of "b") */ \
+    static size_t imcs_merge_co_rank_##TYPE(TYPE const* data, imcs_order_t order, size_t k, imcs_pos_t const* a, size_t m, imcs_pos_t const* b, size_t n) \
+    {                                                                   \
+        size_t lo = k > n ? k - n : 0;                                  \
+        size_t hi = k < m ? k : m;                                      \
+        while (lo < hi) {                                               \
+            size_t i = (lo + hi) >> 1;                                  \
+            size_t j = k - i;                                           \
+            if (j > 0 && !IMCS_SORT_PRECEDES(TYPE, data[b[j-1]], data[a[i]], order)) { \
+                lo = i + 1;                                             \
             } else {                                                    \
-                init_permutation_##TYPE(permutation, n_elems, (imcs_order_t)(IMCS_DESC_ORDER - order)); \
+                hi = i;                                                 \
             }                                                           \
+        }                                                               \
+        return lo;                                                      \
+    }                                                                   \
+    /* Merge part of two adjacent runs: each pair of runs is merged by 2*width tasks, so all threads are busy at each round */ \
+    static void imcs_merge_runs_##TYPE(int task_id, int n_tasks, void* arg) \
+    {                                                                   \
+        imcs_parallel_sort_t* ps = (imcs_parallel_sort_t*)arg;          \
+        TYPE const* data = (TYPE const*)ps->data;                       \
+        imcs_order_t order = ps->order;                                 \
+        int n_parts = ps->width*2;                                      \
+        int first_chunk = task_id / n_parts * n_parts;                  \
+        int part = task_id % n_parts;                                   \
+        size_t a_start = IMCS_SORT_CHUNK_BOUND(ps, first_chunk);        \
+        size_t b_start = IMCS_SORT_CHUNK_BOUND(ps, first_chunk + ps->width); \
+        size_t m = b_start - a_start;                                   \
+        size_t n = IMCS_SORT_CHUNK_BOUND(ps, first_chunk + n_parts) - b_start; \
+        imcs_pos_t const* a = ps->src + a_start;                        \
+        imcs_pos_t const* b = ps->src + b_start;                        \
+        size_t k = (size_t)((uint64)(m + n)*part/n_parts);              \
+        size_t end = (size_t)((uint64)(m + n)*(part + 1)/n_parts);      \
+        size_t i = imcs_merge_co_rank_##TYPE(data, order, k, a, m, b, n); \
+        size_t j = k - i;                                               \
+        size_t i_end = imcs_merge_co_rank_##TYPE(data, order, end, a, m, b, n); \
+        size_t j_end = end - i_end;                                     \
+        imcs_pos_t* dst = ps->dst + a_start + k;                        \
+        while (i < i_end && j < j_end) {                                \
+            *dst++ = IMCS_SORT_PRECEDES(TYPE, data[b[j]], data[a[i]], order) ? b[j++] : a[i++]; \
+        }                                                               \
+        while (i < i_end) {                                             \
+            *dst++ = a[i++];                                            \
+        }                                                               \
+        while (j < j_end) {                                             \
+            *dst++ = b[j++];                                            \
+        }                                                               \
+    }                                                                   \
+    static void imcs_parallel_sort_##TYPE(TYPE const* data, imcs_pos_t* permutation, size_t n_elems, int n_workers, imcs_order_t order) \
+    {                                                                   \
+        imcs_parallel_sort_t ps;                                        \
+        imcs_pos_t* buf = (imcs_pos_t*)imcs_alloc(n_elems*sizeof(imcs_pos_t)); \
+        ps.data = data;                                                 \
+        ps.n_elems = n_elems;                                           \
+        ps.order = order;                                               \
+        ps.src = permutation;                                           \
+        ps.dst = buf;                                                   \
+        for (ps.n_chunks = 1; ps.n_chunks < n_workers; ps.n_chunks <<= 1); \
+        imcs_parallel_for(imcs_sort_chunk_##TYPE, ps.n_chunks, &ps);    \
+        for (ps.width = 1; ps.width < ps.n_chunks; ps.width <<= 1) {    \
+            imcs_pos_t* tmp = ps.src;                                   \
+            imcs_parallel_for(imcs_merge_runs_##TYPE, ps.n_chunks, &ps); \
+            ps.src = ps.dst;                                            \
+            ps.dst = tmp;                                               \
+        }                                                               \
+        if (ps.src != permutation) {                                    \
+            memcpy(permutation, ps.src, n_elems*sizeof(imcs_pos_t));    \
+        }                                                               \
+        imcs_free(buf);                                                 \
+    }                                                                   \
+    /* Large arrays are sorted by multiple threads */ \
+    static void imcs_sort_array_##TYPE(TYPE const* data, imcs_pos_t* permutation, size_t n_elems, imcs_order_t order) \
+    {                                                                   \
+        int n_workers = imcs_parallel_workers(n_elems);                 \
+        if (n_workers > 1) {                                            \
+            imcs_parallel_sort_##TYPE(data, permutation, n_elems, n_workers, order); \
         } else {                                                        \
-            init_permutation_##TYPE(permutation, n_elems, order);       \
+            imcs_sequential_sort_##TYPE(data, permutation, n_elems, order); \
         }                                                               \
     }                                                                   \
     static bool imcs_sort_pos_##TYPE##_next(imcs_iterator_h iterator)   \
@@ -3559,28 +4790,123 @@ typedef struct {
         ctx->order = order;                                             \
         return result;                                                  \
     }                                                                   \
+    static void select_heap_sift_##TYPE(TYPE* arr, size_t i, size_t n)  \
+    {                                                                   \
+        TYPE val = arr[i];                                              \
+        size_t child;                                                   \
+        while ((child = i*2 + 1) < n) {                                 \
+            if (child + 1 < n && arr[child] < arr[child + 1]) {         \
+                child += 1;                                             \
+            }                                                           \
+            if (!(val < arr[child])) {                                  \
+                break;                                                  \
+            }                                                           \
+            arr[i] = arr[child];                                        \
+            i = child;                                                  \
+        }                                                               \
+        arr[i] = val;                                                   \
+    }                                                                   \
+    static void select_heap_sort_##TYPE(TYPE* arr, size_t n)            \
+    {                                                                   \
+        size_t i;                                                       \
+        for (i = n/2; i-- != 0;) {                                      \
+            select_heap_sift_##TYPE(arr, i, n);                         \
+        }                                                               \
+        while (n > 1) {                                                 \
+            TYPE tmp = arr[0];                                          \
+            arr[0] = arr[--n];                                          \
+            arr[n] = tmp;                                               \
+            select_heap_sift_##TYPE(arr, 0, n);                         \
+        }                                                               \
+    }                                                                   \
+    /*                                                                  \
+     * Multi-select (introselect): rearrange elements of arr[l,r) so that elements at positions ranks[0..n_ranks) \
+     * (ordered in ascending order) are the same as in sorted array. Three-way partitioning is used to efficiently handle duplicates. \
+     * If recursion is too deep (bad pivots), range is sorted by heap sort, so worst case complexity is O(n*log(n)). \
+     */                                                                 \
+    static void imcs_select_##TYPE(TYPE* arr, size_t l, size_t r, size_t const* ranks, size_t n_ranks, int depth) \
+    {                                                                   \
+        while (n_ranks != 0 && r - l > IMCS_SELECT_INSERTION_THRESHOLD) { \
+            TYPE a = arr[l], b = arr[(l + r) >> 1], c = arr[r-1];       \
+            TYPE pivot = a < b ? (b < c ? b : a < c ? c : a) : (a < c ? a : b < c ? c : b); \
+            size_t lt = l, gt = r, i = l, n_left, n_right;              \
+            if (depth-- == 0) {                                         \
+                select_heap_sort_##TYPE(arr + l, r - l);                \
+                return;                                                 \
+            }                                                           \
+            while (i < gt) {                                            \
+                TYPE val = arr[i];                                      \
+                if (val < pivot) {                                      \
+                    arr[i++] = arr[lt];                                 \
+                    arr[lt++] = val;                                    \
+                } else if (pivot < val) {                               \
+                    arr[i] = arr[--gt];                                 \
+                    arr[gt] = val;                                      \
+                } else {                                                \
+                    i += 1;                                             \
+                }                                                       \
+            }                                                           \
+            for (n_left = 0; n_left < n_ranks && ranks[n_left] < lt; n_left++); \
+            for (n_right = n_ranks; n_right > n_left && ranks[n_right-1] >= gt; n_right--); \
+            imcs_select_##TYPE(arr, l, lt, ranks, n_left, depth);       \
+            ranks += n_right;                                           \
+            n_ranks -= n_right;                                         \
+            l = gt;                                                     \
+        }                                                               \
+        if (n_ranks != 0) {                                             \
+            size_t i, j;                                                \
+            for (i = l + 1; i < r; i++) {                               \
+                TYPE val = arr[i];                                      \
+                for (j = i; j > l && val < arr[j-1]; j--) {             \
+                    arr[j] = arr[j-1];                                  \
+                }                                                       \
+                arr[j] = val;                                           \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    static void imcs_multi_select_##TYPE(TYPE* arr, size_t n_elems, size_t const* ranks, size_t n_ranks) \
+    {                                                                   \
+        int depth = 0;                                                  \
+        size_t i, n, n_values = 0;                                      \
+        for (i = 0; i < n_elems; i++) { /* NaNs are placed last, as by sort */ \
+            if (!imcs_is_nan_##TYPE(arr[i])) {                          \
+                TYPE val = arr[i];                                      \
+                arr[i] = arr[n_values];                                 \
+                arr[n_values++] = val;                                  \
+            }                                                           \
+        }                                                               \
+        while (n_ranks != 0 && ranks[n_ranks-1] >= n_values) {          \
+            n_ranks -= 1;                                               \
+        }                                                               \
+        for (n = n_values; n != 0; n >>= 1) {                           \
+            depth += 2;                                                 \
+        }                                                               \
+        imcs_select_##TYPE(arr, 0, n_values, ranks, n_ranks, depth);    \
+    }                                                                   \
     static bool imcs_quantile_##TYPE##_next(imcs_iterator_h iterator)   \
     {                                                                   \
         size_t i, count;                                                \
         size_t q_num = iterator->last_pos-1;                            \
         TYPE* arr;                                                      \
-        imcs_pos_t* permutation;                                        \
+        size_t* ranks;                                                  \
         TYPE* quantiles;                                                \
-        count = (size_t)imcs_count(iterator->opd[0]);                   \
+        count = imcs_fetch_all(iterator->opd[0], (void**)&arr);         \
         if (count == 0) {                                               \
+            imcs_free(arr);                                             \
             return false;                                               \
         }                                                               \
-        arr = (TYPE*)palloc(count*sizeof(TYPE));                        \
-        permutation = (imcs_pos_t*)palloc(count*sizeof(imcs_pos_t));    \
+        ranks = (size_t*)imcs_alloc((q_num+1)*sizeof(size_t));          \
         quantiles = (TYPE*)imcs_alloc((q_num+1)*sizeof(TYPE));          \
-        imcs_to_array(iterator->opd[0], arr, count);                    \
-        imcs_sort_array_##TYPE(arr, permutation, count, IMCS_ASC_ORDER); \
         for (i = 0; i < q_num; i++) {                                   \
-            quantiles[i] = arr[permutation[count*i/q_num]];             \
+            ranks[i] = (size_t)((uint64)count*i/q_num);                 \
         }                                                               \
-        quantiles[q_num] = arr[permutation[count-1]];                   \
-        pfree(arr);                                                     \
-        pfree(permutation);                                             \
+        ranks[q_num] = count-1;                                         \
+        imcs_multi_select_##TYPE(arr, count, ranks, q_num+1);           \
+        for (i = 0; i <= q_num; i++) {                                  \
+            quantiles[i] = arr[ranks[i]];                               \
+        }                                                               \
+        imcs_free(arr);                                                 \
+        imcs_free(ranks);                                               \
         imcs_from_array(iterator, quantiles, q_num+1);                  \
         return iterator->next(iterator);                                \
     }                                                                   \
@@ -3600,25 +4926,24 @@ typedef struct {
     }                                                                   \
     static bool imcs_median_##TYPE##_next(imcs_iterator_h iterator)     \
     {                                                                   \
-        size_t count = (size_t)imcs_count(iterator->opd[0]);            \
+        size_t count;                                                   \
+        size_t ranks[2];                                                \
         TYPE* arr;                                                      \
-        imcs_pos_t* permutation;                                        \
         if (iterator->next_pos != 0) {                                  \
             return false;                                               \
         }                                                               \
-        count = (size_t)imcs_count(iterator->opd[0]);                   \
+        count = imcs_fetch_all(iterator->opd[0], (void**)&arr);         \
         if (count == 0) {                                               \
+            imcs_free(arr);                                             \
             return false;                                               \
         }                                                               \
-        arr = (TYPE*)palloc(count*sizeof(TYPE));                        \
-        permutation = (imcs_pos_t*)palloc(count*sizeof(imcs_pos_t));    \
-        imcs_to_array(iterator->opd[0], arr, count);                    \
-        imcs_sort_array_##TYPE(arr, permutation, count, IMCS_ASC_ORDER); \
+        ranks[0] = (count - 1) >> 1;                                    \
+        ranks[1] = count >> 1;                                          \
+        imcs_multi_select_##TYPE(arr, count, ranks, 2);                 \
         iterator->tile.arr_double[0] = (count & 1) ? arr[count >> 1] : (arr[(count >> 1)-1] + arr[count >> 1])/2; \
         iterator->tile_size = 1;                                        \
         iterator->next_pos = 1;                                         \
-        pfree(arr);                                                     \
-        pfree(permutation);                                             \
+        imcs_free(arr);                                                 \
         return true;                                                    \
     }                                                                   \
     imcs_iterator_h imcs_median_##TYPE(imcs_iterator_h input)           \
@@ -5088,8 +6413,33 @@ typedef struct {
     size_t table_used;
     imcs_hash_basket_t* baskets;
     imcs_hash_elem_t** table;
+    imcs_hash_elem_t** parts;      /* elements of the table split into partitions for parallel merge */
+    size_t* parts_used;            /* number of groups in each partition of merged table */
+    volatile int n_pending_parts;  /* number of partitions which are not merged yet */
+    imcs_hash_basket_t* elems_basket; /* baskets being filled: next prepare() for another morsel continues to fill them */
+    imcs_hash_basket_t* keys_basket;
+    size_t elems_basket_used;
+    size_t keys_basket_used;
 } imcs_hash_t;
 
+static imcs_hash_t* imcs_hash_create(size_t table_size)
+{
+    imcs_hash_t* hash = (imcs_hash_t*)imcs_alloc(sizeof(imcs_hash_t));
+    hash->table_size = table_size;
+    hash->table_used = 0;
+    hash->baskets = 0;
+    hash->table = (imcs_hash_elem_t**)imcs_alloc(table_size*sizeof(imcs_hash_elem_t*));
+    memset(hash->table, 0, table_size*sizeof(imcs_hash_elem_t*));
+    hash->parts = NULL;
+    hash->parts_used = NULL;
+    hash->n_pending_parts = 0;
+    hash->elems_basket = 0;
+    hash->keys_basket = 0;
+    hash->elems_basket_used = IMCS_HASH_BASKET_N_ELEMS;
+    hash->keys_basket_used = IMCS_HASH_BASKET_SIZE;
+    return hash;
+}
+
 typedef struct {
     imcs_hash_t* hash;
 } imcs_shared_hash_t;
@@ -5110,27 +6460,87 @@ static void imcs_hash_agg_reset(imcs_iterator_h iterator)
     imcs_reset_iterator(iterator);
 }
 
+/* Size of hash table for merged results of parallel workers: it is large enough to avoid resize during merge */
+static size_t imcs_hash_merged_table_size(imcs_iterator_h* results, int n_results)
+{
+    size_t table_size = 0;
+    size_t total_used = 0;
+    int i;
+    for (i = 0; i < n_results; i++) {
+        imcs_hash_t* hash = ((imcs_hash_iterator_context_t*)results[i]->context)->private_hash;
+        total_used += hash->table_used;
+        if (hash->table_size > table_size) {
+            table_size = hash->table_size;
+        }
+    }
+    while (total_used >= (size_t)(imcs_hash_table_load_factor*table_size)-1) {
+        table_size = imcs_next_prime_number(table_size);
+    }
+    return table_size;
+}
+
+/*
+ * Split hash table of i-th worker into partitions. Partition is a range of chains of the merged hash table,
+ * so partitions can be merged concurrently without any synchronization.
+ */
+static void imcs_hash_scatter(imcs_iterator_h* results, int n_results, int i, int n_parts)
+{
+    imcs_hash_iterator_context_t* ctx = (imcs_hash_iterator_context_t*)results[i]->context;
+    imcs_hash_t* hash = ctx->private_hash;
+    size_t merged_table_size = imcs_hash_merged_table_size(results, n_results);
+    imcs_hash_elem_t** parts = (imcs_hash_elem_t**)imcs_alloc(n_parts*sizeof(imcs_hash_elem_t*));
+    imcs_hash_elem_t* elem;
+    imcs_hash_elem_t* next;
+    size_t j;
+    memset(parts, 0, n_parts*sizeof(imcs_hash_elem_t*));
+    for (j = 0; j < hash->table_size; j++) {
+        for (elem = hash->table[j]; elem != NULL; elem = next) {
+            int part = (int)((uint64)(elem->grp_hash % merged_table_size)*n_parts/merged_table_size);
+            next = elem->collision;
+            elem->collision = parts[part];
+            parts[part] = elem;
+        }
+    }
+    hash->parts = parts;
+    if (i == 0) { /* results are merged in new hash table */
+        imcs_hash_t* merged = imcs_hash_create(merged_table_size);
+        merged->parts_used = (size_t*)imcs_alloc(n_parts*sizeof(size_t));
+        merged->n_pending_parts = n_parts;
+        ctx->shared->hash = merged;
+    }
+}
+
+/* Merged partition is completed: last merged partition calculates total number of groups */
+static void imcs_hash_partition_merged(imcs_iterator_h* results, int part, int n_parts, size_t distinct_count)
+{
+    imcs_hash_iterator_context_t* ctx = (imcs_hash_iterator_context_t*)results[0]->context;
+    imcs_hash_t* hash = ctx->shared->hash;
+    hash->parts_used[part] = distinct_count;
+    if (IMCS_ATOMIC_FETCH_ADD(&hash->n_pending_parts, -1) == 1) {
+        int i;
+        for (i = 0; i < n_parts; i++) {
+            hash->table_used += hash->parts_used[i];
+        }
+        ctx->private_hash = hash;
+    }
+}
+
 #define IMCS_HASH_AGG_DEF(AGG_TYPE, IN_TYPE, OP, INITIALIZE, ACCUMULATE, RESULT) \
 static bool imcs_hash_initialize_##OP##_##IN_TYPE(imcs_iterator_h iterator) \
 {                                                                       \
     imcs_hash_iterator_context_t* ctx = (imcs_hash_iterator_context_t*)iterator->context; \
+    imcs_hash_t* hash = ctx->private_hash != NULL ? ctx->private_hash : (ctx->private_hash = imcs_hash_create(ctx->n_groups)); \
     size_t i, tile_size;                                                \
     size_t elem_size = iterator->opd[1]->elem_size;                     \
     imcs_hash_elem_t* elem;                                             \
     imcs_key_t val;                                                     \
-    size_t elems_basket_used = IMCS_HASH_BASKET_N_ELEMS;                \
-    size_t keys_basket_used = IMCS_HASH_BASKET_SIZE;                    \
-    imcs_hash_basket_t* elems_basket = 0;                               \
-    imcs_hash_basket_t* keys_basket = 0;                                \
-    size_t distinct_count = 0;                                          \
-    size_t hash_table_size = ctx->n_groups;                             \
+    size_t elems_basket_used = hash->elems_basket_used;                 \
+    size_t keys_basket_used = hash->keys_basket_used;                   \
+    imcs_hash_basket_t* elems_basket = hash->elems_basket;              \
+    imcs_hash_basket_t* keys_basket = hash->keys_basket;                \
+    size_t distinct_count = hash->table_used;                           \
+    size_t hash_table_size = hash->table_size;                          \
     size_t threshold = (size_t)(imcs_hash_table_load_factor*hash_table_size)-1; \
-    imcs_hash_t* hash = (imcs_hash_t*)imcs_alloc(sizeof(imcs_hash_t)); \
-    hash->table_size = hash_table_size;                                 \
-    hash->table = (imcs_hash_elem_t**)imcs_alloc(hash_table_size*sizeof(imcs_hash_elem_t*)); \
-    hash->baskets = 0;                                                  \
-    memset(hash->table, 0, sizeof(imcs_hash_elem_t*)*hash_table_size);  \
-    ctx->private_hash = hash;                                           \
     val.val_int64 = 0;                                                  \
     while (iterator->opd[1]->next(iterator->opd[1])) {                  \
         if (iterator->opd[0] != 0) {                                    \
@@ -5210,6 +6620,10 @@ static bool imcs_hash_initialize_##OP##_##IN_TYPE(imcs_iterator_h iterator) \
         }                                                               \
     }                                                                   \
     hash->table_used = distinct_count;                                  \
+    hash->elems_basket = elems_basket;                                  \
+    hash->keys_basket = keys_basket;                                    \
+    hash->elems_basket_used = elems_basket_used;                        \
+    hash->keys_basket_used = keys_basket_used;                          \
     return true;                                                        \
 }                                                                       \
 static void imcs_hash_merge_##OP##_##IN_TYPE(imcs_iterator_h dst, imcs_iterator_h src) \
@@ -5277,6 +6691,40 @@ static void imcs_hash_merge_##OP##_##IN_TYPE(imcs_iterator_h dst, imcs_iterator_
     hash->table_used = distinct_count;                                  \
     ctx->shared->hash = hash;                                           \
 }                                                                       \
+static void imcs_hash_merge_partition_##OP##_##IN_TYPE(imcs_iterator_h* results, int n_results, int part, int n_parts) \
+{                                                                       \
+    imcs_hash_iterator_context_t* ctx = (imcs_hash_iterator_context_t*)results[0]->context; \
+    imcs_hash_t* hash = ctx->shared->hash;                              \
+    size_t elem_size = results[0]->opd[1]->elem_size;                   \
+    size_t hash_table_size = hash->table_size;                          \
+    size_t distinct_count = 0;                                          \
+    imcs_hash_elem_t* elem;                                             \
+    imcs_hash_elem_t* next;                                             \
+    imcs_hash_elem_t* src_elem;                                         \
+    int i;                                                              \
+    for (i = 0; i < n_results; i++) {                                   \
+        imcs_hash_t* src_hash = ((imcs_hash_iterator_context_t*)results[i]->context)->private_hash; \
+        for (src_elem = src_hash->parts[part]; src_elem != NULL; src_elem = next) { \
+            imcs_hash_elem_t** pprev = &hash->table[src_elem->grp_hash % hash_table_size]; \
+            int64 diff = 1;                                             \
+            next = src_elem->collision;                                 \
+            if (elem_size <= sizeof(imcs_key_t)) {                      \
+                for (elem = *pprev; elem != NULL && (diff = elem->grp.val_int64 - src_elem->grp.val_int64) < 0; elem = *(pprev = &elem->collision)); \
+            } else {                                                    \
+                for (elem = *pprev; elem != NULL && (diff = memcmp(elem->grp.val_ptr, src_elem->grp.val_ptr, elem_size)) < 0; elem = *(pprev = &elem->collision)); \
+            }                                                           \
+            if (diff == 0) {                                            \
+                ACCUMULATE(elem->agg.val_##AGG_TYPE, src_elem->agg.val_##AGG_TYPE); \
+                elem->count += src_elem->count;                         \
+            } else {                                                    \
+                src_elem->collision = *pprev;                           \
+                *pprev = src_elem;                                      \
+                distinct_count += 1;                                    \
+            }                                                           \
+        }                                                               \
+    }                                                                   \
+    imcs_hash_partition_merged(results, part, n_parts, distinct_count); \
+}                                                                       \
 static bool imcs_hash_##OP##_##IN_TYPE##_next_agg(imcs_iterator_h iterator) \
 {                                                                       \
     imcs_hash_iterator_context_t* ctx = (imcs_hash_iterator_context_t*)iterator->context; \
@@ -5287,7 +6735,9 @@ static bool imcs_hash_##OP##_##IN_TYPE##_next_agg(imcs_iterator_h iterator) \
     size_t table_size;                                                  \
     imcs_hash_t* hash = ctx->shared->hash;                              \
     if (!hash) {                                                        \
-        imcs_hash_initialize_##OP##_##IN_TYPE(iterator);                \
+        if (!ctx->private_hash) { /* otherwise table was constructed by single parallel worker */ \
+            imcs_hash_initialize_##OP##_##IN_TYPE(iterator);            \
+        }                                                               \
         hash = ctx->shared->hash = ctx->private_hash;                   \
     }                                                                   \
     elem = ctx->curr_elem;                                              \
@@ -5321,7 +6771,9 @@ static bool imcs_hash_##OP##_##IN_TYPE##_next_grp(imcs_iterator_h iterator) \
     size_t elem_size = iterator->elem_size;                             \
     imcs_hash_t* hash = ctx->shared->hash;                              \
     if (!hash) {                                                        \
-        imcs_hash_initialize_##OP##_##IN_TYPE(iterator);                \
+        if (!ctx->private_hash) { /* otherwise table was constructed by single parallel worker */ \
+            imcs_hash_initialize_##OP##_##IN_TYPE(iterator);            \
+        }                                                               \
         hash = ctx->shared->hash = ctx->private_hash;                   \
     }                                                                   \
     elem = ctx->curr_elem;                                              \
@@ -5360,19 +6812,24 @@ void imcs_hash_##OP##_##IN_TYPE(imcs_iterator_h result[2], imcs_iterator_h input
     ctx->shared = shared;                                               \
     ctx->curr_elem = 0;                                                 \
     ctx->chain_no = 0;                                                  \
+    ctx->private_hash = 0;                                              \
     result_agg->opd[0] = input != NULL ? imcs_operand(input) : NULL;    \
     result_agg->opd[1] = imcs_operand(group_by);                        \
     result_agg->elem_type = TID_##AGG_TYPE;                             \
+    result_agg->flags = FLAG_ACCUMULATIVE;                              \
     result_agg->next = imcs_hash_##OP##_##IN_TYPE##_next_agg;           \
     result_agg->reset = imcs_hash_agg_reset;                            \
     result_agg->prepare = imcs_hash_initialize_##OP##_##IN_TYPE;        \
     result_agg->merge = imcs_hash_merge_##OP##_##IN_TYPE;               \
+    result_agg->scatter = imcs_hash_scatter;                            \
+    result_agg->merge_partition = imcs_hash_merge_partition_##OP##_##IN_TYPE; \
                                                                         \
     ctx = (imcs_hash_iterator_context_t*)result_grp->context;           \
     ctx->n_groups = imcs_hash_table_init_size;                          \
     ctx->shared = shared;                                               \
     ctx->curr_elem = 0;                                                 \
     ctx->chain_no = 0;                                                  \
+    ctx->private_hash = 0;                                              \
     result_grp->opd[0] = input != NULL ? imcs_operand(input) : NULL;    \
     result_grp->opd[1] = imcs_operand(group_by);                        \
     result_grp->elem_type = group_by->elem_type;                        \
@@ -5461,26 +6918,20 @@ void imcs_hash_count(imcs_iterator_h result[2], imcs_iterator_h group_by)
 static bool imcs_hash_initialize_approxdc(imcs_iterator_h iterator)
 {
     imcs_hash_iterator_context_t* ctx = (imcs_hash_iterator_context_t*)iterator->context;
-    imcs_hash_t* hash;
+    imcs_hash_t* hash = ctx->private_hash != NULL ? ctx->private_hash : (ctx->private_hash = imcs_hash_create(ctx->n_groups));
     size_t i, tile_size;
     size_t agg_elem_size = iterator->opd[0]->elem_size;
     size_t grp_elem_size = iterator->opd[1]->elem_size;
     imcs_hash_elem_t* elem;
     imcs_key_t val;
-    size_t elems_basket_used = IMCS_HASH_BASKET_N_ELEMS;
-    size_t keys_basket_used = IMCS_HASH_BASKET_SIZE;
-    imcs_hash_basket_t* elems_basket = 0;
-    imcs_hash_basket_t* keys_basket = 0;
-    size_t distinct_count = 0;
-    size_t hash_table_size = ctx->n_groups;
+    size_t elems_basket_used = hash->elems_basket_used;
+    size_t keys_basket_used = hash->keys_basket_used;
+    imcs_hash_basket_t* elems_basket = hash->elems_basket;
+    imcs_hash_basket_t* keys_basket = hash->keys_basket;
+    size_t distinct_count = hash->table_used;
+    size_t hash_table_size = hash->table_size;
     size_t threshold = (size_t)(imcs_hash_table_load_factor*hash_table_size)-1;
 
-    hash = (imcs_hash_t*)imcs_alloc(sizeof(imcs_hash_t));
-    hash->table_size = hash_table_size;
-    hash->table = (imcs_hash_elem_t**)imcs_alloc(hash_table_size*sizeof(imcs_hash_elem_t*));
-    hash->baskets = 0;
-    memset(hash->table, 0, sizeof(imcs_hash_elem_t*)*hash_table_size);
-    ctx->private_hash = hash;
     val.val_int64 = 0;
     while (iterator->opd[1]->next(iterator->opd[1])) {
         if (iterator->opd[0] != 0) {
@@ -5568,6 +7019,10 @@ static bool imcs_hash_initialize_approxdc(imcs_iterator_h iterator)
         }
     }
     hash->table_used = distinct_count;
+    hash->elems_basket = elems_basket;
+    hash->keys_basket = keys_basket;
+    hash->elems_basket_used = elems_basket_used;
+    hash->keys_basket_used = keys_basket_used;
     return true;
 }
 static void imcs_hash_merge_approxdc(imcs_iterator_h dst, imcs_iterator_h src)
@@ -5644,7 +7099,9 @@ static bool imcs_hash_approxdc_next_agg(imcs_iterator_h iterator)
     size_t table_size;
     imcs_hash_t* hash = ctx->shared->hash;
     if (!hash) {
-        imcs_hash_initialize_approxdc(iterator);
+        if (!ctx->private_hash) { /* otherwise table was constructed by single parallel worker */
+            imcs_hash_initialize_approxdc(iterator);
+        }
         hash = ctx->shared->hash = ctx->private_hash;
     }
     elem = ctx->curr_elem;
@@ -5678,7 +7135,9 @@ static bool imcs_hash_approxdc_next_grp(imcs_iterator_h iterator)
     size_t grp_elem_size = iterator->elem_size;
     imcs_hash_t* hash = ctx->shared->hash;
     if (!hash) {
-        imcs_hash_initialize_approxdc(iterator);
+        if (!ctx->private_hash) { /* otherwise table was constructed by single parallel worker */
+            imcs_hash_initialize_approxdc(iterator);
+        }
         hash = ctx->shared->hash = ctx->private_hash;
     }
     elem = ctx->curr_elem;
@@ -5714,9 +7173,11 @@ void imcs_hash_approxdc(imcs_iterator_h result[2], imcs_iterator_h input, imcs_i
     ctx->shared = shared;
     ctx->curr_elem = 0;
     ctx->chain_no = 0;
+    ctx->private_hash = 0;
     result_agg->opd[0] = imcs_operand(input);
     result_agg->opd[1] = imcs_operand(group_by);
     result_agg->elem_type = TID_int64;
+    result_agg->flags = FLAG_ACCUMULATIVE;
     result_agg->next = imcs_hash_approxdc_next_agg;
     result_agg->reset = imcs_hash_agg_reset;
     result_agg->prepare = imcs_hash_initialize_approxdc;
@@ -5727,6 +7188,7 @@ void imcs_hash_approxdc(imcs_iterator_h result[2], imcs_iterator_h input, imcs_i
     ctx->shared = shared;
     ctx->curr_elem = 0;
     ctx->chain_no = 0;
+    ctx->private_hash = 0;
     result_grp->opd[0] = imcs_operand(input);
     result_grp->opd[1] = imcs_operand(group_by);
     result_grp->elem_type = group_by->elem_type;
@@ -5750,44 +7212,29 @@ typedef struct {
 static bool imcs_dup_hash_initialize(imcs_iterator_h iterator)
 {
     imcs_dup_hash_iterator_context_t* ctx = (imcs_dup_hash_iterator_context_t*)iterator->context;
-    imcs_hash_t* hash;
-    imcs_hash_t* agg_hash;
+    imcs_hash_t* hash = ctx->groups.private_hash != NULL ? ctx->groups.private_hash : (ctx->groups.private_hash = imcs_hash_create(ctx->groups.n_groups));
+    imcs_hash_t* agg_hash = ctx->agg_hash != NULL ? ctx->agg_hash : (ctx->agg_hash = imcs_hash_create(ctx->n_pairs));
     size_t i, tile_size;
     size_t agg_elem_size = iterator->opd[0]->elem_size;
     size_t grp_elem_size = iterator->opd[1]->elem_size;
     imcs_hash_elem_t* elem;
     imcs_key_t grp_val;
     imcs_key_t agg_val;
-    size_t grp_elems_basket_used = IMCS_HASH_BASKET_N_ELEMS;
-    size_t grp_keys_basket_used = IMCS_HASH_BASKET_SIZE;
-    size_t agg_elems_basket_used = IMCS_HASH_BASKET_N_ELEMS;
-    size_t agg_keys_basket_used = IMCS_HASH_BASKET_SIZE;
-    imcs_hash_basket_t* grp_elems_basket = 0;
-    imcs_hash_basket_t* grp_keys_basket = 0;
-    imcs_hash_basket_t* agg_elems_basket = 0;
-    imcs_hash_basket_t* agg_keys_basket = 0;
-    size_t hash_table_size = ctx->groups.n_groups;
-    size_t agg_hash_table_size = ctx->n_pairs;
+    size_t grp_elems_basket_used = hash->elems_basket_used;
+    size_t grp_keys_basket_used = hash->keys_basket_used;
+    size_t agg_elems_basket_used = agg_hash->elems_basket_used;
+    size_t agg_keys_basket_used = agg_hash->keys_basket_used;
+    imcs_hash_basket_t* grp_elems_basket = hash->elems_basket;
+    imcs_hash_basket_t* grp_keys_basket = hash->keys_basket;
+    imcs_hash_basket_t* agg_elems_basket = agg_hash->elems_basket;
+    imcs_hash_basket_t* agg_keys_basket = agg_hash->keys_basket;
+    size_t hash_table_size = hash->table_size;
+    size_t agg_hash_table_size = agg_hash->table_size;
     size_t threshold = (size_t)(imcs_hash_table_load_factor*hash_table_size)-1;
     size_t agg_threshold = (size_t)(imcs_hash_table_load_factor*agg_hash_table_size)-1;
-    size_t distinct_count = 0;
-    size_t agg_distinct_count = 0;
-
-    hash = (imcs_hash_t*)imcs_alloc(sizeof(imcs_hash_t));
-    hash->table = (imcs_hash_elem_t**)imcs_alloc(hash_table_size*sizeof(imcs_hash_elem_t*));
-    memset(hash->table, 0, hash_table_size*sizeof(imcs_hash_elem_t*));
-    hash->table_size = hash_table_size;
-    ctx->groups.private_hash = hash;
-
-    agg_hash = (imcs_hash_t*)imcs_alloc(sizeof(imcs_hash_t));
-    agg_hash->table = (imcs_hash_elem_t**)imcs_alloc(agg_hash_table_size*sizeof(imcs_hash_elem_t*));
-    memset(agg_hash->table, 0, agg_hash_table_size*sizeof(imcs_hash_elem_t*));
-    agg_hash->table_size = agg_hash_table_size;
-    ctx->agg_hash = agg_hash;
+    size_t distinct_count = hash->table_used;
+    size_t agg_distinct_count = agg_hash->table_used;
 
-    hash->baskets = 0;
-    agg_hash->baskets = 0;
-    agg_hash->table_size = agg_hash_table_size;
     grp_val.val_int64 = 0;
     agg_val.val_int64 = 0;
 
@@ -5956,6 +7403,14 @@ static bool imcs_dup_hash_initialize(imcs_iterator_h iterator)
     }
     agg_hash->table_used = agg_distinct_count;
     hash->table_used = distinct_count;
+    hash->elems_basket = grp_elems_basket;
+    hash->keys_basket = grp_keys_basket;
+    hash->elems_basket_used = grp_elems_basket_used;
+    hash->keys_basket_used = grp_keys_basket_used;
+    agg_hash->elems_basket = agg_elems_basket;
+    agg_hash->keys_basket = agg_keys_basket;
+    agg_hash->elems_basket_used = agg_elems_basket_used;
+    agg_hash->keys_basket_used = agg_keys_basket_used;
     return true;
 }
 
@@ -6108,7 +7563,9 @@ static bool imcs_dup_hash_next_count(imcs_iterator_h iterator)
     size_t table_size;
     imcs_hash_t* hash = ctx->shared->hash;
     if (!hash) {
-        imcs_dup_hash_initialize(iterator);
+        if (!ctx->private_hash) { /* otherwise table was constructed by single parallel worker */
+            imcs_dup_hash_initialize(iterator);
+        }
         hash = ctx->shared->hash = ctx->private_hash;
     }
     elem = ctx->curr_elem;
@@ -6143,7 +7600,9 @@ static bool imcs_dup_hash_next_grp(imcs_iterator_h iterator)
     size_t grp_elem_size = iterator->elem_size;
     imcs_hash_t* hash = ctx->shared->hash;
     if (!hash) {
-        imcs_dup_hash_initialize(iterator);
+        if (!ctx->private_hash) { /* otherwise table was constructed by single parallel worker */
+            imcs_dup_hash_initialize(iterator);
+        }
         hash = ctx->shared->hash = ctx->private_hash;
     }
     elem = ctx->curr_elem;
@@ -6181,11 +7640,14 @@ void imcs_hash_dup_count(imcs_iterator_h result[2], imcs_iterator_h input, imcs_
     ctx->groups.chain_no = 0;
     ctx->groups.n_groups = imcs_hash_table_init_size;
     ctx->groups.shared = shared;
+    ctx->groups.private_hash = 0;
     ctx->n_pairs = imcs_hash_table_init_size;
     ctx->min_occurrences = min_occurrences;
+    ctx->agg_hash = 0;
     result_cnt->opd[0] = imcs_operand(input);
     result_cnt->opd[1] = imcs_operand(group_by);
     result_cnt->elem_type = TID_int64;
+    result_cnt->flags = FLAG_ACCUMULATIVE;
     result_cnt->next = imcs_dup_hash_next_count;
     result_cnt->reset = imcs_hash_agg_reset;
     result_cnt->prepare =  imcs_dup_hash_initialize;
@@ -6196,8 +7658,10 @@ void imcs_hash_dup_count(imcs_iterator_h result[2], imcs_iterator_h input, imcs_
     ctx->groups.chain_no = 0;
     ctx->groups.n_groups = imcs_hash_table_init_size;
     ctx->groups.shared = shared;
+    ctx->groups.private_hash = 0;
     ctx->n_pairs = imcs_hash_table_init_size;
     ctx->min_occurrences = min_occurrences;
+    ctx->agg_hash = 0;
     result_grp->opd[0] = imcs_operand(input);
     result_grp->opd[1] = imcs_operand(group_by);
     result_grp->elem_type = group_by->elem_type;
@@ -6690,6 +8154,7 @@ imcs_iterator_h imcs_##MNEM##_##TYPE(imcs_iterator_h input, imcs_iterator_h grou
     result->opd[1] = imcs_operand(group_by);                            \
     result->next = imcs_##MNEM##_##TYPE##_next;                         \
     result->reset = imcs_reset_binary_agg_iterator;                     \
+    result->flags = FLAG_GROUPED;                                       \
     ctx->offset = ctx->count = 0;                                       \
     return result;                                                      \
 }
@@ -3,6 +3,20 @@
 
 #include "imcs.h"
 
+/* Aggregates calculated by imcs_group_agg_* */
+typedef enum
+{
+    IMCS_MULTI_AGG_FIRST,
+    IMCS_MULTI_AGG_LAST,
+    IMCS_MULTI_AGG_MIN,
+    IMCS_MULTI_AGG_MAX,
+    IMCS_MULTI_AGG_SUM,
+    IMCS_MULTI_AGG_AVG,
+    IMCS_MULTI_AGG_VAR,
+    IMCS_MULTI_AGG_DEV,
+    IMCS_MULTI_AGG_COUNT
+} imcs_multi_agg_t;
+
 /* Functions defined for all scalar types */
 #define IMCS_FUNC_DECL(TYPE)                                        \
     typedef TYPE(*imcs_func_##TYPE##_ptr_t)(TYPE arg);                  \
@@ -90,6 +104,14 @@
     imcs_iterator_h imcs_window_dev_##TYPE(imcs_iterator_h input, size_t interval); \
     imcs_iterator_h imcs_window_ema_##TYPE(imcs_iterator_h input, size_t interval); \
     imcs_iterator_h imcs_window_atr_##TYPE(imcs_iterator_h input, size_t interval); \
+    imcs_iterator_h imcs_window_max_time_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration); \
+    imcs_iterator_h imcs_window_min_time_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration); \
+    imcs_iterator_h imcs_window_sum_time_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration); \
+    imcs_iterator_h imcs_window_avg_time_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration); \
+    imcs_iterator_h imcs_window_var_time_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration); \
+    imcs_iterator_h imcs_window_dev_time_##TYPE(imcs_iterator_h input, imcs_iterator_h ts, int64 duration); \
+    void imcs_group_agg_##TYPE(imcs_iterator_h* result, imcs_iterator_h input, imcs_iterator_h group_by, int n_aggs, imcs_multi_agg_t const* aggs); \
+    void imcs_agg_##TYPE(imcs_iterator_h* result, imcs_iterator_h input, int n_aggs, imcs_multi_agg_t const* aggs); \
     void imcs_hash_max_##TYPE(imcs_iterator_h result[2], imcs_iterator_h input, imcs_iterator_h group_by); \
     void imcs_hash_min_##TYPE(imcs_iterator_h result[2], imcs_iterator_h input, imcs_iterator_h group_by); \
     void imcs_hash_sum_##TYPE(imcs_iterator_h result[2], imcs_iterator_h input, imcs_iterator_h group_by); \
@@ -220,6 +242,7 @@ imcs_iterator_h imcs_count_iterator(imcs_iterator_h input);
 imcs_iterator_h imcs_approxdc(imcs_iterator_h input); 
 imcs_iterator_h imcs_group_count(imcs_iterator_h group_by);
 imcs_iterator_h imcs_group_approxdc(imcs_iterator_h input, imcs_iterator_h group_by);
+imcs_iterator_h imcs_time_bucket(imcs_iterator_h ts, int64 step);
 void imcs_hash_count(imcs_iterator_h result[2], imcs_iterator_h group_by);
 void imcs_hash_approxdc(imcs_iterator_h result[2], imcs_iterator_h input, imcs_iterator_h group_by);
 void imcs_hash_dup_count(imcs_iterator_h result[2], imcs_iterator_h input, imcs_iterator_h group_by, size_t min_occurrences);
@@ -228,6 +251,8 @@ imcs_iterator_h imcs_like(imcs_iterator_h input, char const* pattern);
 imcs_iterator_h imcs_ilike(imcs_iterator_h input, char const* pattern);
 
 imcs_iterator_h imcs_filter_pos(imcs_iterator_h cond);
+/* Fused scan for comparison of stored timeseries with constant, NULL if cond is not such comparison */
+imcs_iterator_h imcs_scan_filter_pos(imcs_iterator_h cond);
 imcs_iterator_h imcs_filter_first_pos(imcs_iterator_h cond, size_t n);
 void imcs_tee(imcs_iterator_h out_iterators[2], imcs_iterator_h in_iterator);
 
@@ -500,6 +500,9 @@ create function columnar_store_count(id cstring, field_type integer, field_size
 
 create function cs_delete_all() returns bigint as 'MODULE_PATHNAME' language C strict;
 create function cs_used_memory() returns bigint as 'MODULE_PATHNAME' language C strict;
+create function cs_resize_cache(size integer) returns integer as 'MODULE_PATHNAME' language C strict;
+create function cs_pin(table_or_series text, priority integer default 2) returns bigint as 'MODULE_PATHNAME' language C strict;
+create function cs_prewarm() returns bigint as 'MODULE_PATHNAME' language C strict;
 
 create function cs_parse_tid(str text, elem_type integer, elem_size integer) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
 create function cs_const_num(val float8, elem_type integer) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
@@ -994,6 +997,23 @@ create function cs_window_dev(timeseries, window_size integer) returns timeserie
 create function cs_window_ema(timeseries, window_size integer) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
 create function cs_window_atr(timeseries, window_size integer) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
 
+create function cs_window_max_time(timeseries, ts timeseries, duration interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_window_min_time(timeseries, ts timeseries, duration interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_window_avg_time(timeseries, ts timeseries, duration interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_window_sum_time(timeseries, ts timeseries, duration interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_window_var_time(timeseries, ts timeseries, duration interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_window_dev_time(timeseries, ts timeseries, duration interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+
+create function cs_grid_max_time(timeseries, ts timeseries, step interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_grid_min_time(timeseries, ts timeseries, step interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_grid_avg_time(timeseries, ts timeseries, step interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_grid_sum_time(timeseries, ts timeseries, step interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_grid_var_time(timeseries, ts timeseries, step interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+create function cs_grid_dev_time(timeseries, ts timeseries, step interval) returns timeseries as 'MODULE_PATHNAME' language C stable strict;
+
+create function cs_group_agg(input timeseries, group_by timeseries, aggregates text[]) returns timeseries[] as 'MODULE_PATHNAME' language C stable strict;
+create function cs_agg(input timeseries, aggregates text[]) returns float8[] as 'MODULE_PATHNAME' language C stable strict;
+
 create function cs_hash_count(group_by timeseries, out count timeseries, out groups timeseries) returns record  as 'MODULE_PATHNAME' language C stable strict;
 create function cs_hash_dup_count(input timeseries, group_by timeseries, out count timeseries, out groups timeseries, min_occurrences integer default 1) returns record  as 'MODULE_PATHNAME' language C stable strict;
 create function cs_hash_max(input timeseries, group_by timeseries, out max timeseries, out groups timeseries) returns record  as 'MODULE_PATHNAME' language C stable strict;
@@ -1060,6 +1080,9 @@ create function cs_from_array(anyarray, elem_size integer default 0) returns tim
 create type cs_profile_item as (command text, counter integer);
 create function cs_profile(reset bool default false) returns setof cs_profile_item as 'MODULE_PATHNAME' language C stable strict;
 
+create type cs_cache_stat as (name text, value bigint);
+create function cs_cache_stats(per_backend bool default false, reset bool default false) returns setof cs_cache_stat as 'MODULE_PATHNAME' language C volatile strict;
+
 create function cs_str2code(str varchar) returns integer as 'MODULE_PATHNAME' language C stable strict;
 create function cs_code2str(id integer) returns varchar as 'MODULE_PATHNAME' language C stable strict;
 create function cs_code2str(str bytea, column_no integer) returns varchar as 'MODULE_PATHNAME','cs_cut_and_code2str' language C stable strict;
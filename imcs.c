@@ -41,11 +41,44 @@ typedef struct imcs_free_page_t
     struct imcs_free_page_t* next;
 } imcs_free_page_t;
 
+#define IMCS_MAX_PINS 64
+#define IMCS_MAX_PIN_PATTERN_LEN 128
+
+#define IMCS_MAX_NUMA_NODES  8
+#define IMCS_NUMA_CHUNK_SIZE (2*1024*1024) /* unit of memory bound to NUMA node */
+#define IMCS_OS_PAGE_SIZE    4096
+
+#define IMCS_MATERIALIZE_BATCH 4 /* number of morsels per thread in batch of parallel materialization */
+
+#define IMCS_MERGE_SCATTER    0 /* phases of merging results of parallel workers by partitions */
+#define IMCS_MERGE_PARTITIONS 1
+
+/* 
+ * Table or timeseries pinned by cs_pin: it is used by cs_prewarm to restore priority of pages 
+ */
+typedef struct imcs_pin_t
+{
+    Oid  db;
+    int  priority;
+    char pattern[IMCS_MAX_PIN_PATTERN_LEN];
+} imcs_pin_t;
+
 typedef struct imcs_state_t
 {
 	LWLockId	lock;	/* protects timeseries search/modification */
     imcs_free_page_t* free_pages; /* list of free B-Tree pages */
     size_t n_used_pages;
+    int n_pins;
+    imcs_pin_t pins[IMCS_MAX_PINS];
+    slock_t workers_mutex;    /* protects counters of parallel workers */
+    int max_parallel_workers; /* limit for total number of threads executing parallel queries of all backends */
+    int n_free_workers;
+    int n_parallel_queries;
+    char* numa_chunk;         /* current chunk of B-Tree pages bound to NUMA node */
+    size_t numa_chunk_used;
+    int n_numa_chunks;
+    int max_numa_chunks;
+    char** numa_chunks;       /* addresses of allocated chunks in ascending order, chunk i is bound to node i % imcs.numa_nodes */
     imcs_disk_cache_t disk_cache;
 } imcs_state_t;
 
@@ -64,7 +97,6 @@ static imcs_lock_t imcs_lock = LOCK_NONE;
 static imcs_mutex_t* imcs_alloc_mutex;
 static MemoryContext imcs_mem_ctx;
 static imcs_tls_t* imcs_tls;
-static imcs_error_handler_t* imcs_error_handlers;
 
 static Datum  imcs_project_result_cache;
 static size_t imcs_project_redundant_calls;
@@ -76,18 +108,32 @@ static bool   imcs_serializable = true;
 static bool   imcs_trace = false;
 
 int imcs_cache_size = 0;
+int imcs_max_cache_size = 0;
 char* imcs_file_path;
+bool  imcs_direct_io;
+bool  imcs_compress_pages;
 
 int imcs_page_size = 4096;
 int imcs_tile_size = 128;
 int imcs_dict_size = IMCS_SMALL_DICTIONARY;
 
 bool imcs_use_rle = false;
+int  imcs_float_sum = IMCS_FLOAT_SUM_FAST;
 static int imcs_output_string_limit = 1024;
 static bool imcs_flush_file;
 static int shmem_size = 1024;
 static int n_timeseries = 10000;
 static int n_threads = 0;
+static int imcs_morsel_size = 64*1024;
+static int imcs_max_parallel_workers = 0;
+static bool imcs_bind_threads = false;
+static int imcs_numa_nodes = 0;
+static const struct config_enum_entry imcs_float_sum_options[] = {
+    {"fast", IMCS_FLOAT_SUM_FAST, false},
+    {"pairwise", IMCS_FLOAT_SUM_PAIRWISE, false},
+    {"kahan", IMCS_FLOAT_SUM_KAHAN, false},
+    {NULL, 0, false}
+};
 static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
 #if PG_VERSION_NUM>=150000
 static shmem_request_hook_type prev_shmem_request_hook = NULL;
@@ -208,6 +254,20 @@ static const char* const imcs_command_mnem[] =
     "window_dev",
     "window_ema",
     "window_atr",
+    "window_max_time",
+    "window_min_time",
+    "window_avg_time",
+    "window_sum_time",
+    "window_var_time",
+    "window_dev_time",
+    "grid_max_time",
+    "grid_min_time",
+    "grid_avg_time",
+    "grid_sum_time",
+    "grid_var_time",
+    "grid_dev_time",
+    "group_agg",
+    "agg",
     "hash_count",
     "hash_dup_count",
     "hash_max",
@@ -329,6 +389,10 @@ PG_FUNCTION_INFO_V1(columnar_store_join_int64);
 PG_FUNCTION_INFO_V1(columnar_store_join_float);
 PG_FUNCTION_INFO_V1(columnar_store_join_double);
 PG_FUNCTION_INFO_V1(cs_used_memory);
+PG_FUNCTION_INFO_V1(cs_resize_cache);
+PG_FUNCTION_INFO_V1(cs_pin);
+PG_FUNCTION_INFO_V1(cs_prewarm);
+PG_FUNCTION_INFO_V1(cs_cache_stats);
 PG_FUNCTION_INFO_V1(cs_delete_all);
 PG_FUNCTION_INFO_V1(cs_parse_tid);
 PG_FUNCTION_INFO_V1(cs_const_num);
@@ -446,6 +510,20 @@ PG_FUNCTION_INFO_V1(cs_window_var);
 PG_FUNCTION_INFO_V1(cs_window_dev);
 PG_FUNCTION_INFO_V1(cs_window_ema);
 PG_FUNCTION_INFO_V1(cs_window_atr);
+PG_FUNCTION_INFO_V1(cs_window_max_time);
+PG_FUNCTION_INFO_V1(cs_window_min_time);
+PG_FUNCTION_INFO_V1(cs_window_avg_time);
+PG_FUNCTION_INFO_V1(cs_window_sum_time);
+PG_FUNCTION_INFO_V1(cs_window_var_time);
+PG_FUNCTION_INFO_V1(cs_window_dev_time);
+PG_FUNCTION_INFO_V1(cs_grid_max_time);
+PG_FUNCTION_INFO_V1(cs_grid_min_time);
+PG_FUNCTION_INFO_V1(cs_grid_avg_time);
+PG_FUNCTION_INFO_V1(cs_grid_sum_time);
+PG_FUNCTION_INFO_V1(cs_grid_var_time);
+PG_FUNCTION_INFO_V1(cs_grid_dev_time);
+PG_FUNCTION_INFO_V1(cs_group_agg);
+PG_FUNCTION_INFO_V1(cs_agg);
 PG_FUNCTION_INFO_V1(cs_hash_count);
 PG_FUNCTION_INFO_V1(cs_hash_dup_count);
 PG_FUNCTION_INFO_V1(cs_hash_max);
@@ -546,6 +624,10 @@ Datum columnar_store_join_int64(PG_FUNCTION_ARGS);
 Datum columnar_store_join_float(PG_FUNCTION_ARGS);
 Datum columnar_store_join_double(PG_FUNCTION_ARGS);
 Datum cs_used_memory(PG_FUNCTION_ARGS);
+Datum cs_resize_cache(PG_FUNCTION_ARGS);
+Datum cs_pin(PG_FUNCTION_ARGS);
+Datum cs_prewarm(PG_FUNCTION_ARGS);
+Datum cs_cache_stats(PG_FUNCTION_ARGS);
 Datum cs_delete_all(PG_FUNCTION_ARGS);
 Datum cs_parse_tid(PG_FUNCTION_ARGS);
 Datum cs_const_num(PG_FUNCTION_ARGS);
@@ -653,6 +735,20 @@ Datum cs_window_var(PG_FUNCTION_ARGS);
 Datum cs_window_dev(PG_FUNCTION_ARGS);
 Datum cs_window_ema(PG_FUNCTION_ARGS);
 Datum cs_window_atr(PG_FUNCTION_ARGS);
+Datum cs_window_max_time(PG_FUNCTION_ARGS);
+Datum cs_window_min_time(PG_FUNCTION_ARGS);
+Datum cs_window_avg_time(PG_FUNCTION_ARGS);
+Datum cs_window_sum_time(PG_FUNCTION_ARGS);
+Datum cs_window_var_time(PG_FUNCTION_ARGS);
+Datum cs_window_dev_time(PG_FUNCTION_ARGS);
+Datum cs_grid_max_time(PG_FUNCTION_ARGS);
+Datum cs_grid_min_time(PG_FUNCTION_ARGS);
+Datum cs_grid_avg_time(PG_FUNCTION_ARGS);
+Datum cs_grid_sum_time(PG_FUNCTION_ARGS);
+Datum cs_grid_var_time(PG_FUNCTION_ARGS);
+Datum cs_grid_dev_time(PG_FUNCTION_ARGS);
+Datum cs_group_agg(PG_FUNCTION_ARGS);
+Datum cs_agg(PG_FUNCTION_ARGS);
 Datum cs_hash_count(PG_FUNCTION_ARGS);
 Datum cs_hash_dup_count(PG_FUNCTION_ARGS);
 Datum cs_hash_max(PG_FUNCTION_ARGS);
@@ -729,6 +825,10 @@ void imcs_ereport(int err_code, char const* err_msg,...)
 
 static void imcs_shmem_startup(void);
 static void imcs_shmem_request(void);
+static void imcs_parallel_wait_all(void);
+static void imcs_parallel_release_all(void);
+static void imcs_parallel_prepare(imcs_iterator_h iterator);
+static bool imcs_pin_match(imcs_pin_t const* pin, imcs_hash_key_t const* key);
 
 static uint32 imcs_hash_fn(const void *key, Size keysize)
 {
@@ -834,9 +934,11 @@ static void imcs_init_dict()
 
 static void imcs_executor_end(QueryDesc *queryDesc)
 {
+    imcs_parallel_wait_all(); /* workers may access timeseries pages which are protected by lock */
     if (CurrentMemoryContext == TopTransactionContext) {
         imcs_project_redundant_calls = 0;
         imcs_project_call_count = 0;
+        imcs_parallel_release_all();
         if (!imcs_serializable && imcs && imcs_lock != LOCK_NONE) {
             if (LWLockHeldByMe(imcs->lock)) {
                 LWLockRelease(imcs->lock);
@@ -860,6 +962,7 @@ static void imcs_trans_callback(XactEvent event, void *arg)
     if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_ABORT) {
         imcs_project_redundant_calls = 0;
         imcs_project_call_count = 0;
+        imcs_parallel_release_all();
         if (imcs && imcs_lock != LOCK_NONE) {
             if (LWLockHeldByMe(imcs->lock)) {
                 if (event == XACT_EVENT_COMMIT && imcs_flush_file) {
@@ -883,6 +986,7 @@ imcs_timeseries_t* imcs_get_timeseries(char const* id, imcs_elem_typeid_t elem_t
     imcs_hash_key_t key;
 	bool found;
     int autoload_attempts = imcs_autoload ? 2 : 0;
+    int i;
 
     if (id == NULL) {
         return NULL;
@@ -967,6 +1071,12 @@ imcs_timeseries_t* imcs_get_timeseries(char const* id, imcs_elem_typeid_t elem_t
             ts->elem_type = elem_type;
             ts->elem_size = elem_size;
             ts->is_timestamp = is_timestamp;
+            ts->priority = IMCS_PRIORITY_NORMAL;
+            for (i = 0; i < imcs->n_pins; i++) { /* new timeseries of pinned table */
+                if (imcs_pin_match(&imcs->pins[i], &entry->key)) {
+                    ts->priority = imcs->pins[i].priority;
+                }
+            }
         }
     } else {
         ts = &entry->value;
@@ -993,18 +1103,26 @@ void* imcs_alloc(size_t size)
 }
 
 /* align returned memory on 16-byte boundary to allow use of SSE vector instructions.
- * This memory should not be deallocated using imcs_free
+ * This memory should be deallocated using imcs_free_aligned: address of allocated chunk is stored before aligned memory 
+ * (there is always room for it because MemoryContextAlloc returns MAXALIGN'ed memory).
  */
 void* imcs_alloc_aligned(size_t size)
 {
+    char* chunk;
     char* ptr;
     imcs_alloc_mutex->lock(imcs_alloc_mutex);
-    ptr = (char*)MemoryContextAlloc(imcs_mem_ctx, size + 16);
-    ptr += -(size_t)ptr & 15;
+    chunk = (char*)MemoryContextAlloc(imcs_mem_ctx, size + 16);
     imcs_alloc_mutex->unlock(imcs_alloc_mutex);
+    ptr = chunk + 16 - ((size_t)chunk & 15);
+    ((char**)ptr)[-1] = chunk;
     return ptr;
 }
 
+void imcs_free_aligned(void* ptr)
+{
+    imcs_free(((char**)ptr)[-1]);
+}
+
 void imcs_free(void* ptr)
 {
     imcs_alloc_mutex->lock(imcs_alloc_mutex);
@@ -1019,11 +1137,36 @@ uint64 imcs_used_memory(void)
     return imcs == NULL ? 0 : imcs->n_used_pages*imcs_page_size;
 }
 
+/*
+ * Allocate page from chunk bound to NUMA node. Chunks are assigned to nodes in round-robin order,
+ * so pages of each timeseries are interleaved between nodes.
+ */
+static void* imcs_numa_alloc_page(void)
+{
+    char* page;
+    if (imcs->numa_chunk == NULL || imcs->numa_chunk_used + imcs_page_size > IMCS_NUMA_CHUNK_SIZE) {
+        char* chunk;
+        if (imcs->n_numa_chunks == imcs->max_numa_chunks
+            || (chunk = (char*)ShmemAlloc(IMCS_NUMA_CHUNK_SIZE + IMCS_OS_PAGE_SIZE)) == NULL)
+        {
+            return ShmemAlloc(imcs_page_size);
+        }
+        chunk += -(size_t)chunk & (IMCS_OS_PAGE_SIZE-1);
+        imcs_bind_memory(chunk, IMCS_NUMA_CHUNK_SIZE, imcs->n_numa_chunks % imcs_numa_nodes);
+        imcs->numa_chunks[imcs->n_numa_chunks++] = chunk;
+        imcs->numa_chunk = chunk;
+        imcs->numa_chunk_used = 0;
+    }
+    page = imcs->numa_chunk + imcs->numa_chunk_used;
+    imcs->numa_chunk_used += imcs_page_size;
+    return page;
+}
+
 imcs_page_t* imcs_new_page(void)
 {
     imcs_free_page_t* pg = imcs->free_pages;
     if (pg == NULL) {
-        pg = (imcs_free_page_t*)ShmemAlloc(imcs_page_size);
+        pg = (imcs_free_page_t*)(imcs_numa_nodes > 1 ? imcs_numa_alloc_page() : ShmemAlloc(imcs_page_size));
         if (pg == NULL) {
             imcs_ereport(ERRCODE_OUT_OF_MEMORY, "not enough shared memory");
         }
@@ -1069,10 +1212,13 @@ imcs_iterator_h imcs_new_iterator(size_t elem_size, size_t context_size)
     iterator->next_pos = 0;
     iterator->first_pos = 0;
     iterator->last_pos = IMCS_INFINITY;
+    iterator->interval = 0;
     iterator->tile_size = iterator->tile_offs = 0;
     iterator->elem_size = elem_size;
     iterator->prepare = NULL;
     iterator->merge = NULL;
+    iterator->scatter = NULL;
+    iterator->merge_partition = NULL;
     iterator->reset = imcs_reset_iterator;
     iterator->iterator_size = iterator_size;
     iterator->context = (char*)(iterator+1) +  tile_size;
@@ -1087,6 +1233,16 @@ imcs_iterator_h imcs_clone_iterator(imcs_iterator_h iterator)
     return clone;
 }
 
+/* Threads are bound to CPUs when thread pool of the backend is created, so it can not be changed after it */
+static bool imcs_check_bind_threads(bool* newval, void** extra, GucSource source)
+{
+    if (imcs_thread_pool != NULL && *newval != imcs_bind_threads) {
+        GUC_check_errdetail("Thread pool of this session is already started.");
+        return false;
+    }
+    return true;
+}
+
 /*
  * Module load callback
  */
@@ -1155,6 +1311,56 @@ void _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("imcs.max_parallel_workers",
+                            "Maximal number of threads concurrently executing parallel queries of all backends (0 - number of CPUs).",
+							NULL,
+							&imcs_max_parallel_workers,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("imcs.bind_threads",
+                             "Bind threads of parallel query execution to CPUs.",
+							 NULL,
+							 &imcs_bind_threads,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 imcs_check_bind_threads,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("imcs.numa_nodes",
+                            "Number of NUMA nodes between which B-Tree pages are distributed (0 - disable NUMA aware allocation).",
+							NULL,
+							&imcs_numa_nodes,
+							0,
+							0,
+							IMCS_MAX_NUMA_NODES,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("imcs.morsel_size",
+                            "Number of timeseries elements in the unit of work (morsel) fetched by parallel worker.",
+							NULL,
+							&imcs_morsel_size,
+							64*1024,
+							1,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomIntVariable("imcs.page_size",
                             "Timeseries B-Tree page size.",
 							NULL,
@@ -1193,6 +1399,19 @@ void _PG_init(void)
 							NULL,
 							NULL);
 
+	DefineCustomIntVariable("imcs.max_cache_size",
+                            "Maximal size to which IMCS disk cache can be extended by cs_resize_cache() (0 - equal to imcs.cache_size).",
+							NULL,
+							&imcs_max_cache_size,
+							0,
+							0,
+							INT_MAX,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
 	DefineCustomBoolVariable("imcs.flush_file",
                              "Flush changes to the file during commit.",
                              NULL,
@@ -1214,6 +1433,28 @@ void _PG_init(void)
 							NULL,
 							NULL,
 							NULL);
+
+	DefineCustomBoolVariable("imcs.direct_io",
+                             "Bypass OS file cache when accessing IMCS disk file (O_DIRECT).",
+                             NULL,
+                             &imcs_direct_io,
+                             false,
+                             PGC_POSTMASTER,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
+	DefineCustomBoolVariable("imcs.compress_pages",
+                             "Compress pages stored in IMCS disk file.",
+                             NULL,
+                             &imcs_compress_pages,
+                             false,
+                             PGC_POSTMASTER,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
 #endif
 
 	DefineCustomIntVariable("imcs.tile_size",
@@ -1288,6 +1529,18 @@ void _PG_init(void)
                              NULL,
                              NULL);
 
+	DefineCustomEnumVariable("imcs.float_sum",
+                             "Method of summation of floating point timeseries used by cs_sum and cs_avg: fast, pairwise or kahan.",
+                             NULL,
+                             &imcs_float_sum,
+                             IMCS_FLOAT_SUM_FAST,
+                             imcs_float_sum_options,
+                             PGC_USERSET,
+                             0,
+                             NULL,
+                             NULL,
+                             NULL);
+
 	DefineCustomIntVariable("imcs.output_string_limit",
                             "Limit for length of timeseries string representation.",
 							NULL,
@@ -1332,7 +1585,6 @@ void _PG_fini(void)
     if (imcs_tls) {
         imcs_tls->destroy(imcs_tls);
     }
-    free(imcs_error_handlers);
     if (imcs_alloc_mutex) {
         imcs_alloc_mutex->destroy(imcs_alloc_mutex);
         imcs_alloc_mutex = NULL;
@@ -1393,6 +1645,21 @@ static void imcs_shmem_startup(void)
 #endif
         imcs->free_pages = NULL;
         imcs->n_used_pages = 0;
+        imcs->n_pins = 0;
+        SpinLockInit(&imcs->workers_mutex);
+        imcs->max_parallel_workers = imcs->n_free_workers = imcs_max_parallel_workers != 0 ? imcs_max_parallel_workers : imcs_get_number_of_cpus();
+        imcs->n_parallel_queries = 0;
+        imcs->numa_chunk = NULL;
+        imcs->numa_chunk_used = 0;
+        imcs->n_numa_chunks = 0;
+        imcs->max_numa_chunks = 0;
+        imcs->numa_chunks = NULL;
+#ifndef IMCS_DISK_SUPPORT
+        if (imcs_numa_nodes > 1) {
+            imcs->max_numa_chunks = (int)((size_t)shmem_size*MB/IMCS_NUMA_CHUNK_SIZE);
+            imcs->numa_chunks = (char**)ShmemAlloc(imcs->max_numa_chunks*sizeof(char*));
+        }
+#endif
         imcs_disk_initialize(&imcs->disk_cache);
 	}
     imcs_disk_open();
@@ -1907,28 +2174,111 @@ static bool imcs_parallel_execution_possible_for_operator(imcs_iterator_h iterat
     return false;
 }
 
-/* Creates thread specific branch of execution tree. Each of N threads will be given 1/N of underlying timeseries. */
-static imcs_iterator_h imcs_clone_tree(imcs_iterator_h iterator, int worker_id, uint64 interval)
+/* Parallel job state: range of positions is split into morsels which are dynamically fetched by workers */
+typedef struct imcs_parallel_job_t {
+    imcs_iterator_h par_iterator;
+    imcs_iterator_h tree;                         /* private copy of operator tree from which workers clone morsels */
+    uint64 morsel_size;
+    int n_morsels;
+    volatile int next_morsel;
+    int n_nodes;                                  /* number of NUMA nodes between which morsels are distributed */
+    int* node_morsels;                            /* morsels grouped by NUMA node of their pages */
+    int node_start[IMCS_MAX_NUMA_NODES+1];        /* start of node's group in node_morsels */
+    volatile int node_next[IMCS_MAX_NUMA_NODES];  /* next morsel of the group */
+    imcs_pos_t start_pos;                 /* position of the first morsel (batches of parallel materialization) */
+    char** buffers;                       /* output of each morsel for parallel materialization, NULL for aggregates */
+    size_t* buffer_sizes;                 /* number of elements in morsel buffers */
+    imcs_iterator_h* prefixes;            /* state of cumulative operator for all elements till the end of each morsel */
+    imcs_pos_t* group_bounds;             /* position of the first group of each morsel for grouped operator */
+    imcs_iterator_h* results;             /* local result of each worker if results are merged by partitions, NULL otherwise */
+    int n_results;
+    int merge_phase;                      /* IMCS_MERGE_SCATTER or IMCS_MERGE_PARTITIONS */
+    int n_workers;
+    int handle;                           /* handle of job submitted to thread pool */
+    bool completed;                       /* submitted job was already waited for by imcs_parallel_wait_all */
+    imcs_error_handler_t* error_handlers; /* error handler for each worker */
+    struct imcs_parallel_job_t* next;     /* list of submitted jobs */
+} imcs_parallel_job_t;
+
+static imcs_parallel_job_t* imcs_submitted_jobs;
+
+/* Creates thread specific branch of execution tree restricted to [from,till] range of positions of underlying timeseries */
+static imcs_iterator_h imcs_clone_tree(imcs_iterator_h iterator, imcs_pos_t from, imcs_pos_t till)
 {
     if (iterator == NULL) {
         return NULL;
     } else {
         imcs_iterator_h clone = imcs_clone_iterator(iterator);
         if (iterator->flags & FLAG_RANDOM_ACCESS) {
-            imcs_subseq_random_access_iterator(clone, worker_id*interval, (worker_id+1)*interval-1);
+            imcs_subseq_random_access_iterator(clone, from, till);
         } else {
             int i;
             for (i = 0; i < 3; i++) {
-                clone->opd[i] = imcs_clone_tree(iterator->opd[i], worker_id, interval);
+                clone->opd[i] = imcs_clone_tree(iterator->opd[i], from, till);
             }
         }
         return clone;
     }
 }
 
+/* Restrict branch created by imcs_clone_tree to another range of positions, reusing memory of its operators */
+static void imcs_reinit_tree(imcs_iterator_h clone, imcs_iterator_h iterator, imcs_pos_t from, imcs_pos_t till)
+{
+    imcs_iterator_h opd[3];
+    memcpy(opd, clone->opd, sizeof opd);
+    memcpy(clone, iterator, iterator->iterator_size);
+    clone->context = (char*)clone + ((char*)iterator->context - (char*)iterator);
+    if (iterator->flags & FLAG_RANDOM_ACCESS) {
+        imcs_subseq_random_access_iterator(clone, from, till);
+    } else {
+        int i;
+        for (i = 0; i < 3; i++) {
+            clone->opd[i] = opd[i];
+            if (opd[i] != NULL) {
+                imcs_reinit_tree(opd[i], iterator->opd[i], from, till);
+            }
+        }
+    }
+}
+
+/* Deallocate branch created by imcs_clone_tree */
+static void imcs_free_tree(imcs_iterator_h clone)
+{
+    if (!(clone->flags & FLAG_RANDOM_ACCESS)) {
+        int i;
+        for (i = 0; i < 3; i++) {
+            if (clone->opd[i] != NULL) {
+                imcs_free_tree(clone->opd[i]);
+            }
+        }
+    }
+    imcs_free_aligned(clone);
+}
+
+/*
+ * Copy execution tree preserving state of its operators. Copy is made by the backend before job is started,
+ * so workers never read operators which can be concurrently advanced by backend (for example operand shared
+ * by several columns of cs_project, one of which is evaluated by the backend while another is evaluated by workers).
+ */
+static imcs_iterator_h imcs_copy_tree(imcs_iterator_h iterator)
+{
+    if (iterator == NULL) {
+        return NULL;
+    } else {
+        imcs_iterator_h copy = imcs_clone_iterator(iterator);
+        if (!(iterator->flags & FLAG_RANDOM_ACCESS)) {
+            int i;
+            for (i = 0; i < 3; i++) {
+                copy->opd[i] = imcs_copy_tree(iterator->opd[i]);
+            }
+        }
+        return copy;
+    }
+}
+
 static void imcs_merge_job_results(void* arg, void* result)
 {
-     imcs_iterator_h par_iterator = (imcs_iterator_h)arg;
+     imcs_iterator_h par_iterator = ((imcs_parallel_job_t*)arg)->par_iterator;
      imcs_iterator_h iterator = (imcs_iterator_h)result;
      Assert(par_iterator->iterator_size == iterator->iterator_size);
      if (par_iterator->opd[1] == NULL) {
@@ -1938,100 +2288,1002 @@ static void imcs_merge_job_results(void* arg, void* result)
      }
 }
 
-static void imcs_parallel_job(int worker_id, int n_workers, void* arg)
+/* Get NUMA node of the page or -1 if page is not allocated from chunk bound to NUMA node */
+static int imcs_get_page_node(imcs_page_t* page)
+{
+    char* addr = (char*)page;
+    int l = 0, r = imcs->n_numa_chunks;
+    while (l < r) {
+        int m = (l + r) >> 1;
+        if (imcs->numa_chunks[m] + IMCS_NUMA_CHUNK_SIZE <= addr) {
+            l = m + 1;
+        } else {
+            r = m;
+        }
+    }
+    return (l < imcs->n_numa_chunks && imcs->numa_chunks[l] <= addr) ? l % imcs_numa_nodes : -1;
+}
+
+static imcs_iterator_h imcs_find_random_access_iterator(imcs_iterator_h iterator)
+{
+    int i;
+    if (iterator == NULL || (iterator->flags & FLAG_RANDOM_ACCESS)) {
+        return iterator;
+    }
+    for (i = 0; i < 3; i++) {
+        imcs_iterator_h leaf = imcs_find_random_access_iterator(iterator->opd[i]);
+        if (leaf != NULL) {
+            return leaf;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Group morsels by NUMA node of pages of the first timeseries accessed by the query,
+ * so that workers can first process morsels local to their node.
+ */
+static void imcs_parallel_assign_nodes(imcs_parallel_job_t* job)
+{
+    imcs_iterator_h leaf = imcs_find_random_access_iterator(job->par_iterator->opd[0]);
+    int* morsel_node;
+    int i, n_morsels = job->n_morsels;
+    if (leaf == NULL || leaf->cs_hdr == NULL) {
+        return;
+    }
+    morsel_node = (int*)imcs_alloc(n_morsels*sizeof(int));
+    memset(job->node_start, 0, sizeof(job->node_start));
+    for (i = 0; i < n_morsels; i++) {
+        imcs_page_t* page = imcs_get_leaf_page(leaf->cs_hdr, leaf->first_pos + (imcs_pos_t)i*job->morsel_size);
+        int node = page != NULL ? imcs_get_page_node(page) : -1;
+        if (node < 0) {
+            node = i % imcs_numa_nodes;
+        }
+        morsel_node[i] = node;
+        job->node_start[node+1] += 1;
+    }
+    for (i = 0; i < imcs_numa_nodes; i++) {
+        job->node_start[i+1] += job->node_start[i];
+        job->node_next[i] = 0;
+    }
+    job->node_morsels = (int*)imcs_alloc(n_morsels*sizeof(int));
+    for (i = 0; i < n_morsels; i++) {
+        job->node_morsels[job->node_start[morsel_node[i]] + job->node_next[morsel_node[i]]++] = i;
+    }
+    for (i = 0; i < imcs_numa_nodes; i++) {
+        job->node_next[i] = 0;
+    }
+    imcs_free(morsel_node);
+    job->n_nodes = imcs_numa_nodes;
+}
+
+/* Get next morsel to be processed by worker running at specified NUMA node. Returns -1 if there are no more morsels. */
+static int imcs_parallel_next_morsel(imcs_parallel_job_t* job, int node)
+{
+    int i;
+    if (job->n_nodes == 1) {
+        int morsel = IMCS_ATOMIC_FETCH_ADD(&job->next_morsel, 1);
+        return morsel < job->n_morsels ? morsel : -1;
+    }
+    for (i = 0; i < job->n_nodes; i++) { /* start with local node and then steal morsels of other nodes */
+        int n = (node + i) % job->n_nodes;
+        int j = job->node_start[n] + IMCS_ATOMIC_FETCH_ADD(&job->node_next[n], 1);
+        if (j < job->node_start[n+1]) {
+            return job->node_morsels[j];
+        }
+    }
+    return -1;
+}
+
+/*
+ * Find position of the first element in [from,till] range which starts new group, i.e. differs from preceding element of the grouping key.
+ * If there is no such element, IMCS_INFINITY is returned.
+ */
+static imcs_pos_t imcs_group_boundary(imcs_iterator_h key, imcs_pos_t from, imcs_pos_t till)
+{
+    imcs_iterator_h iterator = imcs_clone_tree(key, from-1, till);
+    size_t elem_size = key->elem_size;
+    char* prev = (char*)imcs_alloc(elem_size);
+    imcs_pos_t curr = from-1;
+    while (iterator->next(iterator)) {
+        size_t i;
+        for (i = 0; i < iterator->tile_size; i++, curr++) {
+            char* elem = iterator->tile.arr_char + i*elem_size;
+            if (curr == from-1) {
+                memcpy(prev, elem, elem_size);
+            } else if (memcmp(prev, elem, elem_size) != 0) {
+                imcs_free(prev);
+                return curr;
+            }
+        }
+    }
+    imcs_free(prev);
+    return IMCS_INFINITY;
+}
+
+/*
+ * Create branch of execution tree evaluating morsel of parallel materialization.
+ * Morsels of grouped and grid operators are aligned on group (grid) boundaries: each group is evaluated by the morsel where it starts.
+ * Morsel of moving window operator is prepended with "interval-1" preceding elements to fill the window:
+ * results for these elements are skipped. State of cumulative operator is seeded with state of preceding morsels
+ * calculated by imcs_materialize_prefixes. So results of morsels are just concatenated.
+ */
+static imcs_iterator_h imcs_materialize_clone(imcs_parallel_job_t* job, int morsel, size_t* skip)
+{
+    imcs_iterator_h iterator = job->tree;
+    imcs_pos_t from = job->start_pos + (imcs_pos_t)morsel*job->morsel_size;
+    imcs_pos_t till = from + job->morsel_size - 1;
+    *skip = 0;
+    if (iterator->flags & FLAG_GROUPED) {
+        int64 i = from/job->morsel_size;
+        from = job->group_bounds[i];
+        till = job->group_bounds[i+1] - 1;
+    } else if (iterator->flags & FLAG_GRID) {
+        from = (from + iterator->interval - 1) / iterator->interval * iterator->interval;
+        till = (till + iterator->interval) / iterator->interval * iterator->interval - 1;
+    } else if (iterator->flags & FLAG_WINDOW) {
+        *skip = from < iterator->interval - 1 ? from : iterator->interval - 1;
+        from -= *skip;
+    } else if ((iterator->flags & FLAG_CUMULATIVE) && from != 0) {
+        imcs_iterator_h prefix = job->prefixes[from/job->morsel_size - 1];
+        if (prefix->next_pos != 0) { /* seed state with state of preceding morsels */
+            imcs_iterator_h clone = imcs_clone_tree(iterator, from, till);
+            memcpy(clone->context, prefix->context, iterator->iterator_size - ((char*)iterator->context - (char*)iterator));
+            clone->next_pos = prefix->next_pos;
+            return clone;
+        }
+    }
+    return imcs_clone_tree(iterator, from, till);
+}
+
+/* Evaluate morsel of parallel materialization and save its output (except first "skip" elements) in morsel buffer */
+static void imcs_materialize_morsel(imcs_parallel_job_t* job, int morsel)
+{
+    size_t skip;
+    imcs_iterator_h iterator = imcs_materialize_clone(job, morsel, &skip);
+    size_t elem_size = iterator->elem_size;
+    size_t allocated = job->morsel_size < imcs_tile_size ? imcs_tile_size : job->morsel_size;
+    size_t used = 0;
+    char* buf = (char*)imcs_alloc(allocated*elem_size);
+    while (iterator->next(iterator)) {
+        size_t offs = skip < iterator->tile_size ? skip : iterator->tile_size;
+        size_t n = iterator->tile_size - offs;
+        skip -= offs;
+        if (used + n > allocated) { /* operator produces more elements than it gets */
+            char* new_buf = (char*)imcs_alloc((allocated *= 2)*elem_size);
+            memcpy(new_buf, buf, used*elem_size);
+            imcs_free(buf);
+            buf = new_buf;
+        }
+        memcpy(buf + used*elem_size, iterator->tile.arr_char + offs*elem_size, n*elem_size);
+        used += n;
+    }
+    job->buffers[morsel] = buf;
+    job->buffer_sizes[morsel] = used;
+}
+
+/*
+ * Each worker fetches morsels until all of them are processed, so slow worker (for example waiting for disk IO) 
+ * doesn't delay completion of the whole query. Results for morsels are merged locally by worker 
+ * and only final result of each worker is merged under pool lock.
+ * Worker clones execution tree only once and restricts it to the range of each next morsel, 
+ * so no memory is allocated per morsel.
+ */
+static void imcs_parallel_job(int worker_id, int n_workers, void* arg)
+{
+    imcs_parallel_job_t* job = (imcs_parallel_job_t*)arg;
+    imcs_error_handler_t* handler = &job->error_handlers[worker_id];
+    handler->err_code = ERRCODE_SUCCESSFUL_COMPLETION;
+    imcs_tls->set(imcs_tls, handler);
+    if (!setjmp(handler->unwind_buf)) {
+        imcs_iterator_h iterator = job->tree;
+        imcs_iterator_h morsel_iterator = NULL;
+        imcs_iterator_h local_result = NULL;
+        bool accumulative = (iterator->flags & FLAG_ACCUMULATIVE) != 0;
+        int node = job->n_nodes > 1 ? imcs_get_cpu_node(imcs_get_current_cpu(), job->n_nodes) : 0;
+        int morsel;
+        while ((morsel = imcs_parallel_next_morsel(job, node)) >= 0) {
+            imcs_pos_t from = job->start_pos + (imcs_pos_t)morsel*job->morsel_size;
+            imcs_pos_t till = from + job->morsel_size - 1;
+            if (job->buffers != NULL) {
+                imcs_materialize_morsel(job, morsel);
+                continue;
+            }
+            if (morsel_iterator == NULL) {
+                morsel_iterator = imcs_clone_tree(iterator, from, till);
+            } else if (accumulative) { /* keep state of aggregate and restrict only its operands */
+                int i;
+                for (i = 0; i < 3; i++) {
+                    if (morsel_iterator->opd[i] != NULL) {
+                        imcs_reinit_tree(morsel_iterator->opd[i], iterator->opd[i], from, till);
+                    }
+                }
+            } else {
+                imcs_reinit_tree(morsel_iterator, iterator, from, till);
+            }
+            if (morsel_iterator->prepare(morsel_iterator)) {
+                if (accumulative) {
+                    local_result = morsel_iterator;
+                } else if (local_result == NULL) {
+                    local_result = imcs_clone_iterator(morsel_iterator);
+                } else {
+                    local_result->merge(local_result, morsel_iterator);
+                }
+            }
+        }
+        if (morsel_iterator != NULL && !accumulative) {
+            imcs_free_tree(morsel_iterator);
+        }
+        if (local_result != NULL) {
+            if (job->results != NULL) { /* results will be merged later by partitions */
+                job->results[worker_id] = local_result;
+            } else {
+                imcs_thread_pool->merge(imcs_thread_pool, imcs_merge_job_results, job, local_result);
+            }
+        }
+    } else { /* stop other workers */
+        int i;
+        job->next_morsel = job->n_morsels;
+        for (i = 0; i < job->n_nodes; i++) {
+            job->node_next[i] = job->n_morsels;
+        }
+    }
+}
+
+/* 
+ * Grab up to n_workers threads from the limit shared by all backends. 
+ * Each of concurrently executed parallel queries can get no more than its fair share of the limit.
+ */
+static int imcs_acquire_workers(int n_workers)
+{
+    int share;
+    SpinLockAcquire(&imcs->workers_mutex);
+    imcs->n_parallel_queries += 1;
+    share = (imcs->max_parallel_workers + imcs->n_parallel_queries - 1)/imcs->n_parallel_queries;
+    if (n_workers > share) {
+        n_workers = share;
+    }
+    if (n_workers > imcs->n_free_workers) {
+        n_workers = imcs->n_free_workers;
+    }
+    imcs->n_free_workers -= n_workers;
+    SpinLockRelease(&imcs->workers_mutex);
+    return n_workers;
+}
+
+static void imcs_release_workers(int n_workers)
+{
+    SpinLockAcquire(&imcs->workers_mutex);
+    imcs->n_parallel_queries -= 1;
+    imcs->n_free_workers += n_workers;
+    SpinLockRelease(&imcs->workers_mutex);
+}
+
+/*
+ * Split job into morsels and allocate threads for it. Returns false if there are no spare threads.
+ * Memory is allocated before threads are taken from the shared limit, so error raised by allocation can not leak them.
+ */
+static bool imcs_parallel_init_job(imcs_parallel_job_t* job, imcs_iterator_h iterator)
+{
+    uint64 n_elems = iterator->last_pos - iterator->first_pos + 1;
+    uint64 morsel_size = imcs_morsel_size;
+    int max_workers = imcs_thread_pool->get_number_of_threads(imcs_thread_pool);
+    int n_workers;
+    if (max_workers <= 1) {
+        return false;
+    }
+    if (morsel_size*max_workers > n_elems) { /* too few elements: give each worker a single morsel */
+        morsel_size = (n_elems + max_workers - 1)/max_workers;
+    }
+    if ((n_elems + morsel_size - 1)/morsel_size > INT_MAX) {
+        morsel_size = (n_elems + INT_MAX - 1)/INT_MAX;
+    }
+    job->par_iterator = iterator;
+    job->tree = imcs_copy_tree(iterator->opd[0]);
+    job->morsel_size = morsel_size;
+    job->start_pos = 0;
+    job->buffers = NULL;
+    job->results = NULL;
+    if (iterator->opd[0]->scatter != NULL) {
+        job->results = (imcs_iterator_h*)imcs_alloc(max_workers*sizeof(imcs_iterator_h));
+        memset(job->results, 0, max_workers*sizeof(imcs_iterator_h));
+    }
+    job->n_morsels = (int)((n_elems + morsel_size - 1)/morsel_size);
+    job->next_morsel = 0;
+    job->n_nodes = 1;
+    if (imcs_numa_nodes > 1 && imcs->n_numa_chunks != 0) {
+        imcs_parallel_assign_nodes(job);
+    }
+    job->handle = -1;
+    job->completed = false;
+    job->error_handlers = (imcs_error_handler_t*)imcs_alloc(sizeof(imcs_error_handler_t)*max_workers);
+    job->next = NULL;
+
+    n_workers = imcs_acquire_workers(max_workers);
+    if (n_workers <= 1) {
+        imcs_release_workers(n_workers);
+        imcs_free_tree(job->tree);
+        if (job->results != NULL) {
+            imcs_free(job->results);
+        }
+        if (job->n_nodes > 1) {
+            imcs_free(job->node_morsels);
+        }
+        imcs_free(job->error_handlers);
+        return false;
+    }
+    job->n_workers = n_workers;
+    return true;
+}
+
+static bool imcs_parallel_job_failed(imcs_parallel_job_t* job)
+{
+    int i;
+    for (i = 0; i < job->n_workers; i++) {
+        if (job->error_handlers[i].err_code != ERRCODE_SUCCESSFUL_COMPLETION) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void imcs_parallel_merge_job(int task_id, int n_tasks, void* arg)
+{
+    imcs_parallel_job_t* job = (imcs_parallel_job_t*)arg;
+    imcs_error_handler_t* handler = &job->error_handlers[task_id];
+    handler->err_code = ERRCODE_SUCCESSFUL_COMPLETION;
+    imcs_tls->set(imcs_tls, handler);
+    if (!setjmp(handler->unwind_buf)) {
+        imcs_iterator_h iterator = job->par_iterator->opd[0];
+        if (job->merge_phase == IMCS_MERGE_SCATTER) {
+            iterator->scatter(job->results, job->n_results, task_id, job->n_workers);
+        } else {
+            iterator->merge_partition(job->results, job->n_results, task_id, job->n_workers);
+        }
+    }
+}
+
+/*
+ * Merge results of workers in parallel: each result is split into partitions and then each partition of all results
+ * is merged by its own thread. So there is no sequential merge of results under pool lock which 
+ * becomes bottleneck when results are large (for example hash aggregates with large number of groups).
+ */
+static void imcs_parallel_merge_partitions(imcs_parallel_job_t* job)
+{
+    int i, n_results = 0;
+    if (imcs_parallel_job_failed(job)) {
+        return; /* error will be reported by imcs_parallel_complete_job */
+    }
+    for (i = 0; i < job->n_workers; i++) {
+        if (job->results[i] != NULL) {
+            job->results[n_results++] = job->results[i];
+        }
+    }
+    job->n_results = n_results;
+    if (n_results > 1) {
+        job->merge_phase = IMCS_MERGE_SCATTER;
+        imcs_thread_pool->execute(imcs_thread_pool, imcs_parallel_merge_job, job, n_results);
+        if (imcs_parallel_job_failed(job)) {
+            return;
+        }
+        job->merge_phase = IMCS_MERGE_PARTITIONS;
+        imcs_thread_pool->execute(imcs_thread_pool, imcs_parallel_merge_job, job, job->n_workers);
+    }
+    if (n_results != 0) {
+        job->par_iterator->opd[1] = job->results[0];
+    }
+}
+
+/* Release threads of completed job and rethrow error reported by any of its workers */
+static void imcs_parallel_complete_job(imcs_parallel_job_t* job)
+{
+    int i;
+    imcs_release_workers(job->n_workers);
+    for (i = 0; i < job->n_workers; i++) {
+        if (job->error_handlers[i].err_code != ERRCODE_SUCCESSFUL_COMPLETION) {
+            ereport(ERROR, (errcode(job->error_handlers[i].err_code), errmsg("%s", job->error_handlers[i].err_msg)));
+        }
+    }
+}
+
+/*
+ * Wait completion of all submitted jobs: it should be done before release of lock and memory used by them.
+ * Jobs are left in the list, so results of jobs submitted by outer query are still taken by imcs_parallel_execute.
+ */
+static void imcs_parallel_wait_all(void)
+{
+    imcs_parallel_job_t* job;
+    for (job = imcs_submitted_jobs; job != NULL; job = job->next) {
+        if (job->handle >= 0) {
+            imcs_thread_pool->wait(imcs_thread_pool, job->handle);
+            job->handle = -1;
+            job->completed = true;
+        }
+    }
+}
+
+/* Wait completion of all submitted jobs and return their threads: results of these jobs are not needed any more */
+static void imcs_parallel_release_all(void)
+{
+    imcs_parallel_job_t* job;
+    imcs_parallel_wait_all();
+    for (job = imcs_submitted_jobs; job != NULL; job = job->next) {
+        imcs_release_workers(job->n_workers);
+    }
+    imcs_submitted_jobs = NULL;
+}
+
+static bool imcs_parallel_execute(imcs_iterator_h iterator);
+static bool imcs_materialize_next(imcs_iterator_h iterator);
+static void imcs_materialize_start(imcs_iterator_h iterator);
+
+/*
+ * Start execution of all parallel operators of the tree without waiting their completion,
+ * so that independent subtrees (for example columns of cs_project) are evaluated concurrently.
+ * Result of submitted job is taken by imcs_parallel_execute.
+ */
+static void imcs_parallel_prepare(imcs_iterator_h iterator)
+{
+    if (iterator == NULL) {
+        return;
+    }
+    if (iterator->next == imcs_parallel_execute) {
+        imcs_parallel_job_t* job;
+        for (job = imcs_submitted_jobs; job != NULL && job->par_iterator != iterator; job = job->next);
+        if (job == NULL) {
+            job = (imcs_parallel_job_t*)imcs_alloc(sizeof(imcs_parallel_job_t));
+            if (imcs_parallel_init_job(job, iterator)) {
+                job->handle = imcs_thread_pool->submit(imcs_thread_pool, imcs_parallel_job, job, job->n_workers);
+                if (job->handle >= 0) {
+                    job->next = imcs_submitted_jobs;
+                    imcs_submitted_jobs = job;
+                    return;
+                }
+                imcs_release_workers(job->n_workers); /* too much active jobs: execute it later synchronously */
+            }
+        }
+    } else if (iterator->next == imcs_materialize_next) {
+        imcs_materialize_start(iterator);
+    } else {
+        int i;
+        for (i = 0; i < 3; i++) {
+            imcs_parallel_prepare(iterator->opd[i]);
+        }
+    }
+}
+
+static bool imcs_parallel_execute(imcs_iterator_h iterator)
+{
+    bool result;
+    size_t ctx_offs;
+    imcs_iterator_h opd[2];
+    imcs_parallel_job_t* job;
+    imcs_parallel_job_t** jpp;
+
+    for (jpp = &imcs_submitted_jobs; (job = *jpp) != NULL && job->par_iterator != iterator; jpp = &job->next);
+    if (job != NULL) { /* job was started by imcs_parallel_prepare */
+        *jpp = job->next;
+        if (!job->completed) {
+            imcs_thread_pool->wait(imcs_thread_pool, job->handle);
+        }
+        if (job->results != NULL) {
+            imcs_parallel_merge_partitions(job);
+        }
+        imcs_parallel_complete_job(job);
+    } else {
+        imcs_parallel_job_t local_job;
+        if (imcs_parallel_init_job(&local_job, iterator)) {
+            imcs_thread_pool->execute(imcs_thread_pool, imcs_parallel_job, &local_job, local_job.n_workers);
+            if (local_job.results != NULL) {
+                imcs_parallel_merge_partitions(&local_job);
+            }
+            imcs_parallel_complete_job(&local_job);
+        } else { /* no spare threads: query is executed by this backend */
+            imcs_iterator_h clone_iterator = imcs_clone_tree(iterator->opd[0], 0, iterator->last_pos - iterator->first_pos);
+            if (clone_iterator->prepare(clone_iterator)) {
+                iterator->opd[1] = clone_iterator;
+            }
+        }
+    }
+    if (iterator->opd[1] == NULL) {
+        return false;
+    }
+    Assert(iterator->iterator_size == iterator->opd[1]->iterator_size);
+    ctx_offs = (char*)iterator->opd[1]->context - (char*)iterator->opd[1];
+    opd[0] = iterator->opd[0]->opd[0]; /* save original operands */
+    opd[1] = iterator->opd[0]->opd[1];
+    memcpy(iterator, iterator->opd[1], iterator->iterator_size);  /* opd[1] contains thread-specific operands */
+    iterator->opd[0] = opd[0];         /* restore original operands */
+    iterator->opd[1] = opd[1];
+    iterator->context = (char*)iterator + ctx_offs;
+    iterator->flags |= FLAG_PREPARED;
+    result = iterator->next(iterator);
+    iterator->flags &= ~FLAG_PREPARED;
+    return result;
+}
+
+static bool imcs_is_unlimited(imcs_iterator_h iterator)
+{
+    int i;
+    int n_operands = 0;
+    if (iterator->flags & FLAG_CONSTANT) {
+        return true;
+    }
+    for (i = 0; i < 3; i++) {
+        if (iterator->opd[i] != NULL) {
+            n_operands += 1;
+            if (!imcs_is_unlimited(iterator->opd[i])) {
+                return false;
+            }
+        }
+    }
+    return n_operands != 0 && iterator->last_pos == IMCS_INFINITY;
+}
+
+static void imcs_init_thread_pool(void)
+{
+    if (imcs_thread_pool == NULL) {
+        imcs_thread_pool = imcs_create_thread_pool(n_threads, imcs_bind_threads);
+        n_threads = imcs_thread_pool->get_number_of_threads(imcs_thread_pool);
+        imcs_tls = imcs_create_tls();
+    }
+}
+
+imcs_iterator_h imcs_parallel_iterator(imcs_iterator_h iterator)
+{
+    imcs_visitor_context_t ctx;
+    if (imcs_is_unlimited(iterator)) {
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Value can not be caclualted for unbounded sequence");
+    }
+    if (n_threads == 1 || iterator->merge == NULL) {
+        return iterator;
+    }
+    imcs_init_thread_pool();
+    ctx.interval = IMCS_INFINITY;
+    if (imcs_parallel_execution_possible_for_operator(iterator->opd[0], &ctx)
+        && imcs_parallel_execution_possible_for_operator(iterator->opd[1], &ctx)
+        && ctx.interval != IMCS_INFINITY
+        && ctx.interval > imcs_thread_pool->get_number_of_threads(imcs_thread_pool))
+    {
+        imcs_iterator_h par = imcs_clone_iterator(iterator);
+        par->opd[0] = iterator;
+        par->opd[1] = NULL; /* here result of merge will be stored */
+        par->next = imcs_parallel_execute;
+        par->first_pos = 0;
+        par->last_pos = ctx.interval-1;
+        return par;
+    }
+    return iterator;
+}
+
+/* State of imcs_parallel_for: tasks are dynamically fetched by workers */
+typedef struct {
+    void (*task)(int task_id, int n_tasks, void* arg);
+    void* arg;
+    int n_tasks;
+    volatile int next_task;
+    imcs_error_handler_t* error_handlers;
+} imcs_parallel_for_t;
+
+static void imcs_parallel_for_job(int worker_id, int n_workers, void* arg)
+{
+    imcs_parallel_for_t* pf = (imcs_parallel_for_t*)arg;
+    imcs_error_handler_t* handler = &pf->error_handlers[worker_id];
+    handler->err_code = ERRCODE_SUCCESSFUL_COMPLETION;
+    imcs_tls->set(imcs_tls, handler);
+    if (!setjmp(handler->unwind_buf)) {
+        int task_id;
+        while ((task_id = IMCS_ATOMIC_FETCH_ADD(&pf->next_task, 1)) < pf->n_tasks) {
+            pf->task(task_id, pf->n_tasks, pf->arg);
+        }
+    } else { /* stop other workers */
+        pf->next_task = pf->n_tasks;
+    }
+}
+
+/* Number of threads which can be used for parallel processing of array with specified number of elements */
+int imcs_parallel_workers(uint64 n_elems)
+{
+    uint64 n_morsels = n_elems/imcs_morsel_size;
+    int n_workers;
+    if (n_threads == 1 || n_morsels < 2) {
+        return 1;
+    }
+    if (imcs_tls != NULL && imcs_tls->get(imcs_tls) != NULL) { /* called by worker thread: nested parallelism is not supported */
+        return 1;
+    }
+    imcs_init_thread_pool();
+    n_workers = imcs_thread_pool->get_number_of_threads(imcs_thread_pool);
+    return n_morsels < (uint64)n_workers ? (int)n_morsels : n_workers;
+}
+
+/*
+ * Execute n_tasks tasks using threads of the pool. It is used by operators which are not pipelined (for example sort),
+ * so them can not be parallelized by splitting timeseries into morsels.
+ * If there are no spare threads, tasks are executed by this backend.
+ */
+void imcs_parallel_for(void (*task)(int task_id, int n_tasks, void* arg), int n_tasks, void* arg)
+{
+    imcs_parallel_for_t pf;
+    int i, n_workers = 0;
+    if (n_tasks > 1 && imcs_thread_pool != NULL) {
+        n_workers = imcs_thread_pool->get_number_of_threads(imcs_thread_pool);
+        if (n_workers > n_tasks) {
+            n_workers = n_tasks;
+        }
+        pf.error_handlers = (imcs_error_handler_t*)imcs_alloc(sizeof(imcs_error_handler_t)*n_workers); /* before threads are taken */
+        n_workers = imcs_acquire_workers(n_workers);
+        if (n_workers <= 1) {
+            imcs_release_workers(n_workers);
+            imcs_free(pf.error_handlers);
+            n_workers = 0;
+        }
+    }
+    if (n_workers == 0) {
+        for (i = 0; i < n_tasks; i++) {
+            task(i, n_tasks, arg);
+        }
+        return;
+    }
+    pf.task = task;
+    pf.arg = arg;
+    pf.n_tasks = n_tasks;
+    pf.next_task = 0;
+    imcs_thread_pool->execute(imcs_thread_pool, imcs_parallel_for_job, &pf, n_workers);
+    imcs_release_workers(n_workers);
+    for (i = 0; i < n_workers; i++) {
+        if (pf.error_handlers[i].err_code != ERRCODE_SUCCESSFUL_COMPLETION) {
+            ereport(ERROR, (errcode(pf.error_handlers[i].err_code), errmsg("%s", pf.error_handlers[i].err_msg)));
+        }
+    }
+    imcs_free(pf.error_handlers);
+}
+
+/*
+ * Parallel materialization of element-wise operators which have no merge function (arithmetic, filters, casts,...).
+ * Range of positions is split into morsels which are evaluated by workers into separate buffers.
+ * Buffers are returned to the consumer in position order, so result is the same as of sequential execution.
+ * Morsels are evaluated in batches: next batch is evaluated by workers while current one is consumed,
+ * so memory is needed only for two batches rather than for the whole result.
+ */
+typedef struct imcs_materialize_context_t {
+    uint64 morsel_size;
+    int64 n_morsels;             /* total number of morsels */
+    int batch_morsels;           /* maximal number of morsels in batch */
+    int64 batch_start;           /* first morsel of current batch */
+    bool started;                /* evaluation of the first batch is started */
+    imcs_parallel_job_t* curr;   /* batch returned to the consumer */
+    imcs_parallel_job_t* ahead;  /* next batch evaluated while current batch is consumed */
+    int morsel;                  /* current morsel of current batch */
+    size_t offs;                 /* number of already returned elements of current morsel */
+    imcs_iterator_h* prefixes;   /* state of cumulative operator till the end of each morsel */
+    imcs_pos_t* group_bounds;    /* position of the first group of each morsel for grouped operator */
+    imcs_iterator_h tree;        /* private copy of materialized operator shared by all batches */
+} imcs_materialize_context_t;
+
+/* Calculate state of cumulative operator for each morsel */
+static void imcs_materialize_morsel_total(int morsel, int n_morsels, void* arg)
+{
+    imcs_iterator_h iterator = (imcs_iterator_h)arg;
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    imcs_pos_t from = (imcs_pos_t)morsel*ctx->morsel_size;
+    imcs_iterator_h clone = imcs_clone_tree(iterator->opd[0], from, from + ctx->morsel_size - 1);
+    while (clone->next(clone)) {} /* results are not needed: only final state */
+    ctx->prefixes[morsel] = clone;
+}
+
+/*
+ * First pass of parallel prefix scan for cumulative operator: states of all morsels are calculated in parallel
+ * and then combined sequentially, so that state of each morsel includes all preceding elements.
+ * At second pass each morsel is evaluated with state seeded by state of preceding morsel (see imcs_materialize_clone).
+ */
+static void imcs_materialize_prefixes(imcs_iterator_h iterator)
+{
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    imcs_iterator_h* prefixes;
+    int64 i;
+    prefixes = ctx->prefixes = (imcs_iterator_h*)imcs_alloc(ctx->n_morsels*sizeof(imcs_iterator_h));
+    imcs_parallel_for(imcs_materialize_morsel_total, (int)ctx->n_morsels, iterator);
+    for (i = 1; i < ctx->n_morsels; i++) {
+        if (prefixes[i]->next_pos == 0) { /* empty morsel */
+            prefixes[i] = prefixes[i-1];
+        } else if (prefixes[i-1]->next_pos != 0) {
+            prefixes[i]->merge(prefixes[i], prefixes[i-1]);
+            prefixes[i]->next_pos += prefixes[i-1]->next_pos;
+        }
+    }
+}
+
+/* Find start of new group within morsel following the specified one */
+static void imcs_materialize_morsel_group(int morsel, int n_morsels, void* arg)
+{
+    imcs_iterator_h iterator = (imcs_iterator_h)arg;
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    imcs_iterator_h key = iterator->opd[0]->opd[1] != NULL ? iterator->opd[0]->opd[1] : iterator->opd[0]->opd[0];
+    imcs_pos_t from = (imcs_pos_t)(morsel + 1)*ctx->morsel_size;
+    ctx->group_bounds[morsel + 1] = imcs_group_boundary(key, from, from + ctx->morsel_size - 1);
+}
+
+/*
+ * Align morsels of grouped operator on group boundaries: each group is evaluated by the morsel where it starts.
+ * Boundary of each morsel is located once and shared by adjacent morsels. Search for boundary is not continued
+ * beyond the end of the morsel: if the group doesn't end there, then the next morsel has the same boundary.
+ */
+static void imcs_materialize_group_bounds(imcs_iterator_h iterator)
+{
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    imcs_pos_t* bounds;
+    int64 i;
+    bounds = ctx->group_bounds = (imcs_pos_t*)imcs_alloc((ctx->n_morsels + 1)*sizeof(imcs_pos_t));
+    bounds[0] = 0;
+    bounds[ctx->n_morsels] = ctx->n_morsels*ctx->morsel_size;
+    imcs_parallel_for(imcs_materialize_morsel_group, (int)ctx->n_morsels - 1, iterator);
+    for (i = ctx->n_morsels - 1; i > 0; i--) {
+        if (bounds[i] == IMCS_INFINITY) {
+            bounds[i] = bounds[i+1];
+        }
+    }
+}
+
+/*
+ * Create job for batch of morsels starting from first_morsel and submit it to the thread pool.
+ * Batch holding threads is included in the list of submitted jobs even if it was not submitted,
+ * so that its threads are returned at the end of query if the batch is never consumed.
+ */
+static imcs_parallel_job_t* imcs_materialize_start_batch(imcs_iterator_h iterator, int64 first_morsel)
+{
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    imcs_parallel_job_t* job = (imcs_parallel_job_t*)imcs_alloc(sizeof(imcs_parallel_job_t));
+    int n_morsels = first_morsel + ctx->batch_morsels > ctx->n_morsels ? (int)(ctx->n_morsels - first_morsel) : ctx->batch_morsels;
+    int n_workers = imcs_thread_pool->get_number_of_threads(imcs_thread_pool);
+    job->par_iterator = iterator;
+    job->tree = ctx->tree;
+    job->morsel_size = ctx->morsel_size;
+    job->start_pos = first_morsel*ctx->morsel_size;
+    job->n_morsels = n_morsels;
+    job->next_morsel = 0;
+    job->n_nodes = 1;
+    job->buffers = (char**)imcs_alloc(n_morsels*sizeof(char*));
+    job->buffer_sizes = (size_t*)imcs_alloc(n_morsels*sizeof(size_t));
+    job->prefixes = ctx->prefixes;
+    job->group_bounds = ctx->group_bounds;
+    memset(job->buffers, 0, n_morsels*sizeof(char*));
+    job->results = NULL;
+    job->handle = -1;
+    job->completed = false;
+    job->next = NULL;
+    if (n_workers > n_morsels) {
+        n_workers = n_morsels;
+    }
+    job->error_handlers = (imcs_error_handler_t*)imcs_alloc(sizeof(imcs_error_handler_t)*n_workers); /* before threads are taken */
+    job->n_workers = imcs_acquire_workers(n_workers);
+    if (job->n_workers <= 1) { /* no spare threads: batch will be evaluated by this backend */
+        imcs_release_workers(job->n_workers);
+        imcs_free(job->error_handlers);
+        job->n_workers = 0;
+        job->error_handlers = NULL;
+        return job;
+    }
+    job->handle = imcs_thread_pool->submit(imcs_thread_pool, imcs_parallel_job, job, job->n_workers);
+    job->next = imcs_submitted_jobs;
+    imcs_submitted_jobs = job;
+    return job;
+}
+
+static void imcs_materialize_unlink_batch(imcs_parallel_job_t* job)
+{
+    imcs_parallel_job_t** jpp;
+    for (jpp = &imcs_submitted_jobs; *jpp != job; jpp = &(*jpp)->next);
+    *jpp = job->next;
+}
+
+/* Wait until all morsels of the batch are evaluated */
+static void imcs_materialize_complete_batch(imcs_parallel_job_t* job)
+{
+    if (job->n_workers != 0) {
+        imcs_materialize_unlink_batch(job);
+        if (job->handle >= 0) {
+            imcs_thread_pool->wait(imcs_thread_pool, job->handle);
+        } else if (!job->completed) { /* too much active jobs to submit this batch in advance */
+            imcs_thread_pool->execute(imcs_thread_pool, imcs_parallel_job, job, job->n_workers);
+        }
+        imcs_parallel_complete_job(job);
+    } else {
+        int i;
+        for (i = 0; i < job->n_morsels; i++) {
+            imcs_materialize_morsel(job, i);
+        }
+    }
+}
+
+static void imcs_materialize_free_batch(imcs_parallel_job_t* job)
+{
+    int i;
+    for (i = 0; i < job->n_morsels; i++) {
+        if (job->buffers[i] != NULL) {
+            imcs_free(job->buffers[i]);
+        }
+    }
+    imcs_free(job->buffers);
+    imcs_free(job->buffer_sizes);
+    if (job->error_handlers != NULL) {
+        imcs_free(job->error_handlers);
+    }
+    imcs_free(job);
+}
+
+/* Drop batch which is not needed any more without evaluation of morsels which are not yet started */
+static void imcs_materialize_cancel_batch(imcs_parallel_job_t* job)
+{
+    if (job->n_workers != 0) {
+        imcs_materialize_unlink_batch(job);
+        if (job->handle >= 0) {
+            job->next_morsel = job->n_morsels;
+            imcs_thread_pool->wait(imcs_thread_pool, job->handle);
+        }
+        imcs_release_workers(job->n_workers);
+    }
+    imcs_materialize_free_batch(job);
+}
+
+static void imcs_materialize_start(imcs_iterator_h iterator)
 {
-    imcs_error_handlers[worker_id].err_code = ERRCODE_SUCCESSFUL_COMPLETION;
-    imcs_tls->set(imcs_tls, &imcs_error_handlers[worker_id]);
-    if (!setjmp(imcs_error_handlers[worker_id].unwind_buf)) {
-        imcs_iterator_h par_iterator = (imcs_iterator_h)arg;
-        imcs_iterator_h iterator = par_iterator->opd[0];
-        uint64 interval = (par_iterator->last_pos - par_iterator->first_pos + n_workers)/n_workers; /* round up */
-        imcs_iterator_h clone_iterator = imcs_clone_tree(iterator, worker_id, interval);
-        if (clone_iterator->prepare(clone_iterator)) {
-            imcs_thread_pool->merge(imcs_thread_pool, imcs_merge_job_results, clone_iterator);
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    if (!ctx->started) {
+        ctx->started = true;
+        ctx->batch_start = 0;
+        if (ctx->tree == NULL) {
+            ctx->tree = imcs_copy_tree(iterator->opd[0]);
+        }
+        if ((iterator->opd[0]->flags & FLAG_CUMULATIVE) && ctx->prefixes == NULL) {
+            imcs_materialize_prefixes(iterator);
+        }
+        if ((iterator->opd[0]->flags & FLAG_GROUPED) && ctx->group_bounds == NULL) {
+            imcs_materialize_group_bounds(iterator);
         }
+        ctx->ahead = imcs_materialize_start_batch(iterator, 0);
     }
 }
 
-static bool imcs_parallel_execute(imcs_iterator_h iterator)
+static bool imcs_materialize_next(imcs_iterator_h iterator)
 {
-    bool result;
-    size_t ctx_offs;
-    imcs_iterator_h opd[2];
-    int i;
-    imcs_thread_pool->execute(imcs_thread_pool, imcs_parallel_job, iterator);
-    if (iterator->opd[1] == NULL) {
-        return false;
-    }
-    if (imcs_error_handlers != NULL) {
-        for (i = 0; i < n_threads;  i++) {
-            if (imcs_error_handlers[i].err_code != ERRCODE_SUCCESSFUL_COMPLETION) {
-                ereport(ERROR, (errcode(imcs_error_handlers[i].err_code), errmsg("%s", imcs_error_handlers[i].err_msg)));
-            }
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    imcs_parallel_job_t* job;
+    size_t elem_size = iterator->elem_size;
+    size_t available;
+    imcs_materialize_start(iterator);
+    while ((job = ctx->curr) == NULL || ctx->morsel == job->n_morsels || ctx->offs == job->buffer_sizes[ctx->morsel]) {
+        if (job != NULL && ctx->morsel < job->n_morsels) {
+            ctx->morsel += 1;
+            ctx->offs = 0;
+            continue;
+        }
+        if (ctx->ahead == NULL) {
+            return false;
+        }
+        if (job != NULL) {
+            ctx->batch_start += job->n_morsels;
+            imcs_materialize_free_batch(job);
+        }
+        job = ctx->curr = ctx->ahead;
+        ctx->ahead = NULL;
+        ctx->morsel = 0;
+        ctx->offs = 0;
+        imcs_materialize_complete_batch(job);
+        if (ctx->batch_start + job->n_morsels < ctx->n_morsels) {
+            ctx->ahead = imcs_materialize_start_batch(iterator, ctx->batch_start + job->n_morsels);
         }
     }
-    Assert(iterator->iterator_size == iterator->opd[1]->iterator_size);
-    ctx_offs = (char*)iterator->opd[1]->context - (char*)iterator->opd[1];
-    opd[0] = iterator->opd[0]->opd[0]; /* save original operands */
-    opd[1] = iterator->opd[0]->opd[1];
-    memcpy(iterator, iterator->opd[1], iterator->iterator_size);  /* opd[1] contains thread-specific operands */
-    iterator->opd[0] = opd[0];         /* restore original operands */
-    iterator->opd[1] = opd[1];
-    iterator->context = (char*)iterator + ctx_offs;
-    iterator->flags |= FLAG_PREPARED;
-    result = iterator->next(iterator);
-    iterator->flags &= ~FLAG_PREPARED;
-    return result;
+    available = job->buffer_sizes[ctx->morsel] - ctx->offs;
+    if (available > imcs_tile_size) {
+        available = imcs_tile_size;
+    }
+    memcpy(iterator->tile.arr_char, job->buffers[ctx->morsel] + ctx->offs*elem_size, available*elem_size);
+    ctx->offs += available;
+    iterator->tile_size = (uint16)available;
+    iterator->tile_offs = 0;
+    iterator->next_pos += available;
+    return true;
 }
 
-static bool imcs_is_unlimited(imcs_iterator_h iterator)
+static void imcs_materialize_reset(imcs_iterator_h iterator)
 {
-    int i;
-    int n_operands = 0;
-    if (iterator->flags & FLAG_CONSTANT) {
-        return true;
+    imcs_materialize_context_t* ctx = (imcs_materialize_context_t*)iterator->context;
+    iterator->tile_size = iterator->tile_offs = 0;
+    iterator->next_pos = iterator->first_pos;
+    ctx->morsel = 0;
+    ctx->offs = 0;
+    if (ctx->curr != NULL && ctx->n_morsels <= ctx->batch_morsels) { /* the whole result is kept in memory */
+        return;
     }
-    for (i = 0; i < 3; i++) {
-        if (iterator->opd[i] != NULL) {
-            n_operands += 1;
-            if (!imcs_is_unlimited(iterator->opd[i])) {
+    if (ctx->ahead != NULL) {
+        imcs_materialize_cancel_batch(ctx->ahead);
+        ctx->ahead = NULL;
+    }
+    if (ctx->curr != NULL) {
+        imcs_materialize_free_batch(ctx->curr);
+        ctx->curr = NULL;
+    }
+    ctx->started = false;
+}
+
+/*
+ * Check if operator can be evaluated by parallel materialization: either it is context-free 
+ * or it is grouped, grid, window or cumulative operator with context-free operands 
+ * (grouping key also has to be bounded to locate group boundaries)
+ */
+static bool imcs_parallel_materialization_possible(imcs_iterator_h iterator, imcs_visitor_context_t* ctx)
+{
+    if (iterator->flags & (FLAG_GROUPED|FLAG_GRID|FLAG_WINDOW|FLAG_CUMULATIVE)) {
+        int i;
+        if ((iterator->flags & (FLAG_GRID|FLAG_WINDOW)) && iterator->interval == 0) {
+            return false;
+        }
+        if (iterator->flags & FLAG_GROUPED) {
+            imcs_iterator_h key = iterator->opd[1] != NULL ? iterator->opd[1] : iterator->opd[0];
+            imcs_visitor_context_t key_ctx;
+            key_ctx.interval = IMCS_INFINITY;
+            if (!imcs_parallel_execution_possible_for_operator(key, &key_ctx) || key_ctx.interval == IMCS_INFINITY) {
+                return false;
+            }
+        }
+        for (i = 0; i < 3; i++) {
+            if (!imcs_parallel_execution_possible_for_operator(iterator->opd[i], ctx)) {
                 return false;
             }
         }
+        return true;
     }
-    return n_operands != 0 && iterator->last_pos == IMCS_INFINITY;
+    return imcs_parallel_execution_possible_for_operator(iterator, ctx);
 }
 
-imcs_iterator_h imcs_parallel_iterator(imcs_iterator_h iterator)
+imcs_iterator_h imcs_parallel_materialize(imcs_iterator_h iterator)
 {
     imcs_visitor_context_t ctx;
-    if (imcs_is_unlimited(iterator)) {
-        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Value can not be caclualted for unbounded sequence");
-    }
-    if (n_threads == 1 || iterator->merge == NULL) {
+    imcs_iterator_h result;
+    imcs_materialize_context_t* mctx;
+    uint64 morsel_size = imcs_morsel_size;
+    if (n_threads == 1 || (iterator->flags & (FLAG_RANDOM_ACCESS|FLAG_CONSTANT))) { /* nothing to calculate */
         return iterator;
     }
-    if (imcs_thread_pool == NULL) {
-        imcs_thread_pool = imcs_create_thread_pool(n_threads);
-        n_threads = imcs_thread_pool->get_number_of_threads(imcs_thread_pool);
-        imcs_error_handlers = (imcs_error_handler_t*)malloc(sizeof(imcs_error_handler_t)*n_threads);
-        imcs_tls = imcs_create_tls();
+    if (imcs_tls != NULL && imcs_tls->get(imcs_tls) != NULL) { /* called by worker thread: nested parallelism is not supported */
+        return iterator;
     }
+    imcs_init_thread_pool();
     ctx.interval = IMCS_INFINITY;
-    if (imcs_parallel_execution_possible_for_operator(iterator->opd[0], &ctx)
-        && imcs_parallel_execution_possible_for_operator(iterator->opd[1], &ctx)
-        && ctx.interval != IMCS_INFINITY
-        && ctx.interval > imcs_thread_pool->get_number_of_threads(imcs_thread_pool))
+    if (!imcs_parallel_materialization_possible(iterator, &ctx)
+        || ctx.interval == IMCS_INFINITY
+        || ctx.interval <= n_threads)
     {
-        imcs_iterator_h par = imcs_clone_iterator(iterator);
-        par->opd[0] = iterator;
-        par->opd[1] = NULL; /* here result of merge will be stored */
-        par->next = imcs_parallel_execute;
-        par->first_pos = 0;
-        par->last_pos = ctx.interval-1;
-        return par;
+        return iterator;
     }
-    return iterator;
+    if (morsel_size*n_threads > ctx.interval) {
+        morsel_size = (ctx.interval + n_threads - 1)/n_threads;
+    }
+    if ((iterator->flags & FLAG_WINDOW) && iterator->interval >= morsel_size) { /* filling the window costs more than evaluation of morsel */
+        return iterator;
+    }
+    result = imcs_new_iterator(iterator->elem_size, sizeof(imcs_materialize_context_t));
+    mctx = (imcs_materialize_context_t*)result->context;
+    result->elem_type = iterator->elem_type;
+    result->flags = iterator->flags & FLAG_TRANSLATED;
+    result->opd[0] = iterator;
+    result->first_pos = result->next_pos = 0;
+    result->last_pos = (iterator->flags & (FLAG_GROUPED|FLAG_GRID)) ? iterator->last_pos : ctx.interval-1; /* size of grouped result is not known */
+    result->next = imcs_materialize_next;
+    result->reset = imcs_materialize_reset;
+    mctx->morsel_size = morsel_size;
+    mctx->n_morsels = (ctx.interval + morsel_size - 1)/morsel_size;
+    mctx->batch_morsels = n_threads*IMCS_MATERIALIZE_BATCH;
+    mctx->batch_start = 0;
+    mctx->started = false;
+    mctx->curr = mctx->ahead = NULL;
+    mctx->morsel = 0;
+    mctx->offs = 0;
+    mctx->prefixes = NULL;
+    mctx->group_bounds = NULL;
+    mctx->tree = NULL;
+    return result;
 }
 
 static int64 imcs_date2timestamp(int64 date)
@@ -2667,6 +3919,8 @@ Datum cs_output_function(PG_FUNCTION_ARGS)
         input = imcs_limit(input, 0, 0); /* print only first element of timeseries of repeated concstant value, because this timeseries has infinite length */
         truncated = true;
     }
+    input = imcs_parallel_materialize(input);
+    imcs_parallel_prepare(input);
 
     switch (input->elem_type) {
       case TID_int8:
@@ -3240,11 +4494,30 @@ Datum cs_filter(PG_FUNCTION_ARGS)
     imcs_iterator_h cond = (imcs_iterator_h)PG_GETARG_POINTER(0);
     imcs_iterator_h input = (imcs_iterator_h)PG_GETARG_POINTER(1);
     imcs_iterator_h result;
+    if (input->cs_hdr != NULL && input->next_pos == input->first_pos) {
+        /* Comparison of stored timeseries with constant: fetch from input only elements at selected positions */
+        imcs_iterator_h positions = imcs_scan_filter_pos(cond);
+        if (positions != NULL && positions->opd[0]->last_pos - positions->opd[0]->first_pos <= input->last_pos - input->first_pos) {
+            IMCS_TRACE(filter);
+            result = imcs_map(input, positions);
+            PG_RETURN_POINTER(result);
+        }
+    }
     IMCS_APPLY_CHAR(filter, input->elem_type, (cond, input));
     PG_RETURN_POINTER(result);
 }
 
-IMCS_UNARY_ANY_OP(filter_pos)
+Datum cs_filter_pos(PG_FUNCTION_ARGS)
+{
+    imcs_iterator_h input = (imcs_iterator_h)PG_GETARG_POINTER(0);
+    imcs_iterator_h result = imcs_scan_filter_pos(input);
+    if (result == NULL) {
+        result = imcs_filter_pos(input);
+    }
+    IMCS_TRACE(filter_pos);
+    PG_RETURN_POINTER(result);
+}
+
 IMCS_UNARY_CHAR_OP(unique)
 IMCS_UNARY_CHAR_OP(reverse)
 IMCS_UNARY_OP(diff)
@@ -3371,6 +4644,66 @@ IMCS_INTERVAL_OP(window_dev)
 IMCS_INTERVAL_OP(window_ema)
 IMCS_INTERVAL_OP(window_atr)
 
+/* Window duration or grid step in units of timestamps: days for date, microseconds for time and timestamp */
+static int64 imcs_time_duration(Interval* span, imcs_elem_typeid_t ts_type, char const* func)
+{
+    int64 usecs = span->time + ((int64)span->month*DAYS_PER_MONTH + span->day)*USECS_PER_DAY;
+    switch (ts_type) {
+      case TID_date:
+        if (usecs % USECS_PER_DAY != 0) {
+            imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Interval of %s should be whole number of days for timeseries of date type", func);
+        }
+        return usecs / USECS_PER_DAY;
+      case TID_time:
+      case TID_timestamp:
+        return usecs;
+      default:
+        imcs_ereport(ERRCODE_DATATYPE_MISMATCH, "Second argument of %s should be timeseries of date, time or timestamp type", func);
+    }
+    return 0;
+}
+
+#define IMCS_TIME_WINDOW_OP(func)                                       \
+Datum cs_##func##_time(PG_FUNCTION_ARGS)                                \
+{                                                                       \
+    imcs_iterator_h input = (imcs_iterator_h)PG_GETARG_POINTER(0);      \
+    imcs_iterator_h ts = (imcs_iterator_h)PG_GETARG_POINTER(1);         \
+    int64 duration = imcs_time_duration(PG_GETARG_INTERVAL_P(2), ts->elem_type, "cs_" #func "_time"); \
+    imcs_iterator_h result;                                             \
+    IMCS_TRACE(func##_time);                                            \
+    ts = imcs_cast(ts, TID_int64, 0);                                   \
+    IMCS_APPLY(func##_time, input->elem_type, (input, ts, duration));   \
+    PG_RETURN_POINTER(result);                                          \
+}
+
+/* Grid aggregates over time are grouped aggregates with time bucket number as grouping key */
+#define IMCS_TIME_GRID_OP(func)                                         \
+Datum cs_grid_##func##_time(PG_FUNCTION_ARGS)                           \
+{                                                                       \
+    imcs_iterator_h input = (imcs_iterator_h)PG_GETARG_POINTER(0);      \
+    imcs_iterator_h ts = (imcs_iterator_h)PG_GETARG_POINTER(1);         \
+    int64 step = imcs_time_duration(PG_GETARG_INTERVAL_P(2), ts->elem_type, "cs_grid_" #func "_time"); \
+    imcs_iterator_h result;                                             \
+    IMCS_TRACE(grid_##func##_time);                                     \
+    ts = imcs_time_bucket(imcs_cast(ts, TID_int64, 0), step);           \
+    IMCS_APPLY(group_##func, input->elem_type, (input, ts));            \
+    PG_RETURN_POINTER(result);                                          \
+}
+
+IMCS_TIME_WINDOW_OP(window_max)
+IMCS_TIME_WINDOW_OP(window_min)
+IMCS_TIME_WINDOW_OP(window_sum)
+IMCS_TIME_WINDOW_OP(window_avg)
+IMCS_TIME_WINDOW_OP(window_var)
+IMCS_TIME_WINDOW_OP(window_dev)
+
+IMCS_TIME_GRID_OP(max)
+IMCS_TIME_GRID_OP(min)
+IMCS_TIME_GRID_OP(sum)
+IMCS_TIME_GRID_OP(avg)
+IMCS_TIME_GRID_OP(var)
+IMCS_TIME_GRID_OP(dev)
+
 
 Datum cs_hash_count(PG_FUNCTION_ARGS)
 {
@@ -3415,6 +4748,119 @@ IMCS_HASH_AGG(any)
 IMCS_HASH_AGG(all)
 IMCS_HASH_AGG(avg)
 
+/* Parse array of aggregate names passed to cs_group_agg and cs_agg */
+static int imcs_parse_multi_agg(ArrayType* names, imcs_multi_agg_t** aggs)
+{
+    static char const* const agg_names[] = {"first", "last", "min", "max", "sum", "avg", "var", "dev", "count"};
+    Datum* elems;
+    bool* nulls;
+    int i, j, n_aggs;
+    deconstruct_array(names, TEXTOID, -1, false, 'i', &elems, &nulls, &n_aggs);
+    if (n_aggs == 0) {
+        imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "List of aggregates should not be empty");
+    }
+    *aggs = (imcs_multi_agg_t*)palloc(n_aggs*sizeof(imcs_multi_agg_t));
+    for (i = 0; i < n_aggs; i++) {
+        char* name;
+        if (nulls[i]) {
+            imcs_ereport(ERRCODE_NULL_VALUE_NOT_ALLOWED, "Aggregate name should not be NULL");
+        }
+        name = text_to_cstring(DatumGetTextP(elems[i]));
+        for (j = 0; j < (int)lengthof(agg_names); j++) {
+            if (pg_strcasecmp(name, agg_names[j]) == 0) {
+                break;
+            }
+        }
+        if (j == (int)lengthof(agg_names)) {
+            imcs_ereport(ERRCODE_INVALID_PARAMETER_VALUE, "Unknown aggregate '%s'", name);
+        }
+        (*aggs)[i] = (imcs_multi_agg_t)j;
+    }
+    return n_aggs;
+}
+
+static ArrayType* imcs_multi_agg_result(FunctionCallInfo fcinfo, imcs_iterator_h* result, int n_aggs)
+{
+    Oid elmtyp = get_element_type(get_fn_expr_rettype(fcinfo->flinfo));
+    Datum* values = (Datum*)palloc(n_aggs*sizeof(Datum));
+    int16 elmlen;
+    bool elmbyval;
+    char elmalign;
+    int i;
+    for (i = 0; i < n_aggs; i++) {
+        values[i] = PointerGetDatum(result[i]);
+    }
+    get_typlenbyvalalign(elmtyp, &elmlen, &elmbyval, &elmalign);
+    return construct_array(values, n_aggs, elmtyp, elmlen, elmbyval, elmalign);
+}
+
+Datum cs_group_agg(PG_FUNCTION_ARGS)
+{
+    imcs_iterator_h input = (imcs_iterator_h)PG_GETARG_POINTER(0);
+    imcs_iterator_h group_by = (imcs_iterator_h)PG_GETARG_POINTER(1);
+    imcs_multi_agg_t* aggs;
+    int n_aggs = imcs_parse_multi_agg(PG_GETARG_ARRAYTYPE_P(2), &aggs);
+    imcs_iterator_h* result = (imcs_iterator_h*)palloc(n_aggs*sizeof(imcs_iterator_h));
+    IMCS_APPLY_VOID(group_agg, input->elem_type, (result, input, group_by, n_aggs, aggs));
+    PG_RETURN_ARRAYTYPE_P(imcs_multi_agg_result(fcinfo, result, n_aggs));
+}
+
+Datum cs_agg(PG_FUNCTION_ARGS)
+{
+    imcs_iterator_h input = (imcs_iterator_h)PG_GETARG_POINTER(0);
+    imcs_multi_agg_t* aggs;
+    int n_aggs = imcs_parse_multi_agg(PG_GETARG_ARRAYTYPE_P(1), &aggs);
+    imcs_iterator_h* result = (imcs_iterator_h*)palloc(n_aggs*sizeof(imcs_iterator_h));
+    Datum* values = (Datum*)palloc(n_aggs*sizeof(Datum));
+    bool* nulls = (bool*)palloc(n_aggs*sizeof(bool));
+    int dims[1];
+    int lbs[1];
+    int16 elmlen;
+    bool elmbyval;
+    char elmalign;
+    int i;
+    IMCS_APPLY_VOID(agg, input->elem_type, (result, input, n_aggs, aggs));
+    for (i = 0; i < n_aggs; i++) {
+        imcs_key_t val;
+        double agg;
+        val.val_int64 = 0;
+        switch (result[i]->elem_type) {
+          case TID_int8:
+            nulls[i] = !imcs_next_int8(result[i], &val.val_int8);
+            agg = (double)val.val_int8;
+            break;
+          case TID_int16:
+            nulls[i] = !imcs_next_int16(result[i], &val.val_int16);
+            agg = (double)val.val_int16;
+            break;
+          case TID_int32:
+          case TID_date:
+            nulls[i] = !imcs_next_int32(result[i], &val.val_int32);
+            agg = (double)val.val_int32;
+            break;
+          case TID_int64:
+          case TID_time:
+          case TID_timestamp:
+          case TID_money:
+            nulls[i] = !imcs_next_int64(result[i], &val.val_int64);
+            agg = (double)val.val_int64;
+            break;
+          case TID_float:
+            nulls[i] = !imcs_next_float(result[i], &val.val_float);
+            agg = (double)val.val_float;
+            break;
+          default:
+            nulls[i] = !imcs_next_double(result[i], &val.val_double);
+            agg = val.val_double;
+        }
+        values[i] = Float8GetDatum(agg);
+    }
+    dims[0] = n_aggs;
+    lbs[0] = 1;
+    get_typlenbyvalalign(FLOAT8OID, &elmlen, &elmbyval, &elmalign);
+    PG_RETURN_ARRAYTYPE_P(construct_md_array(values, nulls, 1, dims, lbs, FLOAT8OID, elmlen, elmbyval, elmalign));
+}
+
 IMCS_SORT_OP(rank)
 IMCS_SORT_OP(dense_rank)
 IMCS_SORT_OP(sort)
@@ -3816,6 +5262,12 @@ Datum cs_project(PG_FUNCTION_ARGS)
         usrfctx->n_timeseries = n_timeseries;
         if (!is_null) {
             TupleDescGetAttInMetadata(usrfctx->desc);
+            for (i = 0; i < n_attrs; i++) {
+                if (usrfctx->iterators[i] != NULL) {
+                    usrfctx->iterators[i] = imcs_parallel_materialize(usrfctx->iterators[i]);
+                    imcs_parallel_prepare(usrfctx->iterators[i]);
+                }
+            }
         }
         MemoryContextSwitchTo(oldcontext);
         if (attr_desc != NULL) {
@@ -4015,6 +5467,10 @@ Datum cs_project_agg(PG_FUNCTION_ARGS)
         }
         ReleaseTupleDesc(attr_desc);
         MemoryContextSwitchTo(oldcontext);
+        if (!is_null) {
+            imcs_parallel_prepare(usrfctx->iterators[0]);
+            imcs_parallel_prepare(usrfctx->iterators[1]);
+        }
     }
     funcctx = SRF_PERCALL_SETUP();
     imcs_project_result_cache = 0; /* 0 means end of set */
@@ -5277,6 +6733,129 @@ Datum cs_used_memory(PG_FUNCTION_ARGS)
     PG_RETURN_INT64(imcs_used_memory());
 }
 
+Datum cs_resize_cache(PG_FUNCTION_ARGS)
+{
+    int new_size = PG_GETARG_INT32(0);
+    if (!superuser()) {
+        imcs_ereport(ERRCODE_INSUFFICIENT_PRIVILEGE, "must be superuser to resize IMCS cache");
+    }
+    PG_RETURN_INT32(imcs_disk_resize(new_size));
+}
+
+/*
+ * Check if timeseries belongs to the table (if pattern is table name), 
+ * particular column (pattern is "TABLE-COLUMN") or is timeseries "TABLE-COLUMN-ID" specified by pin.
+ */
+static bool imcs_pin_match(imcs_pin_t const* pin, imcs_hash_key_t const* key)
+{
+    size_t pattern_len = strlen(pin->pattern);
+    return key->db == pin->db
+        && strncmp(key->id, pin->pattern, pattern_len) == 0
+        && (key->id[pattern_len] == '-' || key->id[pattern_len] == '\0');
+}
+
+/*
+ * Set priority of pages of all timeseries matching the pin.
+ * This function is called in context protected by imcs->lock.
+ */
+static int64 imcs_pin_timeseries(imcs_pin_t const* pin)
+{
+    HASH_SEQ_STATUS status;
+    imcs_hash_entry_t* entry;
+    int64 n_pages = 0;
+
+    hash_seq_init(&status, imcs_hash);
+    while ((entry = hash_seq_search(&status)) != NULL)
+    {
+        if (imcs_pin_match(pin, &entry->key)) {
+            n_pages += imcs_pin(&entry->value, pin->priority);
+        }
+    }
+    return n_pages;
+}
+
+Datum cs_pin(PG_FUNCTION_ARGS)
+{
+    text* t = PG_GETARG_TEXT_P(0);
+    size_t pattern_len = VARSIZE(t) - VARHDRSZ;
+    int priority = PG_GETARG_INT32(1);
+    imcs_pin_t pin;
+    int64 n_pages = 0;
+    int i;
+
+    if (imcs == NULL) {
+        imcs_ereport(ERRCODE_LOCK_NOT_AVAILABLE, "Columnar store was not properly initialized, please check that imcs plugin was added to shared_preload_libraries list");
+    }
+    if (!superuser()) {
+        imcs_ereport(ERRCODE_INSUFFICIENT_PRIVILEGE, "must be superuser to pin timeseries in IMCS cache");
+    }
+#ifndef IMCS_DISK_SUPPORT
+    imcs_ereport(ERRCODE_FEATURE_NOT_SUPPORTED, "IMCS was built without disk support");
+#endif
+    if (priority < IMCS_PRIORITY_NORMAL) {
+        priority = IMCS_PRIORITY_NORMAL;
+    } else if (priority > IMCS_PRIORITY_RESIDENT) {
+        priority = IMCS_PRIORITY_RESIDENT;
+    }
+    if (pattern_len >= IMCS_MAX_PIN_PATTERN_LEN) {
+        imcs_ereport(ERRCODE_STRING_DATA_LENGTH_MISMATCH, "Name of pinned table or timeseries is too long");
+    }
+    memcpy(pin.pattern, VARDATA(t), pattern_len);
+    pin.pattern[pattern_len] = '\0';
+    pin.db = MyDatabaseId;
+    pin.priority = priority;
+
+    if (imcs_lock != LOCK_EXCLUSIVE) {
+        if (imcs_lock != LOCK_NONE) {
+            LWLockRelease(imcs->lock);
+        }
+        LWLockAcquire(imcs->lock, LW_EXCLUSIVE);
+        imcs_lock = LOCK_EXCLUSIVE;
+    }
+    /* remember pin to be able to restore it by cs_prewarm */
+    for (i = 0; i < imcs->n_pins && (imcs->pins[i].db != pin.db || strcmp(imcs->pins[i].pattern, pin.pattern) != 0); i++);
+    if (priority != IMCS_PRIORITY_NORMAL) {
+        if (i == IMCS_MAX_PINS) {
+            LWLockRelease(imcs->lock);
+            imcs_lock = LOCK_NONE;
+            imcs_ereport(ERRCODE_PROGRAM_LIMIT_EXCEEDED, "Too many pinned tables");
+        }
+        imcs->pins[i] = pin;
+        if (i == imcs->n_pins) {
+            imcs->n_pins += 1;
+        }
+    } else if (i < imcs->n_pins) {
+        imcs->pins[i] = imcs->pins[--imcs->n_pins];
+    }
+    n_pages = imcs_pin_timeseries(&pin);
+
+    LWLockRelease(imcs->lock);
+    imcs_lock = LOCK_NONE;
+    PG_RETURN_INT64(n_pages);
+}
+
+Datum cs_prewarm(PG_FUNCTION_ARGS)
+{
+    int64 n_pages = 0;
+    int i;
+    if (imcs == NULL) {
+        imcs_ereport(ERRCODE_LOCK_NOT_AVAILABLE, "Columnar store was not properly initialized, please check that imcs plugin was added to shared_preload_libraries list");
+    }
+    if (imcs_lock != LOCK_EXCLUSIVE) {
+        if (imcs_lock != LOCK_NONE) {
+            LWLockRelease(imcs->lock);
+        }
+        LWLockAcquire(imcs->lock, LW_EXCLUSIVE);
+        imcs_lock = LOCK_EXCLUSIVE;
+    }
+    for (i = 0; i < imcs->n_pins; i++) {
+        n_pages += imcs_pin_timeseries(&imcs->pins[i]);
+    }
+    LWLockRelease(imcs->lock);
+    imcs_lock = LOCK_NONE;
+    PG_RETURN_INT64(n_pages);
+}
+
 static int32 imcs_date2year(int32 date)
 {
     int month, year, mday;
@@ -5532,7 +7111,7 @@ Datum cs_call(PG_FUNCTION_ARGS)
 Datum cs_to_array(PG_FUNCTION_ARGS)
 {
     imcs_iterator_h input = (imcs_iterator_h)PG_GETARG_POINTER(0);
-    size_t size = (size_t)imcs_count(input);
+    size_t size;
     Datum* body;
     int16 elmlen;
     bool elmbyval;
@@ -5545,6 +7124,9 @@ Datum cs_to_array(PG_FUNCTION_ARGS)
         imcs_ereport(ERRCODE_DATATYPE_MISMATCH, "Type of sequence element %s doesn't match with function %s return type", imcs_type_mnems[input->elem_type], get_func_name(fcinfo->flinfo->fn_oid));
     }
     IMCS_TRACE(to_array);
+    input = imcs_parallel_materialize(input);
+    imcs_parallel_prepare(input);
+    size = (size_t)imcs_count(input);
     input->reset(input);
     body = palloc(size*sizeof(Datum));
 
@@ -5766,6 +7348,89 @@ Datum cs_profile(PG_FUNCTION_ARGS)
     SRF_RETURN_DONE(funcctx);
 }
 
+#define IMCS_MAX_CACHE_STATS (16 + IMCS_LATENCY_BUCKETS*2)
+
+typedef struct
+{
+    int   n_stats;
+    int   index;
+    char  names[IMCS_MAX_CACHE_STATS][32];
+    int64 values[IMCS_MAX_CACHE_STATS];
+} imcs_cache_stats_context_t;
+
+static void imcs_add_cache_stat(imcs_cache_stats_context_t* ctx, char const* name, int64 value)
+{
+    Assert(ctx->n_stats < IMCS_MAX_CACHE_STATS);
+    strcpy(ctx->names[ctx->n_stats], name);
+    ctx->values[ctx->n_stats++] = value;
+}
+
+static void imcs_add_latency_stats(imcs_cache_stats_context_t* ctx, char const* op, uint64 const* hist)
+{
+    char name[32];
+    int i;
+    for (i = 0; i < IMCS_LATENCY_BUCKETS; i++) {
+        if (i < IMCS_LATENCY_BUCKETS-1) {
+            sprintf(name, "%s_latency_lt_%dus", op, 1 << i);
+        } else {
+            sprintf(name, "%s_latency_ge_%dus", op, 1 << (i-1));
+        }
+        imcs_add_cache_stat(ctx, name, hist[i]);
+    }
+}
+
+Datum cs_cache_stats(PG_FUNCTION_ARGS)
+{
+    FuncCallContext* funcctx;
+    bool per_backend = PG_GETARG_BOOL(0);
+    bool reset = PG_GETARG_BOOL(1);
+    imcs_cache_stats_context_t* ctx;
+
+    if (SRF_IS_FIRSTCALL())
+    {
+        TupleDesc tupdesc;
+        MemoryContext oldcontext;
+        imcs_cache_stats_t stats;
+        if (reset && !per_backend && !superuser()) {
+            imcs_ereport(ERRCODE_INSUFFICIENT_PRIVILEGE, "must be superuser to reset IMCS cache statistic");
+        }
+        funcctx = SRF_FIRSTCALL_INIT();
+
+        oldcontext = MemoryContextSwitchTo(funcctx->multi_call_memory_ctx);
+        if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE) {
+            imcs_ereport(ERRCODE_FEATURE_NOT_SUPPORTED, "function returning record called in context that cannot accept type record");
+        }
+        ctx = (imcs_cache_stats_context_t*)palloc0(sizeof(imcs_cache_stats_context_t));
+        if (imcs_disk_get_stats(&stats, per_backend, reset)) {
+            imcs_add_cache_stat(ctx, "hits", stats.hits);
+            imcs_add_cache_stat(ctx, "misses", stats.misses);
+            imcs_add_cache_stat(ctx, "new_pages", stats.new_pages);
+            imcs_add_cache_stat(ctx, "evictions", stats.evictions);
+            imcs_add_cache_stat(ctx, "dirty_writes", stats.dirty_writes);
+            imcs_add_cache_stat(ctx, "flush_writes", stats.flush_writes);
+            imcs_add_cache_stat(ctx, "busy_waits", stats.busy_waits);
+            imcs_add_cache_stat(ctx, "spinlock_contentions", stats.spinlock_contentions);
+            imcs_add_latency_stats(ctx, "read", stats.read_latency);
+            imcs_add_latency_stats(ctx, "write", stats.write_latency);
+        }
+        funcctx->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+        funcctx->user_fctx = ctx;
+        MemoryContextSwitchTo(oldcontext);
+    }
+    funcctx = SRF_PERCALL_SETUP();
+    ctx = (imcs_cache_stats_context_t*)funcctx->user_fctx;
+    if (ctx->index < ctx->n_stats) {
+        char counter[32];
+        char* values[2];
+        sprintf(counter, INT64_FORMAT, ctx->values[ctx->index]);
+        values[0] = ctx->names[ctx->index];
+        values[1] = counter;
+        ctx->index += 1;
+        SRF_RETURN_NEXT(funcctx, HeapTupleGetDatum(BuildTupleFromCStrings(funcctx->attinmeta, values)));
+    }
+    SRF_RETURN_DONE(funcctx);
+}
+
 Datum cs_str2code(PG_FUNCTION_ARGS)
 {
     imcs_dict_key_t key;
@@ -28,7 +28,19 @@ extern int   imcs_dict_size;
 extern bool  imcs_sync_load;
 extern bool  imcs_use_rle;
 extern int   imcs_cache_size;
+extern int   imcs_max_cache_size;
 extern char* imcs_file_path;
+extern bool  imcs_direct_io;
+extern bool  imcs_compress_pages;
+extern int   imcs_float_sum;
+
+/* Method of summation of floating point values (imcs.float_sum) */
+typedef enum
+{
+    IMCS_FLOAT_SUM_FAST,     /* several independent accumulators */
+    IMCS_FLOAT_SUM_PAIRWISE, /* pairwise (cascade) summation of blocks */
+    IMCS_FLOAT_SUM_KAHAN     /* Kahan compensated summation */
+} imcs_float_sum_method_t;
 
 #define IMCS_INFINITY (-1)
 #define IMCS_MAX_ERROR_MSG_LEN 256
@@ -91,6 +103,8 @@ typedef bool(*imcs_iterator_next_t)(struct imcs_iterator_t_* iterator);
 typedef void(*imcs_iterator_reset_t)(struct imcs_iterator_t_* iterator);
 typedef bool(*imcs_iterator_prepare_t)(struct imcs_iterator_t_* iterator);
 typedef void(*imcs_iterator_merge_t)(struct imcs_iterator_t_* dst, struct imcs_iterator_t_* src);
+typedef void(*imcs_iterator_scatter_t)(struct imcs_iterator_t_** results, int n_results, int i, int n_parts);
+typedef void(*imcs_iterator_merge_partition_t)(struct imcs_iterator_t_** results, int n_results, int part, int n_parts);
 
 /**
  * Timeseries header
@@ -102,6 +116,7 @@ typedef struct imcs_timeseries_t
     bool is_timestamp;
     int elem_size;
     imcs_count_t count;
+    int priority; /* retention priority of pages in disk cache assigned by cs_pin, inherited by new pages */
 } imcs_timeseries_t;
 
 typedef enum
@@ -110,7 +125,16 @@ typedef enum
     FLAG_CONTEXT_FREE  = 2, /* each element can be calculated independetly: such timeseries allows concurrent execution */ 
     FLAG_PREPARED      = 4, /* result was already prepared by prepare() function during parallel query execution */
     FLAG_CONSTANT      = 8, /* timeries of repeated costant element */
-    FLAG_TRANSLATED    = 16 /* character element value was replaced with integer identifier using dictionary */
+    FLAG_TRANSLATED    = 16, /* character element value was replaced with integer identifier using dictionary */
+    FLAG_GROUPED       = 32, /* result is calculated for groups of adjacent equal elements of opd[1] (or opd[0] if there is no opd[1]),
+                                so ranges aligned on group boundaries can be evaluated concurrently */
+    FLAG_WINDOW        = 64, /* result is calculated for moving window of "interval" elements, so range can be evaluated concurrently
+                                if it is prepended with "interval-1" preceding elements */
+    FLAG_GRID          = 128, /* result is calculated for grid of "interval" elements, so ranges aligned on grid boundaries can be evaluated concurrently */
+    FLAG_CUMULATIVE    = 256, /* result is calculated for all preceding elements: merge() combines states of two ranges,
+                                 so range can be evaluated concurrently if its state is seeded with state of preceding elements */
+    FLAG_ACCUMULATIVE  = 512  /* prepare() continues aggregation when it is invoked again after operands were restricted to another range,
+                                 so parallel worker accumulates all its morsels in the same result instead of merging them */
 } imcs_flags_t;
 
 typedef struct
@@ -239,6 +263,20 @@ enum imcs_commands
     imcs_cmd_window_dev, 
     imcs_cmd_window_ema, 
     imcs_cmd_window_atr, 
+    imcs_cmd_window_max_time, 
+    imcs_cmd_window_min_time, 
+    imcs_cmd_window_avg_time, 
+    imcs_cmd_window_sum_time, 
+    imcs_cmd_window_var_time, 
+    imcs_cmd_window_dev_time, 
+    imcs_cmd_grid_max_time, 
+    imcs_cmd_grid_min_time, 
+    imcs_cmd_grid_avg_time, 
+    imcs_cmd_grid_sum_time, 
+    imcs_cmd_grid_var_time, 
+    imcs_cmd_grid_dev_time, 
+    imcs_cmd_group_agg, 
+    imcs_cmd_agg, 
     imcs_cmd_hash_count, 
     imcs_cmd_hash_dup_count, 
     imcs_cmd_hash_max, 
@@ -327,14 +365,17 @@ typedef struct imcs_iterator_t_
     imcs_iterator_reset_t reset; /* start iteration from beginning */
     imcs_iterator_prepare_t prepare; /* prepare iterator (used to start parallel processing) */
     imcs_iterator_merge_t merge; /* merge two iterators (used to merge results of parallel processing) */
+    imcs_iterator_scatter_t scatter; /* split i-th result of parallel processing into partitions (used instead of merge to merge results in parallel) */
+    imcs_iterator_merge_partition_t merge_partition; /* merge partition of all results of parallel processing into results[0] */
     uint16 elem_size; /* size of element */
     uint16 tile_size; /* number of tile items */
     uint16 tile_offs; /* offset to first not handled tile item */ 
     uint8  rle_offs;  /* index within same RLE value */ 
-    uint8  flags;     /* bitmap of imcs_flags_t flags */
+    uint16 flags;     /* bitmap of imcs_flags_t flags */
     imcs_pos_t first_pos; /* first sequence number (inclusive) */
     imcs_pos_t next_pos;  /* sequence number of element returned by sudsequent invocation of next() function */
     imcs_pos_t last_pos;  /* last sequence number (inclusive) */
+    size_t interval;      /* size of window or grid for FLAG_WINDOW and FLAG_GRID operators */
     struct imcs_iterator_t_* opd[3]; /*operands of sequence operator */
     imcs_elem_typeid_t elem_type; /* result element type */
     uint32 iterator_size; /* size fo iterator + tile data + context */
@@ -346,6 +387,7 @@ typedef struct imcs_iterator_t_
 void*              imcs_alloc(size_t size);
 void               imcs_free(void* ptr);
 void*              imcs_alloc_aligned(size_t size);
+void               imcs_free_aligned(void* ptr);
 uint64             imcs_used_memory(void);
 
 imcs_timeseries_t* imcs_get_timeseries(char const* id, imcs_elem_typeid_t elem_type, bool is_timestamp, int elem_size, bool create);
@@ -360,6 +402,9 @@ imcs_iterator_h    imcs_cast(imcs_iterator_h input, imcs_elem_typeid_t elem_type
 imcs_count_t       imcs_count(imcs_iterator_h input);
 
 imcs_iterator_h    imcs_parallel_iterator(imcs_iterator_h iterator);
+imcs_iterator_h    imcs_parallel_materialize(imcs_iterator_h iterator);
+int                imcs_parallel_workers(uint64 n_elems);
+void               imcs_parallel_for(void (*task)(int task_id, int n_tasks, void* arg), int n_tasks, void* arg);
 
 struct imcs_adt_parser_t;
 typedef Datum (*imcs_adt_parse_t)(struct imcs_adt_parser_t* parser, char* value, size_t size);
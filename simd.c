@@ -0,0 +1,372 @@
+#include "simd.h"
+#if defined(IMCS_SIMD_COMPRESS)
+#include <immintrin.h>
+#endif
+
+#define IMCS_SIMD_BINARY_DEF(RET_TYPE, TYPE, MNEM, APPLY, OPERATOR)    \
+IMCS_SIMD_KERNEL void imcs_simd_##MNEM##_##TYPE(RET_TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT x, TYPE const* IMCS_RESTRICT y, size_t n) \
+{                                                                       \
+    size_t i;                                                           \
+    RET_TYPE* IMCS_RESTRICT d = IMCS_ASSUME_ALIGNED(RET_TYPE, dst);     \
+    TYPE const* IMCS_RESTRICT a = IMCS_ASSUME_ALIGNED(TYPE const, x);   \
+    TYPE const* IMCS_RESTRICT b = IMCS_ASSUME_ALIGNED(TYPE const, y);   \
+    for (i = 0; i < n; i++) {                                           \
+        d[i] = APPLY(OPERATOR, a[i], b[i]);                             \
+    }                                                                   \
+}
+
+#define IMCS_SIMD_UNARY_DEF(RES_TYPE, TYPE, MNEM, OPERATION)           \
+IMCS_SIMD_KERNEL void imcs_simd_##MNEM##_##TYPE(RES_TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT src, size_t n) \
+{                                                                       \
+    size_t i;                                                           \
+    RES_TYPE* IMCS_RESTRICT d = IMCS_ASSUME_ALIGNED(RES_TYPE, dst);     \
+    TYPE const* IMCS_RESTRICT s = IMCS_ASSUME_ALIGNED(TYPE const, src); \
+    for (i = 0; i < n; i++) {                                           \
+        TYPE x = s[i];                                                  \
+        d[i] = OPERATION(x);                                            \
+    }                                                                   \
+}
+
+#define IMCS_SIMD_CAST_DEF(FROM_TYPE, TO_TYPE)                         \
+IMCS_SIMD_KERNEL void imcs_simd_##TO_TYPE##_from_##FROM_TYPE(TO_TYPE* IMCS_RESTRICT dst, FROM_TYPE const* IMCS_RESTRICT src, size_t n) \
+{                                                                       \
+    size_t i;                                                           \
+    TO_TYPE* IMCS_RESTRICT d = IMCS_ASSUME_ALIGNED(TO_TYPE, dst);       \
+    FROM_TYPE const* IMCS_RESTRICT s = IMCS_ASSUME_ALIGNED(FROM_TYPE const, src); \
+    for (i = 0; i < n; i++) {                                           \
+        d[i] = (TO_TYPE)s[i];                                           \
+    }                                                                   \
+}
+
+#define IMCS_SIMD_ARITH_DEF(TYPE)                               \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, add, IMCS_BIN_OP, +)       \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, sub, IMCS_BIN_OP, -)       \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, mul, IMCS_BIN_OP, *)       \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, maxof, IMCS_COND, >)       \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, minof, IMCS_COND, <)       \
+    IMCS_SIMD_BINARY_DEF(int8, TYPE, eq, IMCS_BIN_OP, ==)       \
+    IMCS_SIMD_BINARY_DEF(int8, TYPE, ne, IMCS_BIN_OP, !=)       \
+    IMCS_SIMD_BINARY_DEF(int8, TYPE, ge, IMCS_BIN_OP, >=)       \
+    IMCS_SIMD_BINARY_DEF(int8, TYPE, le, IMCS_BIN_OP, <=)       \
+    IMCS_SIMD_BINARY_DEF(int8, TYPE, gt, IMCS_BIN_OP, >)        \
+    IMCS_SIMD_BINARY_DEF(int8, TYPE, lt, IMCS_BIN_OP, <)        \
+    IMCS_SIMD_UNARY_DEF(TYPE, TYPE, abs, IMCS_ABS)              \
+    IMCS_SIMD_UNARY_DEF(TYPE, TYPE, neg, IMCS_NEG)              \
+    IMCS_SIMD_CAST_DEF(TYPE, int8)                              \
+    IMCS_SIMD_CAST_DEF(TYPE, int16)                             \
+    IMCS_SIMD_CAST_DEF(TYPE, int32)                             \
+    IMCS_SIMD_CAST_DEF(TYPE, int64)                             \
+    IMCS_SIMD_CAST_DEF(TYPE, float)                             \
+    IMCS_SIMD_CAST_DEF(TYPE, double)
+
+IMCS_SIMD_ARITH_DEF(int8)
+IMCS_SIMD_ARITH_DEF(int16)
+IMCS_SIMD_ARITH_DEF(int32)
+IMCS_SIMD_ARITH_DEF(int64)
+IMCS_SIMD_ARITH_DEF(float)
+IMCS_SIMD_ARITH_DEF(double)
+
+IMCS_SIMD_BINARY_DEF(float, float, div, IMCS_BIN_OP, /)
+IMCS_SIMD_BINARY_DEF(double, double, div, IMCS_BIN_OP, /)
+
+#define IMCS_LOGICAL_NOT(x) !(x)
+#define IMCS_BIT_NOT(x) ~(x)
+
+#define IMCS_SIMD_BITWISE_DEF(TYPE)                             \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, and, IMCS_BIN_OP, &)       \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, or, IMCS_BIN_OP, |)        \
+    IMCS_SIMD_BINARY_DEF(TYPE, TYPE, xor, IMCS_BIN_OP, ^)       \
+    IMCS_SIMD_UNARY_DEF(TYPE, TYPE, bit_not, IMCS_BIT_NOT)      \
+    IMCS_SIMD_UNARY_DEF(int8, TYPE, not, IMCS_LOGICAL_NOT)
+
+IMCS_SIMD_BITWISE_DEF(int8)
+IMCS_SIMD_BITWISE_DEF(int16)
+IMCS_SIMD_BITWISE_DEF(int32)
+IMCS_SIMD_BITWISE_DEF(int64)
+
+/*
+ * Branch-free compaction: element is always stored at the current end of destination, but the end is advanced
+ * only if condition is true. So there is no mispredicted branches even for 50% selectivity.
+ */
+#define IMCS_SIMD_SELECT_LOOP_DEF(TYPE)                                 \
+IMCS_SIMD_KERNEL static size_t imcs_select_loop_##TYPE(TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT src, int8 const* IMCS_RESTRICT cond, size_t n) \
+{                                                                       \
+    size_t i, j = 0;                                                    \
+    for (i = 0; i < n; i++) {                                           \
+        dst[j] = src[i];                                                \
+        j += cond[i] != 0;                                              \
+    }                                                                   \
+    return j;                                                           \
+}
+
+IMCS_SIMD_SELECT_LOOP_DEF(int8)
+IMCS_SIMD_SELECT_LOOP_DEF(int16)
+IMCS_SIMD_SELECT_LOOP_DEF(int32)
+IMCS_SIMD_SELECT_LOOP_DEF(int64)
+IMCS_SIMD_SELECT_LOOP_DEF(float)
+IMCS_SIMD_SELECT_LOOP_DEF(double)
+
+#if defined(IMCS_SIMD_COMPRESS)
+/*
+ * AVX-512 compress-store: conditions of the chunk of elements are converted to bit mask
+ * and selected elements are written to destination by one instruction.
+ */
+#define IMCS_SIMD_COMPRESS_DEF(TYPE, CHUNK, MASK_TYPE, LOAD_COND, EXTEND, TEST, LOAD, COMPRESS_STORE) \
+__attribute__((target("avx512f"))) static size_t imcs_select_compress_##TYPE(TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT src, int8 const* IMCS_RESTRICT cond, size_t n) \
+{                                                                       \
+    size_t i, j = 0;                                                    \
+    for (i = 0; i + CHUNK <= n; i += CHUNK) {                           \
+        __m512i mask_bytes = EXTEND(LOAD_COND((__m128i const*)(cond + i))); \
+        MASK_TYPE mask = TEST(mask_bytes, mask_bytes);                  \
+        COMPRESS_STORE(dst + j, mask, LOAD(src + i));                   \
+        j += __builtin_popcount(mask);                                  \
+    }                                                                   \
+    return j + imcs_select_loop_##TYPE(dst + j, src + i, cond + i, n - i); \
+}
+
+IMCS_SIMD_COMPRESS_DEF(int32, 16, __mmask16, _mm_loadu_si128, _mm512_cvtepi8_epi32, _mm512_test_epi32_mask, _mm512_loadu_si512, _mm512_mask_compressstoreu_epi32)
+IMCS_SIMD_COMPRESS_DEF(float, 16, __mmask16, _mm_loadu_si128, _mm512_cvtepi8_epi32, _mm512_test_epi32_mask, _mm512_loadu_ps, _mm512_mask_compressstoreu_ps)
+IMCS_SIMD_COMPRESS_DEF(int64, 8, __mmask8, _mm_loadl_epi64, _mm512_cvtepi8_epi64, _mm512_test_epi64_mask, _mm512_loadu_si512, _mm512_mask_compressstoreu_epi64)
+IMCS_SIMD_COMPRESS_DEF(double, 8, __mmask8, _mm_loadl_epi64, _mm512_cvtepi8_epi64, _mm512_test_epi64_mask, _mm512_loadu_pd, _mm512_mask_compressstoreu_pd)
+
+#define IMCS_SIMD_SELECT_COMPRESS(TYPE, dst, src, cond, n) \
+    if (__builtin_cpu_supports("avx512f")) {               \
+        return imcs_select_compress_##TYPE(dst, src, cond, n); \
+    }
+#else
+#define IMCS_SIMD_SELECT_COMPRESS(TYPE, dst, src, cond, n)
+#endif
+
+#define IMCS_SIMD_SELECT_DEF(TYPE, COMPRESS)                            \
+size_t imcs_simd_select_##TYPE(TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT src, int8 const* IMCS_RESTRICT cond, size_t n) \
+{                                                                       \
+    COMPRESS(TYPE, dst, src, cond, n)                                   \
+    return imcs_select_loop_##TYPE(dst, src, cond, n);                  \
+}
+
+#define IMCS_SIMD_NO_COMPRESS(TYPE, dst, src, cond, n)
+
+/* There is no compress instruction for 8 and 16 bit elements in AVX-512F */
+IMCS_SIMD_SELECT_DEF(int8, IMCS_SIMD_NO_COMPRESS)
+IMCS_SIMD_SELECT_DEF(int16, IMCS_SIMD_NO_COMPRESS)
+IMCS_SIMD_SELECT_DEF(int32, IMCS_SIMD_SELECT_COMPRESS)
+IMCS_SIMD_SELECT_DEF(int64, IMCS_SIMD_SELECT_COMPRESS)
+IMCS_SIMD_SELECT_DEF(float, IMCS_SIMD_SELECT_COMPRESS)
+IMCS_SIMD_SELECT_DEF(double, IMCS_SIMD_SELECT_COMPRESS)
+
+IMCS_SIMD_KERNEL size_t imcs_simd_select_pos(int64* IMCS_RESTRICT dst, int64 pos, int8 const* IMCS_RESTRICT cond, size_t n)
+{
+    size_t i, j = 0;
+    for (i = 0; i < n; i++) {
+        dst[j] = pos + i;
+        j += cond[i] != 0;
+    }
+    return j;
+}
+
+#define IMCS_SIMD_SELECT_POS_CMP_DEF(TYPE, MNEM, OP)                   \
+IMCS_SIMD_KERNEL size_t imcs_simd_select_pos_##MNEM##_##TYPE(int64* IMCS_RESTRICT dst, int64 pos, TYPE const* IMCS_RESTRICT src, TYPE val, size_t n) \
+{                                                                       \
+    size_t i, j = 0;                                                    \
+    for (i = 0; i < n; i++) {                                           \
+        dst[j] = pos + i;                                               \
+        j += src[i] OP val;                                             \
+    }                                                                   \
+    return j;                                                           \
+}
+
+#define IMCS_SIMD_SELECT_POS_CMPS_DEF(TYPE)             \
+    IMCS_SIMD_SELECT_POS_CMP_DEF(TYPE, eq, ==)          \
+    IMCS_SIMD_SELECT_POS_CMP_DEF(TYPE, ne, !=)          \
+    IMCS_SIMD_SELECT_POS_CMP_DEF(TYPE, ge, >=)          \
+    IMCS_SIMD_SELECT_POS_CMP_DEF(TYPE, le, <=)          \
+    IMCS_SIMD_SELECT_POS_CMP_DEF(TYPE, gt, >)           \
+    IMCS_SIMD_SELECT_POS_CMP_DEF(TYPE, lt, <)
+
+IMCS_SIMD_SELECT_POS_CMPS_DEF(int8)
+IMCS_SIMD_SELECT_POS_CMPS_DEF(int16)
+IMCS_SIMD_SELECT_POS_CMPS_DEF(int32)
+IMCS_SIMD_SELECT_POS_CMPS_DEF(int64)
+IMCS_SIMD_SELECT_POS_CMPS_DEF(float)
+IMCS_SIMD_SELECT_POS_CMPS_DEF(double)
+
+/*
+ * Reductions: each of IMCS_SIMD_LANES accumulators is updated by its own subsequence of elements,
+ * tail of the tile is processed by the first lane.
+ */
+#define IMCS_SIMD_REDUCE_DEF(TYPE, ACC_TYPE, MNEM, INIT, ACCUMULATE, COMBINE) \
+IMCS_SIMD_KERNEL ACC_TYPE imcs_simd_##MNEM##_##TYPE(TYPE const* src, size_t n) \
+{                                                                       \
+    size_t i, j;                                                        \
+    ACC_TYPE acc[IMCS_SIMD_LANES];                                      \
+    ACC_TYPE result;                                                    \
+    TYPE const* IMCS_RESTRICT s = IMCS_ASSUME_ALIGNED(TYPE const, src); \
+    for (j = 0; j < IMCS_SIMD_LANES; j++) {                             \
+        acc[j] = INIT(s[0]);                                            \
+    }                                                                   \
+    for (i = 0; i + IMCS_SIMD_LANES <= n; i += IMCS_SIMD_LANES) {       \
+        for (j = 0; j < IMCS_SIMD_LANES; j++) {                         \
+            acc[j] = ACCUMULATE(acc[j], s[i + j]);                      \
+        }                                                               \
+    }                                                                   \
+    for (; i < n; i++) {                                                \
+        acc[0] = ACCUMULATE(acc[0], s[i]);                              \
+    }                                                                   \
+    result = acc[0];                                                    \
+    for (j = 1; j < IMCS_SIMD_LANES; j++) {                             \
+        result = COMBINE(result, acc[j]);                               \
+    }                                                                   \
+    return result;                                                      \
+}
+
+#define IMCS_SIMD_SUM2_DEF(TYPE)                                        \
+IMCS_SIMD_KERNEL void imcs_simd_sum2_##TYPE(TYPE const* src, size_t n, double* sum, double* sum2) \
+{                                                                       \
+    size_t i, j;                                                        \
+    double s1[IMCS_SIMD_LANES], s2[IMCS_SIMD_LANES];                    \
+    TYPE const* IMCS_RESTRICT s = IMCS_ASSUME_ALIGNED(TYPE const, src); \
+    for (j = 0; j < IMCS_SIMD_LANES; j++) {                             \
+        s1[j] = s2[j] = 0;                                              \
+    }                                                                   \
+    for (i = 0; i + IMCS_SIMD_LANES <= n; i += IMCS_SIMD_LANES) {       \
+        for (j = 0; j < IMCS_SIMD_LANES; j++) {                         \
+            double val = (double)s[i + j];                              \
+            s1[j] += val;                                               \
+            s2[j] += val*val;                                           \
+        }                                                               \
+    }                                                                   \
+    for (; i < n; i++) {                                                \
+        double val = (double)s[i];                                      \
+        s1[0] += val;                                                   \
+        s2[0] += val*val;                                               \
+    }                                                                   \
+    for (j = 0; j < IMCS_SIMD_LANES; j++) {                             \
+        *sum += s1[j];                                                  \
+        *sum2 += s2[j];                                                 \
+    }                                                                   \
+}
+
+#define IMCS_REDUCE_SELF(val) (val)
+#define IMCS_REDUCE_ZERO(val) 0
+#define IMCS_REDUCE_MAX(acc, val) ((acc) < (val) ? (val) : (acc))
+#define IMCS_REDUCE_MIN(acc, val) ((acc) > (val) ? (val) : (acc))
+#define IMCS_REDUCE_SUM(acc, val) ((acc) + (val))
+
+#define IMCS_SIMD_REDUCES_DEF(TYPE)                                                             \
+    IMCS_SIMD_REDUCE_DEF(TYPE, TYPE, max, IMCS_REDUCE_SELF, IMCS_REDUCE_MAX, IMCS_REDUCE_MAX)   \
+    IMCS_SIMD_REDUCE_DEF(TYPE, TYPE, min, IMCS_REDUCE_SELF, IMCS_REDUCE_MIN, IMCS_REDUCE_MIN)   \
+    IMCS_SIMD_REDUCE_DEF(TYPE, double, dsum, IMCS_REDUCE_ZERO, IMCS_REDUCE_SUM, IMCS_REDUCE_SUM) \
+    IMCS_SIMD_SUM2_DEF(TYPE)
+
+IMCS_SIMD_REDUCES_DEF(int8)
+IMCS_SIMD_REDUCES_DEF(int16)
+IMCS_SIMD_REDUCES_DEF(int32)
+IMCS_SIMD_REDUCES_DEF(int64)
+IMCS_SIMD_REDUCES_DEF(float)
+IMCS_SIMD_REDUCES_DEF(double)
+
+IMCS_SIMD_REDUCE_DEF(int8, int64, sum, IMCS_REDUCE_ZERO, IMCS_REDUCE_SUM, IMCS_REDUCE_SUM)
+IMCS_SIMD_REDUCE_DEF(int16, int64, sum, IMCS_REDUCE_ZERO, IMCS_REDUCE_SUM, IMCS_REDUCE_SUM)
+IMCS_SIMD_REDUCE_DEF(int32, int64, sum, IMCS_REDUCE_ZERO, IMCS_REDUCE_SUM, IMCS_REDUCE_SUM)
+IMCS_SIMD_REDUCE_DEF(int64, int64, sum, IMCS_REDUCE_ZERO, IMCS_REDUCE_SUM, IMCS_REDUCE_SUM)
+
+/* Kahan summation in each lane, lane results are added to the running sum also using Kahan algorithm */
+#define IMCS_KAHAN_ADD(sum, c, val) do { double y_ = (val) - (c); double t_ = (sum) + y_; (c) = (t_ - (sum)) - y_; (sum) = t_; } while (0)
+
+#define IMCS_SIMD_KAHAN_SUM_DEF(TYPE)                                   \
+IMCS_SIMD_KERNEL void imcs_simd_kahan_sum_##TYPE(TYPE const* src, size_t n, double* sum, double* compensation) \
+{                                                                       \
+    size_t i, j;                                                        \
+    double s1[IMCS_SIMD_LANES], c1[IMCS_SIMD_LANES];                    \
+    double acc = *sum, c = *compensation;                               \
+    TYPE const* IMCS_RESTRICT s = IMCS_ASSUME_ALIGNED(TYPE const, src); \
+    for (j = 0; j < IMCS_SIMD_LANES; j++) {                             \
+        s1[j] = c1[j] = 0;                                              \
+    }                                                                   \
+    for (i = 0; i + IMCS_SIMD_LANES <= n; i += IMCS_SIMD_LANES) {       \
+        for (j = 0; j < IMCS_SIMD_LANES; j++) {                         \
+            IMCS_KAHAN_ADD(s1[j], c1[j], (double)s[i + j]);             \
+        }                                                               \
+    }                                                                   \
+    for (; i < n; i++) {                                                \
+        IMCS_KAHAN_ADD(s1[0], c1[0], (double)s[i]);                     \
+    }                                                                   \
+    for (j = 0; j < IMCS_SIMD_LANES; j++) {                             \
+        c += c1[j];                                                     \
+        IMCS_KAHAN_ADD(acc, c, s1[j]);                                  \
+    }                                                                   \
+    *sum = acc;                                                         \
+    *compensation = c;                                                  \
+}
+
+IMCS_SIMD_KAHAN_SUM_DEF(float)
+IMCS_SIMD_KAHAN_SUM_DEF(double)
+
+void imcs_float_sum_init(imcs_float_sum_t* acc)
+{
+    acc->sum = 0;
+    acc->compensation = 0;
+    acc->n_blocks = 0;
+}
+
+/* Add sum of the next block to the cascade: blocks are combined by pairs, pairs by quads,... */
+static void imcs_pairwise_add(imcs_float_sum_t* acc, double block_sum)
+{
+    int level;
+    for (level = 0; acc->n_blocks & ((uint64)1 << level); level++) {
+        block_sum += acc->partial[level];
+    }
+    acc->partial[level] = block_sum;
+    acc->n_blocks += 1;
+}
+
+#define IMCS_FLOAT_SUM_DEF(TYPE)                                        \
+void imcs_float_sum_##TYPE(imcs_float_sum_t* acc, TYPE const* src, size_t n, int method) \
+{                                                                       \
+    size_t i;                                                           \
+    switch (method) {                                                   \
+      case IMCS_FLOAT_SUM_PAIRWISE:                                     \
+        for (i = 0; i < n; i += IMCS_PAIRWISE_BLOCK) {                  \
+            imcs_pairwise_add(acc, imcs_simd_dsum_##TYPE(src + i, n - i < IMCS_PAIRWISE_BLOCK ? n - i : IMCS_PAIRWISE_BLOCK)); \
+        }                                                               \
+        break;                                                          \
+      case IMCS_FLOAT_SUM_KAHAN:                                        \
+        imcs_simd_kahan_sum_##TYPE(src, n, &acc->sum, &acc->compensation); \
+        break;                                                          \
+      default:                                                          \
+        acc->sum += imcs_simd_dsum_##TYPE(src, n);                      \
+    }                                                                   \
+}
+
+IMCS_FLOAT_SUM_DEF(float)
+IMCS_FLOAT_SUM_DEF(double)
+
+double imcs_float_sum_result(imcs_float_sum_t const* acc)
+{
+    double result = 0;
+    int level;
+    for (level = 0; level < IMCS_PAIRWISE_LEVELS; level++) {
+        if (acc->n_blocks & ((uint64)1 << level)) {
+            result += acc->partial[level];
+        }
+    }
+    return result + (acc->sum - acc->compensation);
+}
+
+/* Add accumulator of another range (for example morsel of parallel query): Kahan compensations of both ranges are combined */
+void imcs_float_sum_merge(imcs_float_sum_t* dst, imcs_float_sum_t const* src, int method)
+{
+    switch (method) {
+      case IMCS_FLOAT_SUM_PAIRWISE:
+        if (src->n_blocks != 0) {
+            imcs_pairwise_add(dst, imcs_float_sum_result(src));
+        }
+        break;
+      case IMCS_FLOAT_SUM_KAHAN:
+        dst->compensation += src->compensation;
+        IMCS_KAHAN_ADD(dst->sum, dst->compensation, src->sum);
+        break;
+      default:
+        dst->sum += src->sum;
+    }
+}
@@ -0,0 +1,175 @@
+/*
+ * Vectorized kernels for element-wise operators and casts
+ */
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include "imcs.h"
+
+/*
+ * Kernels are plain loops over tile arrays compiled with -O3 (see Makefile), so that compiler can vectorize them.
+ * With GCC (and recent Clang) on x86_64 Linux each kernel is also cloned for AVX-512, AVX2 and SSE4.2 and the most
+ * advanced version supported by the CPU is selected by dynamic loader at runtime. "default" clone is scalar fallback.
+ * Define IMCS_NO_TARGET_CLONES to disable multiversioning.
+ */
+#if !defined(IMCS_NO_TARGET_CLONES) && defined(__x86_64__) && defined(__linux__) \
+    && ((defined(__clang__) && __clang_major__ >= 14) || (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 6))
+#define IMCS_SIMD_KERNEL __attribute__((target_clones("avx512f", "avx2", "sse4.2", "default")))
+#define IMCS_SIMD_COMPRESS 1 /* use AVX-512 compress-store for selection if supported by CPU */
+#else
+#define IMCS_SIMD_KERNEL
+#endif
+
+#ifdef __GNUC__
+#define IMCS_RESTRICT __restrict__
+#define IMCS_ASSUME_ALIGNED(TYPE, ptr) ((TYPE*)__builtin_assume_aligned(ptr, 16))
+#else
+#define IMCS_RESTRICT
+#define IMCS_ASSUME_ALIGNED(TYPE, ptr) (ptr)
+#endif
+
+/* Operations applied by kernels (also used by scalar loops in func.c) */
+#define IMCS_BIN_OP(OP, x, y) (x) OP (y)
+#define IMCS_BIN_FUNC(OP, x, y) OP(x, y)
+#define IMCS_COND(OP, x, y) ((x) OP (y) ? (x) : (y))
+#define IMCS_ABS(x) (x < 0 ? -x : x)
+#define IMCS_NEG(x) (-x)
+
+/* dst[i] = x[i] MNEM y[i] for i in [0, n). Tiles are 16-byte aligned and never overlap */
+#define IMCS_SIMD_BINARY_DECL(RET_TYPE, TYPE, MNEM) \
+    void imcs_simd_##MNEM##_##TYPE(RET_TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT x, TYPE const* IMCS_RESTRICT y, size_t n);
+
+/* dst[i] = MNEM(src[i]) for i in [0, n) */
+#define IMCS_SIMD_UNARY_DECL(RES_TYPE, TYPE, MNEM) \
+    void imcs_simd_##MNEM##_##TYPE(RES_TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT src, size_t n);
+
+/* dst[i] = (TO_TYPE)src[i] for i in [0, n) */
+#define IMCS_SIMD_CAST_DECL(FROM_TYPE, TO_TYPE) \
+    void imcs_simd_##TO_TYPE##_from_##FROM_TYPE(TO_TYPE* IMCS_RESTRICT dst, FROM_TYPE const* IMCS_RESTRICT src, size_t n);
+
+#define IMCS_SIMD_ARITH_DECL(TYPE)              \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, add)      \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, sub)      \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, mul)      \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, maxof)    \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, minof)    \
+    IMCS_SIMD_BINARY_DECL(int8, TYPE, eq)       \
+    IMCS_SIMD_BINARY_DECL(int8, TYPE, ne)       \
+    IMCS_SIMD_BINARY_DECL(int8, TYPE, ge)       \
+    IMCS_SIMD_BINARY_DECL(int8, TYPE, le)       \
+    IMCS_SIMD_BINARY_DECL(int8, TYPE, gt)       \
+    IMCS_SIMD_BINARY_DECL(int8, TYPE, lt)       \
+    IMCS_SIMD_UNARY_DECL(TYPE, TYPE, abs)       \
+    IMCS_SIMD_UNARY_DECL(TYPE, TYPE, neg)       \
+    IMCS_SIMD_CAST_DECL(TYPE, int8)             \
+    IMCS_SIMD_CAST_DECL(TYPE, int16)            \
+    IMCS_SIMD_CAST_DECL(TYPE, int32)            \
+    IMCS_SIMD_CAST_DECL(TYPE, int64)            \
+    IMCS_SIMD_CAST_DECL(TYPE, float)            \
+    IMCS_SIMD_CAST_DECL(TYPE, double)
+
+IMCS_SIMD_ARITH_DECL(int8)
+IMCS_SIMD_ARITH_DECL(int16)
+IMCS_SIMD_ARITH_DECL(int32)
+IMCS_SIMD_ARITH_DECL(int64)
+IMCS_SIMD_ARITH_DECL(float)
+IMCS_SIMD_ARITH_DECL(double)
+
+/* Integer division can not be vectorized (and has to trap on zero divisor), so only floating point kernels */
+IMCS_SIMD_BINARY_DECL(float, float, div)
+IMCS_SIMD_BINARY_DECL(double, double, div)
+
+#define IMCS_SIMD_BITWISE_DECL(TYPE)            \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, and)      \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, or)       \
+    IMCS_SIMD_BINARY_DECL(TYPE, TYPE, xor)      \
+    IMCS_SIMD_UNARY_DECL(TYPE, TYPE, bit_not)   \
+    IMCS_SIMD_UNARY_DECL(int8, TYPE, not)
+
+IMCS_SIMD_BITWISE_DECL(int8)
+IMCS_SIMD_BITWISE_DECL(int16)
+IMCS_SIMD_BITWISE_DECL(int32)
+IMCS_SIMD_BITWISE_DECL(int64)
+
+/*
+ * Selection: copy to dst elements of src for which cond is not zero and return number of copied elements.
+ * Compaction is branch-free: dst should have space for n elements.
+ */
+#define IMCS_SIMD_SELECT_DECL(TYPE) \
+    size_t imcs_simd_select_##TYPE(TYPE* IMCS_RESTRICT dst, TYPE const* IMCS_RESTRICT src, int8 const* IMCS_RESTRICT cond, size_t n);
+
+IMCS_SIMD_SELECT_DECL(int8)
+IMCS_SIMD_SELECT_DECL(int16)
+IMCS_SIMD_SELECT_DECL(int32)
+IMCS_SIMD_SELECT_DECL(int64)
+IMCS_SIMD_SELECT_DECL(float)
+IMCS_SIMD_SELECT_DECL(double)
+
+/* Store to dst positions pos+i of non-zero elements cond[i] */
+size_t imcs_simd_select_pos(int64* IMCS_RESTRICT dst, int64 pos, int8 const* IMCS_RESTRICT cond, size_t n);
+
+/* Fused comparison with constant and selection: store to dst positions pos+i of elements for which src[i] MNEM val */
+#define IMCS_SIMD_SELECT_POS_CMP_DECL(TYPE)                             \
+    size_t imcs_simd_select_pos_eq_##TYPE(int64* IMCS_RESTRICT dst, int64 pos, TYPE const* IMCS_RESTRICT src, TYPE val, size_t n); \
+    size_t imcs_simd_select_pos_ne_##TYPE(int64* IMCS_RESTRICT dst, int64 pos, TYPE const* IMCS_RESTRICT src, TYPE val, size_t n); \
+    size_t imcs_simd_select_pos_ge_##TYPE(int64* IMCS_RESTRICT dst, int64 pos, TYPE const* IMCS_RESTRICT src, TYPE val, size_t n); \
+    size_t imcs_simd_select_pos_le_##TYPE(int64* IMCS_RESTRICT dst, int64 pos, TYPE const* IMCS_RESTRICT src, TYPE val, size_t n); \
+    size_t imcs_simd_select_pos_gt_##TYPE(int64* IMCS_RESTRICT dst, int64 pos, TYPE const* IMCS_RESTRICT src, TYPE val, size_t n); \
+    size_t imcs_simd_select_pos_lt_##TYPE(int64* IMCS_RESTRICT dst, int64 pos, TYPE const* IMCS_RESTRICT src, TYPE val, size_t n);
+
+IMCS_SIMD_SELECT_POS_CMP_DECL(int8)
+IMCS_SIMD_SELECT_POS_CMP_DECL(int16)
+IMCS_SIMD_SELECT_POS_CMP_DECL(int32)
+IMCS_SIMD_SELECT_POS_CMP_DECL(int64)
+IMCS_SIMD_SELECT_POS_CMP_DECL(float)
+IMCS_SIMD_SELECT_POS_CMP_DECL(double)
+
+/*
+ * Reductions use IMCS_SIMD_LANES independent accumulators, so that sequence of additions is not limited
+ * by latency of single dependency chain and can be mapped on vector registers.
+ */
+#define IMCS_SIMD_LANES 8
+
+/* Number of elements summed by one block of pairwise summation */
+#define IMCS_PAIRWISE_BLOCK 64
+
+#define IMCS_PAIRWISE_LEVELS 64
+
+/* State of floating point summation by method specified by imcs.float_sum */
+typedef struct
+{
+    double sum;
+    double compensation; /* Kahan: lost low-order bits which should be subtracted from the sum */
+    uint64 n_blocks;     /* pairwise: number of summed blocks, bit K is set if partial[K] is used */
+    double partial[IMCS_PAIRWISE_LEVELS];
+} imcs_float_sum_t;
+
+void   imcs_float_sum_init(imcs_float_sum_t* acc);
+void   imcs_float_sum_float(imcs_float_sum_t* acc, float const* src, size_t n, int method);
+void   imcs_float_sum_double(imcs_float_sum_t* acc, double const* src, size_t n, int method);
+double imcs_float_sum_result(imcs_float_sum_t const* acc);
+void   imcs_float_sum_merge(imcs_float_sum_t* dst, imcs_float_sum_t const* src, int method);
+
+/* Reductions of n > 0 elements of tile */
+#define IMCS_SIMD_REDUCE_DECL(TYPE)                                     \
+    TYPE   imcs_simd_max_##TYPE(TYPE const* src, size_t n);             \
+    TYPE   imcs_simd_min_##TYPE(TYPE const* src, size_t n);             \
+    double imcs_simd_dsum_##TYPE(TYPE const* src, size_t n);            \
+    void   imcs_simd_sum2_##TYPE(TYPE const* src, size_t n, double* sum, double* sum2);
+
+IMCS_SIMD_REDUCE_DECL(int8)
+IMCS_SIMD_REDUCE_DECL(int16)
+IMCS_SIMD_REDUCE_DECL(int32)
+IMCS_SIMD_REDUCE_DECL(int64)
+IMCS_SIMD_REDUCE_DECL(float)
+IMCS_SIMD_REDUCE_DECL(double)
+
+int64 imcs_simd_sum_int8(int8 const* src, size_t n);
+int64 imcs_simd_sum_int16(int16 const* src, size_t n);
+int64 imcs_simd_sum_int32(int32 const* src, size_t n);
+int64 imcs_simd_sum_int64(int64 const* src, size_t n);
+
+void imcs_simd_kahan_sum_float(float const* src, size_t n, double* sum, double* compensation);
+void imcs_simd_kahan_sum_double(double const* src, size_t n, double* sum, double* compensation);
+
+#endif
@@ -197,6 +197,31 @@ imcs_bool imcs_is_process_alive(imcs_process_t proc)
     return 1;
 }
 
+
+void imcs_bind_thread(int cpu)
+{
+    SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (cpu % (sizeof(DWORD_PTR)*8)));
+}
+
+int imcs_get_current_cpu(void)
+{
+    return (int)GetCurrentProcessorNumber();
+}
+
+int imcs_get_cpu_node(int cpu, int n_nodes)
+{
+    UCHAR node;
+    if (GetNumaProcessorNode((UCHAR)cpu, &node) && node < n_nodes) {
+        return node;
+    }
+    return cpu*n_nodes/imcs_get_number_of_cpus();
+}
+
+void imcs_bind_memory(void* addr, size_t size, int node)
+{
+    /* memory allocation policy can not be changed for already reserved region */
+}
+
 #else
 
 #include <unistd.h>
@@ -421,4 +446,65 @@ imcs_bool imcs_is_process_alive(imcs_process_t proc)
     return kill((int)(size_t)proc, 0) == 0;
 }
 
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+
+void imcs_bind_thread(int cpu)
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask);
+}
+
+int imcs_get_current_cpu(void)
+{
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+}
+
+int imcs_get_cpu_node(int cpu, int n_nodes)
+{
+    char path[64];
+    int node;
+    for (node = 0; node < n_nodes; node++) {
+        sprintf(path, "/sys/devices/system/cpu/cpu%d/node%d", cpu, node);
+        if (access(path, F_OK) == 0) {
+            return node;
+        }
+    }
+    return cpu*n_nodes/imcs_get_number_of_cpus();
+}
+
+void imcs_bind_memory(void* addr, size_t size, int node)
+{
+    unsigned long nodemask = 1UL << node;
+    /* Failure is not critical: memory will be allocated according to default policy */
+    syscall(SYS_mbind, addr, size, MPOL_PREFERRED, &nodemask, sizeof(nodemask)*8, 0);
+}
+#else
+void imcs_bind_thread(int cpu)
+{
+}
+
+int imcs_get_current_cpu(void)
+{
+    return 0;
+}
+
+int imcs_get_cpu_node(int cpu, int n_nodes)
+{
+    return cpu*n_nodes/imcs_get_number_of_cpus();
+}
+
+void imcs_bind_memory(void* addr, size_t size, int node)
+{
+}
+#endif
+
 #endif
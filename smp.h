@@ -6,6 +6,24 @@ typedef int imcs_bool;
 
 #define IMCS_TM_INFINITE ((unsigned)-1)
 
+/* Atomic increment returning previous value and full memory barrier */
+#ifdef _WIN32
+#define IMCS_ATOMIC_FETCH_ADD(ptr, val) InterlockedExchangeAdd((volatile LONG*)(ptr), (val))
+#define IMCS_MEMORY_BARRIER() MemoryBarrier()
+#else
+#define IMCS_ATOMIC_FETCH_ADD(ptr, val) __sync_fetch_and_add(ptr, val)
+#define IMCS_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+/* Hint to CPU that thread is performing busy loop */
+#if defined(_WIN32)
+#define IMCS_CPU_RELAX() YieldProcessor()
+#elif defined(__i386__) || defined(__x86_64__)
+#define IMCS_CPU_RELAX() __builtin_ia32_pause()
+#else
+#define IMCS_CPU_RELAX() IMCS_MEMORY_BARRIER()
+#endif
+
 typedef void (*imcs_thread_proc_t)(void* arg);
 
 typedef struct imcs_tls_t { 
@@ -40,20 +58,30 @@ typedef struct imcs_semaphore_t {
 extern imcs_semaphore_t* imcs_create_semaphore(int value);
 
 extern int imcs_get_number_of_cpus(void);
+
+/* NUMA support: functions do nothing at platforms where it is not supported */
+extern void imcs_bind_thread(int cpu);                            /* bind current thread to the specified CPU */
+extern int  imcs_get_current_cpu(void);
+extern int  imcs_get_cpu_node(int cpu, int n_nodes);              /* NUMA node of the CPU */
+extern void imcs_bind_memory(void* addr, size_t size, int node);  /* allocate physical pages for this region at specified node */
 extern imcs_process_t imcs_get_pid(void);
 extern imcs_bool imcs_is_process_alive(imcs_process_t proc);
 
 
+#define IMCS_POOL_MAX_JOBS 8 /* maximal number of concurrently executed jobs */
+
 typedef void (*imcs_job_t)(int thread_id, int n_threads, void* arg);
 typedef void (*imcs_job_callback_t)(void* arg, void* result);
 
 typedef struct imcs_thread_pool_t { 
     int  (*get_number_of_threads)(struct imcs_thread_pool_t* pool);
-    void (*execute)(struct imcs_thread_pool_t* pool, imcs_job_t job, void* arg);
-    void (*merge)(struct imcs_thread_pool_t* pool, imcs_job_callback_t callback, void* result);
+    void (*execute)(struct imcs_thread_pool_t* pool, imcs_job_t job, void* arg, int n_threads); /* n_threads - number of threads executing job (0 - all) */
+    int  (*submit)(struct imcs_thread_pool_t* pool, imcs_job_t job, void* arg, int n_threads); /* start job without waiting its completion, returns job handle or -1 if too much jobs are started */
+    void (*wait)(struct imcs_thread_pool_t* pool, int handle); /* wait completion of submitted job */
+    void (*merge)(struct imcs_thread_pool_t* pool, imcs_job_callback_t callback, void* arg, void* result);
     void (*destroy)(struct imcs_thread_pool_t* pool);
 } imcs_thread_pool_t;
 
-extern imcs_thread_pool_t* imcs_create_thread_pool(int n_threads); /* 0 - choose number of threads automaticallym based on number of cores */
+extern imcs_thread_pool_t* imcs_create_thread_pool(int n_threads, imcs_bool bind_threads); /* n_threads: 0 - choose number of threads automaticallym based on number of cores */
  
 #endif
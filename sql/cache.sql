@@ -0,0 +1,19 @@
+create role imcs_regress_user;
+set role imcs_regress_user;
+select cs_resize_cache(1000);
+reset role;
+select cs_resize_cache(1000);
+set role imcs_regress_user;
+select cs_pin('Quote', 2);
+reset role;
+select cs_pin('Quote', 2);
+select cs_prewarm();
+set role imcs_regress_user;
+select count(*) from cs_cache_stats(true, true);
+select count(*) from cs_cache_stats(false, true);
+reset role;
+select count(*) from cs_cache_stats(false, true);
+--- Regression tests are run without disk mode: O_DIRECT I/O and compressed pages are not tested, only absence of their settings is checked
+select name, setting from pg_settings where name = 'imcs.direct_io';
+select name, setting from pg_settings where name = 'imcs.compress_pages';
+drop role imcs_regress_user;
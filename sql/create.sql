@@ -26,4 +26,7 @@ insert into CrashLog values ('2014-04-14 11:56', 10000003, 'China', 'Beijing', '
 select cs_create('CrashLog', 'log_time');
 select CrashLog_load();
 
+-- Timeseries 1,2,...,n of bigint type used as input of tests
+create function test_seq(n integer) returns timeseries as $$ begin return cs_cum_sum(cs_limit(cs_const(1, 'int4'), 0, n - 1)); end; $$ language plpgsql stable strict;
+
 select cs_used_memory();
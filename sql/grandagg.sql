@@ -16,4 +16,10 @@ select cs_sum(cs_limit(cs_filter_pos(cs_const(1, 'char')), 0, 3));
 select cs_sum(cs_cum_sum(cs_limit(cs_const(1, 'int4'), 0, 3)));
 select cs_median(Close) from Quote_get(array['ABB','IBM']);
 select cs_all('int2:{2,3,6}');
-select cs_any('char:{2,3,6}');
\ No newline at end of file
+select cs_any('char:{2,3,6}');
+select cs_agg(Volume,array['min','max','avg','sum','count']) from Quote_get('IBM');
+set imcs.float_sum='pairwise';
+select cs_sum(Close) from Quote_concat(array['ABB','IBM']);
+set imcs.float_sum='kahan';
+select cs_avg(Close) from Quote_concat(array['ABB','IBM']);
+reset imcs.float_sum;
@@ -4,3 +4,6 @@ select cs_grid_sum(Close,2) from Quote_get('IBM');
 select cs_grid_avg(Close,2) from Quote_get('IBM');
 select cs_grid_var(Close,2) from Quote_get('IBM');
 select cs_grid_dev(Close,2) from Quote_get('IBM');
+select cs_grid_max_time(Close,Day,'2 days') from Quote_get('IBM');
+select cs_grid_sum_time(Close,Day,'2 days') from Quote_get('IBM');
+select cs_grid_avg_time(Close,Day,'2 days') from Quote_get('IBM');
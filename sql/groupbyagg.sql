@@ -17,3 +17,4 @@ select cs_win_group_dev(Close,cs_week(Day)) from Quote_get('IBM');
 select cs_win_group_first(Close,cs_week(Day)) from Quote_get('IBM');
 select cs_win_group_last(Close,cs_week(Day)) from Quote_get('IBM');
 select cs_win_group_sum('int4:{1,2,3,4,5,6,7,8,9,10}','int4:{1,1,1,2,2,3,3,3,3,4}');
+select unnest(cs_group_agg(Close,Day/3,array['first','max','min','last','sum','count'])) from Quote_get('IBM');
@@ -49,3 +49,9 @@ select * from CrashLog_get();
 select cs_project(c.*, cs_filter_pos(country = cs_str2code('USA'))) from CrashLog_get() c;
 select cs_project(c.*, cs_filter_pos(cs_ilike(device, 'iphone%'))) from CrashLog_get() c;
 select cs_dictionary_size();
+--- Vectorized kernels over series of 1001 elements: longer than tile and not multiple of vector width, so remainder loops are also used
+select cs_sum(test_seq(1001) * 3 - test_seq(1001) + 1), cs_sum(test_seq(1001) * test_seq(1001) * test_seq(1001));
+select cs_sum(cs_maxof(test_seq(1001), 1002 - test_seq(1001))), cs_sum(cs_minof(test_seq(1001), 1002 - test_seq(1001)));
+select cs_sum(-test_seq(1001)), cs_sum(@(test_seq(1001) - 501)), cs_sum(test_seq(1001) & 7), cs_sum(~test_seq(1001));
+select cs_count(cs_filter_pos((test_seq(1001) >= 100) & (test_seq(1001) < 900) & (test_seq(1001) <> 500))), cs_count(cs_filter_pos((test_seq(1001) = 1) | (test_seq(1001) > 1000) | (test_seq(1001) <= 8))), cs_count(cs_filter_pos((!(test_seq(1001) > 8)) # (test_seq(1001) < 4)));
+select cs_sum(cs_cast(test_seq(1001), 'int2') * 2), cs_sum(cs_cast(test_seq(1001), 'int4') - 1), cs_sum(cs_maxof(cs_cast(test_seq(1001), 'float4'), cs_cast(1002 - test_seq(1001), 'float4'))), cs_sum(cs_cast(test_seq(1001), 'float8') / 4);
@@ -0,0 +1,70 @@
+--- Threads are bound to CPUs when the first parallel query of the session starts thread pool
+set imcs.bind_threads=on;
+--- Split timeseries into morsels of one element to make workers fetch them concurrently
+set imcs.morsel_size=1;
+select cs_sum(Volume) from Quote_get('IBM');
+select cs_max(Close) from Quote_get(array['ABB','IBM'], date('03-Nov-2013'), date('05-Nov-2013'));
+select cs_min(Close) from Quote_get(array['ABB','IBM']);
+select cs_count(Day) from Quote_get('IBM');
+select cs_avg(Volume) from Quote_get('IBM');
+select cs_var(Open) from Quote_get('IBM');
+select cs_dev(Close) from Quote_get('IBM');
+select cs_sum(Close) from Quote_concat(array['ABB','IBM']);
+select cs_sum(cs_filter(test_seq(1000) % 3 = 0, test_seq(1000)));
+select cs_sum(cs_filter_pos(test_seq(1000) % 2 = 0));
+select cs_sum(Volume), cs_max(Volume), cs_min(Volume), cs_avg(Volume) from Quote_get('IBM');
+select cs_max(ibm.Close), cs_max(abb.Close) from Quote_get('ABB') as abb, Quote_get('IBM') as ibm;
+select cs_project(q.*) from (select cs_cum_max(Close), cs_cum_min(Close) from Quote_get('IBM')) q;
+show imcs.bind_threads;
+set imcs.bind_threads=off;
+show imcs.numa_nodes;
+alter system set imcs.numa_nodes=100;
+select cs_project(q.*) from (select test_seq(1000)) q limit 3;
+select cs_sum(test_seq(1000));
+select cs_hash_max(Close,Day % 2) from Quote_get('IBM');
+select cs_hash_sum(Close,Day % 2) from Quote_get('IBM');
+select cs_hash_count(cs_floor((High-Low)*10)) from Quote_get('IBM');
+select p.agg_val,cs_cut(p.group_by,'i4i4') from (select (cs_project_agg(cs_hash_sum(Close,(Day % 2)||(Volume%10)))).* from Quote_get('IBM')) p;
+select cs_sort_pos('int4:{3,1,3,2,1}');
+select cs_sort_pos('int4:{3,1,3,2,1}', 'desc');
+select cs_sort_pos('float8:{2,NaN,1,NaN,3}');
+select cs_sort_pos('float8:{2,NaN,1,NaN,3}', 'desc');
+select cs_median('float8:{2,NaN,1,NaN,3}');
+select cs_median('float8:{2,NaN,1,NaN,3,4}');
+select cs_median('float8:{NaN,1,NaN}');
+select cs_quantile('float8:{2,NaN,1,NaN,3}', 2);
+select cs_group_max(Close,Day/3) from Quote_get('IBM');
+select cs_group_sum(Close,Day/3) from Quote_get('IBM');
+select cs_group_last(Close,Day/3) from Quote_get('IBM');
+select cs_group_all('int8:{3,1,6,7,0,3,6,5,2,3,7}','int4:{1,1,1,2,2,3,3,4,5,5,5}');
+select cs_group_sum('int4:{1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32}','int4:{1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,2,2,2,2,2,2,2,2,2,2,2,2}');
+select cs_group_first('int4:{1,2,3,4,5,6,7,8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23,24,25,26,27,28,29,30,31,32}','int4:{1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,2,2,2,2,2,2,2,2,2,2,2,2}');
+select cs_window_sum(Close,3) from Quote_get('IBM');
+select cs_grid_max(Close,2) from Quote_get('IBM');
+select cs_cum_max(Close) from Quote_get('IBM');
+select cs_cum_min(Close) from Quote_get('IBM');
+select cs_cum_sum(Close) from Quote_get('IBM');
+select cs_cum_avg(Close) from Quote_get('IBM');
+select cs_cum_prd(Close) from Quote_get('IBM');
+select cs_cum_var(Close) from Quote_get('IBM');
+select cs_cum_dev(Close) from Quote_get('IBM');
+select cs_quantile(cs_cum_sum(test_seq(400) * 37 % 101 + 1), 4);
+select cs_sum(cs_cum_max(test_seq(400) * 37 % 101 + 1)), cs_sum(cs_cum_min(test_seq(400) * 37 % 101 + 1));
+select cs_median(Close) from Quote_get(array['ABB','IBM']);
+select cs_quantile(Close, 2) from Quote_get('IBM');
+select cs_median(test_seq(400) * 37 % 101 + 1);
+select cs_quantile(test_seq(400) * 37 % 101 + 1, 10);
+--- Window is evaluated by morsels only when it is smaller than the morsel
+set imcs.morsel_size=16;
+select cs_median(cs_window_max(test_seq(400) * 37 % 101 + 1, 5));
+select cs_quantile(cs_window_min(test_seq(400) * 37 % 101 + 1, 5), 4);
+select cs_median(cs_grid_max(test_seq(400) * 37 % 101 + 1, 7));
+select cs_quantile(cs_grid_min(test_seq(400) * 37 % 101 + 1, 7), 4);
+select cs_sum(cs_window_max(test_seq(400) * 37 % 101 + 1, 10)), cs_sum(cs_window_min(test_seq(400) * 37 % 101 + 1, 10));
+select cs_sum(cs_grid_max(test_seq(400) * 37 % 101 + 1, 7)), cs_sum(cs_grid_min(test_seq(400) * 37 % 101 + 1, 7));
+--- Kahan compensation is merged with partial sums of morsels: each morsel except the first adds 1 to 2^53, which is lost without compensation
+set imcs.float_sum='kahan';
+select cs_sum(cs_maxof(2 - cs_cast(test_seq(1600), 'float8'), 0) * 9007199254740992 + 0.0625);
+reset imcs.float_sum;
+set imcs.morsel_size=1;
+reset imcs.morsel_size;
@@ -14,3 +14,14 @@ select cs_rank('float4:{1.1,0.2,2.2,0.2,0.1}', 'desc');
 select cs_dense_rank('float4:{1.1,0.2,2.2,0.2,0.1}', 'desc');
 select cs_quantile(Close, 2) from Quote_get('IBM');
 select cs_quantile('float4:{10,3,0,3,4,5,9,11,7,3,3}', 2);
+--- Radix sort of 300 elements: negative zero is equal to zero, NaNs are placed at the end and equal values are ordered by position
+select cs_limit(cs_sort_pos(cs_cast(test_seq(300) % 3 - 1, 'float8') * cs_cast(test_seq(300) % 2, 'float8')), 50, 52);
+select cs_limit(cs_sort_pos(cs_cast(test_seq(300) % 3 - 1, 'float8') * cs_cast(test_seq(300) % 2, 'float8'), 'desc'), 50, 52);
+select cs_limit(cs_sort_pos(cs_cast(test_seq(300) % 3, 'float8') / cs_cast(test_seq(300) % 3, 'float8')), 200, 202);
+select cs_limit(cs_sort_pos(cs_cast(test_seq(300) % 3, 'float8') / cs_cast(test_seq(300) % 3, 'float8'), 'desc'), 200, 202);
+--- Median and quantiles of sequences with duplicates and of sequences larger than tile
+select cs_median('float8:{4,1,3,2}');
+select cs_median('int4:{5,5,9,5,1,5,5}');
+select cs_quantile('int4:{7,7,7,1,1,1,4,4,4,4}', 5);
+select cs_median(test_seq(400) * 37 % 101 + 1);
+select cs_quantile(test_seq(400) * 37 % 101 + 1, 10);
@@ -29,3 +29,23 @@ select cs_cast('float4:{100.99,99.01,1000000}', 'money');
 select cs_cast('money:{100.99,99.01,"1,000,000"}', 'float8');
 select cs_trend('int4:{1,2,3,3,2,2,4,5,6,5,5}');
 
+--- Nine of ten elements are selected, so selected elements of the next input tile do not fit in the result tile and are carried to the next one
+select cs_limit(cs_filter(test_seq(1000) % 10 <> 0, test_seq(1000)), 124, 131);
+select cs_limit(cs_filter_pos(test_seq(1000) % 10 <> 0), 124, 131);
+select cs_count(cs_filter_pos(test_seq(1000) % 10 <> 0)), cs_sum(cs_filter(test_seq(1000) % 10 <> 0, test_seq(1000))), cs_sum(cs_cum_sum(cs_filter(test_seq(1000) % 10 <> 0, test_seq(1000))));
+select cs_filter(Close > 30, Day) from Quote_get('IBM');
+select Quote_project(q.*, cs_filter_pos(cs_le(cs_const(400, 'int4'), q.Volume))) from Quote_get('IBM') q;
+--- Fused scan and comparison of stored timeseries which is longer than tile
+create table Series(Pos integer, Val integer, X float8);
+insert into Series select i, i % 10, i * 0.5 from generate_series(1, 1000) i;
+select cs_create('Series', 'Pos');
+select Series_load();
+select cs_count(cs_filter_pos(Val > 6)), cs_sum(cs_filter_pos(Val > 6)), cs_sum(cs_filter(Val > 6, X)) from Series_get();
+select cs_limit(cs_filter(Val > 6, X), 126, 129) from Series_get();
+select cs_count(cs_filter_pos(Val > 9)), cs_count(cs_filter(Val > 9, X)), cs_count(cs_filter(cs_le(cs_const(0, 'int4'), Val), X)), cs_sum(cs_filter(cs_le(cs_const(0, 'int4'), Val), X)) from Series_get();
+--- Positions are selected from the whole stored timeseries, so input of smaller range is filtered without fusion
+select cs_count(cs_filter(a.Val > 6, b.X)), cs_sum(cs_filter(a.Val > 6, b.X)) from Series_get() a, Series_get(1, 100) b;
+--- Fused filter produces the same elements as filter by materialized condition
+select cs_to_float8_array(cs_filter(Val > 6, X)) = cs_to_float8_array(cs_filter(Val + 0 > 6, X)), cs_to_int8_array(cs_filter_pos(Val <> 3)) = cs_to_int8_array(cs_filter_pos(Val + 0 <> 3)) from Series_get();
+select Series_drop();
+drop table Series;
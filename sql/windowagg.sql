@@ -15,3 +15,15 @@ select cs_window_dev(Close,3) << 2 from Quote_get('IBM');
 select cs_window_ema(Close,3) from Quote_get('IBM');
 --- 2-days ATR (Average True Range)
 select cs_window_atr(cs_maxof(High-Low,cs_concat('float4:{0}',cs_maxof(cs_abs((High<<1) - Close), cs_abs((Low<<1) - Close)))), 3) << 2 from Quote_get('IBM');
+select cs_window_max_time(Close,Day,'3 days') from Quote_get('IBM');
+select cs_window_min_time(Close,Day,'3 days') from Quote_get('IBM');
+select cs_window_sum_time(Close,Day,'3 days') from Quote_get('IBM');
+select cs_window_avg_time(Close,Day,'3 days') from Quote_get('IBM');
+select cs_window_var_time(Close,Day,'3 days') from Quote_get('IBM');
+select cs_window_max_time(Close,Day,'12 hours') from Quote_get('IBM');
+--- Moving window extremums with windows smaller than, equal to and larger than tile
+select cs_window_max('int4:{5,3,8,1,9,2,7,4,6,0}', 3);
+select cs_window_min('int4:{5,3,8,1,9,2,7,4,6,0}', 3);
+select cs_sum(cs_window_max(test_seq(400) * 37 % 101 + 1, 50)), cs_sum(cs_window_min(test_seq(400) * 37 % 101 + 1, 50));
+select cs_sum(cs_window_max(test_seq(400) * 37 % 101 + 1, 128)), cs_sum(cs_window_min(test_seq(400) * 37 % 101 + 1, 128));
+select cs_sum(cs_window_max(test_seq(400) * 37 % 101 + 1, 150)), cs_sum(cs_window_min(test_seq(400) * 37 % 101 + 1, 150));
@@ -1,59 +1,212 @@
 #include <stdlib.h>
+#include <limits.h>
 #include "smp.h"
 
-typedef struct imcs_thread_pool_impl_t 
+/*
+ * Number of iterations of busy loop performed by idle worker (or by thread waiting for job completion) before
+ * it is blocked on semaphore. It allows to avoid expensive sleep/wakeup for short jobs following each other.
+ */
+#define IMCS_POOL_SPIN_COUNT 10000
+
+/*
+ * Value assigned to task counter of completed job: late workers incrementing the counter
+ * will not get task of the job which will be published later in the same slot.
+ */
+#define IMCS_POOL_NO_TASKS (INT_MAX/2)
+
+struct imcs_thread_pool_impl_t;
+
+typedef struct imcs_pool_worker_t
+{
+    struct imcs_thread_pool_impl_t* pool;
+    imcs_thread_t* thread;
+    imcs_semaphore_t* wakeup; /* private semaphore, so that wakeup can not be intercepted by other worker */
+    int parked;               /* worker is blocked on "wakeup" semaphore, protected by pool "sync" */
+    int id;
+    int cpu;                  /* CPU to which worker is bound or -1 */
+} imcs_pool_worker_t;
+
+/*
+ * Job submitted to the pool. Job consists of n_tasks tasks which are picked by workers.
+ * Several jobs can be executed concurrently, in this case workers interleave their tasks.
+ */
+typedef struct imcs_pool_job_t
+{
+    imcs_job_t job;
+    void* arg;
+    int n_tasks;
+    volatile int next_task;
+    volatile int pending;  /* number of not completed tasks */
+    volatile int active;   /* job is published and its tasks can be picked by workers */
+    volatile int users;    /* number of workers inspecting this slot: slot can not be reused until it is zero */
+    int waiting;           /* thread is blocked on "finish" semaphore waiting for completion of this job, protected by "sync" */
+    int used;              /* slot is allocated (accessed only by thread submitting jobs) */
+} imcs_pool_job_t;
+
+typedef struct imcs_thread_pool_impl_t
 {
     imcs_thread_pool_t vtab;
     int n_workers;
-    imcs_thread_t** workers;
-    void* arg;
-    imcs_job_t job;
-    int work_id;
-    imcs_mutex_t* mutex;
+    imcs_pool_worker_t* workers;
+    imcs_pool_job_t jobs[IMCS_POOL_MAX_JOBS];
+    volatile int epoch;    /* incremented each time new job is published */
+    int n_parked;          /* number of parked workers, protected by "sync" */
     imcs_mutex_t* sync;
-    imcs_semaphore_t* start;
     imcs_semaphore_t* finish;
-    int stop;
+    int spin_count;        /* IMCS_POOL_SPIN_COUNT or 0 if there is no spare CPU to spin on */
+    volatile int stop;
 } imcs_thread_pool_impl_t;
 
 
-static void imcs_thread_pool_worker(imcs_thread_pool_impl_t* pool)
+/* Find task of some of active jobs and execute it. Returns 0 if there are no pending tasks. */
+static int imcs_thread_pool_run_task(imcs_thread_pool_impl_t* pool, int start)
 {
-    int work_id;
-    pool->sync->lock(pool->sync);
-    while (1) { 
-        pool->start->wait(pool->start, pool->sync, 1, IMCS_TM_INFINITE);
+    int i;
+    for (i = 0; i < IMCS_POOL_MAX_JOBS; i++) {
+        imcs_pool_job_t* job = &pool->jobs[(start + i) % IMCS_POOL_MAX_JOBS];
+        if (job->active) {
+            int task_id = IMCS_POOL_NO_TASKS;
+            int n_tasks = 0;
+            IMCS_ATOMIC_FETCH_ADD(&job->users, 1);
+            if (job->active) {
+                task_id = IMCS_ATOMIC_FETCH_ADD(&job->next_task, 1);
+                n_tasks = job->n_tasks;
+            }
+            IMCS_ATOMIC_FETCH_ADD(&job->users, -1);
+            if (task_id < n_tasks) { /* slot can not be reused until this task is completed */
+                job->job(task_id, n_tasks, job->arg);
+                if (IMCS_ATOMIC_FETCH_ADD(&job->pending, -1) == 1) { /* last task */
+                    pool->sync->lock(pool->sync);
+                    if (job->waiting) {
+                        pool->finish->signal(pool->finish, 1);
+                    }
+                    pool->sync->unlock(pool->sync);
+                }
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void imcs_thread_pool_worker(imcs_pool_worker_t* worker)
+{
+    imcs_thread_pool_impl_t* pool = worker->pool;
+    if (worker->cpu >= 0) {
+        imcs_bind_thread(worker->cpu);
+    }
+    while (1) {
+        int spin;
+        int epoch = pool->epoch;
+        IMCS_MEMORY_BARRIER();
         if (pool->stop) {
-            pool->finish->signal(pool->finish, 1); 
-            pool->sync->unlock(pool->sync);
             break;
         }
-        work_id = pool->work_id++;
-        pool->sync->unlock(pool->sync);
-        pool->job(work_id, pool->n_workers, pool->arg);    
-        pool->sync->lock(pool->sync);
-        pool->finish->signal(pool->finish, 1);
+        if (imcs_thread_pool_run_task(pool, worker->id)) {
+            continue;
+        }
+        /* No tasks: wait until new job is published */
+        for (spin = 0; pool->epoch == epoch && spin < pool->spin_count; spin++) {
+            IMCS_CPU_RELAX();
+        }
+        if (pool->epoch == epoch) {
+            pool->sync->lock(pool->sync);
+            while (pool->epoch == epoch) {
+                worker->parked = 1;
+                pool->n_parked += 1;
+                worker->wakeup->wait(worker->wakeup, pool->sync, 1, IMCS_TM_INFINITE);
+            }
+            pool->sync->unlock(pool->sync);
+        }
     }
-} 
-    
-static void imcs_thread_pool_wait(imcs_thread_pool_impl_t* pool)
+}
+
+/* Notify workers about new job: spinning workers will notice it themselves, parked workers have to be woken up */
+static void imcs_thread_pool_notify(imcs_thread_pool_impl_t* pool, int n_wakeups)
 {
+    int i;
+    IMCS_ATOMIC_FETCH_ADD(&pool->epoch, 1);
     pool->sync->lock(pool->sync);
-    pool->work_id = 0;
-    pool->start->signal(pool->start, pool->n_workers);
-    pool->finish->wait(pool->finish, pool->sync, pool->n_workers, IMCS_TM_INFINITE);
+    for (i = 0; n_wakeups > 0 && pool->n_parked != 0; i++) {
+        imcs_pool_worker_t* worker = &pool->workers[i];
+        if (worker->parked) {
+            worker->parked = 0;
+            pool->n_parked -= 1;
+            n_wakeups -= 1;
+            worker->wakeup->signal(worker->wakeup, 1);
+        }
+    }
     pool->sync->unlock(pool->sync);
+}
+
+static int imcs_thread_pool_publish(imcs_thread_pool_impl_t* pool, imcs_job_t job, void* arg, int n_tasks, int n_reserved)
+{
+    int i, n_free = 0;
+    imcs_pool_job_t* slot = NULL;
+    for (i = 0; i < IMCS_POOL_MAX_JOBS; i++) {
+        if (!pool->jobs[i].used) {
+            if (slot == NULL) {
+                slot = &pool->jobs[i];
+            }
+            n_free += 1;
+        }
+    }
+    if (n_free <= n_reserved) {
+        return -1;
+    }
+    if (n_tasks <= 0 || n_tasks > pool->n_workers) {
+        n_tasks = pool->n_workers;
+    }
+    slot->used = 1;
+    slot->job = job;
+    slot->arg = arg;
+    slot->n_tasks = n_tasks;
+    slot->pending = n_tasks;
+    slot->waiting = 0;
+    IMCS_MEMORY_BARRIER();
+    slot->next_task = 0;
+    slot->active = 1;
+    imcs_thread_pool_notify(pool, n_tasks);
+    return (int)(slot - pool->jobs);
+}
 
+static int imcs_thread_pool_submit(struct imcs_thread_pool_t* self, imcs_job_t job, void* arg, int n_threads)
+{
+    /* One slot is reserved for imcs_thread_pool_execute, so that it never has to wait for free slot */
+    return imcs_thread_pool_publish((imcs_thread_pool_impl_t*)self, job, arg, n_threads, 1);
 }
-int counters[4] = {0,0,0,0};
-static void imcs_thread_pool_execute(struct imcs_thread_pool_t* self, imcs_job_t job, void* arg)
+
+static void imcs_thread_pool_wait(struct imcs_thread_pool_t* self, int handle)
 {
     imcs_thread_pool_impl_t* pool = (imcs_thread_pool_impl_t*)self;
-    pool->mutex->lock(pool->mutex);
-    pool->job = job;
-    pool->arg = arg;
-    imcs_thread_pool_wait(pool);
-    pool->mutex->unlock(pool->mutex);
+    imcs_pool_job_t* job = &pool->jobs[handle];
+    int spin;
+    for (spin = 0; job->pending != 0 && spin < pool->spin_count; spin++) {
+        IMCS_CPU_RELAX();
+    }
+    if (job->pending != 0) {
+        pool->sync->lock(pool->sync);
+        job->waiting = 1;
+        while (job->pending != 0) {
+            pool->finish->wait(pool->finish, pool->sync, 1, IMCS_TM_INFINITE);
+        }
+        job->waiting = 0;
+        pool->sync->unlock(pool->sync);
+    }
+    /* release slot */
+    job->active = 0;
+    job->next_task = IMCS_POOL_NO_TASKS;
+    IMCS_MEMORY_BARRIER();
+    while (job->users != 0) {
+        IMCS_CPU_RELAX();
+    }
+    job->used = 0;
+}
+
+static void imcs_thread_pool_execute(struct imcs_thread_pool_t* self, imcs_job_t job, void* arg, int n_threads)
+{
+    imcs_thread_pool_impl_t* pool = (imcs_thread_pool_impl_t*)self;
+    imcs_thread_pool_wait(self, imcs_thread_pool_publish(pool, job, arg, n_threads, 0));
 }
 
 static void imcs_thread_pool_destroy(struct imcs_thread_pool_t* self)
@@ -61,13 +214,12 @@ static void imcs_thread_pool_destroy(struct imcs_thread_pool_t* self)
     int i;
     imcs_thread_pool_impl_t* pool = (imcs_thread_pool_impl_t*)self;
     pool->stop = 1;
-    imcs_thread_pool_wait(pool);
-    for (i = 0; i < pool->n_workers; i++) { 
-        pool->workers[i]->join(pool->workers[i]);
-    }    
+    imcs_thread_pool_notify(pool, pool->n_workers);
+    for (i = 0; i < pool->n_workers; i++) {
+        pool->workers[i].thread->join(pool->workers[i].thread);
+        pool->workers[i].wakeup->destroy(pool->workers[i].wakeup);
+    }
     pool->sync->destroy(pool->sync);
-    pool->mutex->destroy(pool->sync);
-    pool->start->destroy(pool->start);
     pool->finish->destroy(pool->finish);
     free(pool->workers);
     free(pool);
@@ -79,35 +231,53 @@ static int imcs_thread_pool_get_number_of_threads(struct imcs_thread_pool_t* sel
     return pool->n_workers;
 }
 
-static void imcs_thread_pool_merge(struct imcs_thread_pool_t* self, imcs_job_callback_t callback, void* result)
+static void imcs_thread_pool_merge(struct imcs_thread_pool_t* self, imcs_job_callback_t callback, void* arg, void* result)
 {
     imcs_thread_pool_impl_t* pool = (imcs_thread_pool_impl_t*)self;
     pool->sync->lock(pool->sync);
-    callback(pool->arg, result);
+    callback(arg, result);
     pool->sync->unlock(pool->sync);
 }
 
-struct imcs_thread_pool_t* imcs_create_thread_pool(int n_threads)
+struct imcs_thread_pool_t* imcs_create_thread_pool(int n_threads, imcs_bool bind_threads)
 {
     int i;
     imcs_thread_pool_impl_t* pool = (imcs_thread_pool_impl_t*)malloc(sizeof(imcs_thread_pool_impl_t));
-    if (n_threads == 0) { 
-        n_threads = imcs_get_number_of_cpus();
+    int n_cpus = imcs_get_number_of_cpus();
+    if (n_threads == 0) {
+        n_threads = n_cpus;
     }
-    pool->workers = (imcs_thread_t**)malloc(sizeof(imcs_thread_t*)*n_threads);
+    pool->workers = (imcs_pool_worker_t*)malloc(sizeof(imcs_pool_worker_t)*n_threads);
     pool->sync = imcs_create_mutex();
-    pool->mutex = imcs_create_mutex();
-    pool->start = imcs_create_semaphore(0);
     pool->finish = imcs_create_semaphore(0);
     pool->n_workers = n_threads;
     pool->vtab.execute = imcs_thread_pool_execute;
+    pool->vtab.submit = imcs_thread_pool_submit;
+    pool->vtab.wait = imcs_thread_pool_wait;
     pool->vtab.merge = imcs_thread_pool_merge;
     pool->vtab.destroy = imcs_thread_pool_destroy;
     pool->vtab.get_number_of_threads = imcs_thread_pool_get_number_of_threads;
 
+    for (i = 0; i < IMCS_POOL_MAX_JOBS; i++) {
+        pool->jobs[i].used = 0;
+        pool->jobs[i].active = 0;
+        pool->jobs[i].users = 0;
+        pool->jobs[i].pending = 0;
+        pool->jobs[i].next_task = IMCS_POOL_NO_TASKS;
+    }
+    pool->epoch = 0;
+    pool->n_parked = 0;
+    pool->spin_count = n_cpus > 1 ? IMCS_POOL_SPIN_COUNT : 0;
     pool->stop = 0;
-    for (i = 0; i < n_threads; i++) { 
-        pool->workers[i] = imcs_create_thread((imcs_thread_proc_t)imcs_thread_pool_worker, pool);
+    for (i = 0; i < n_threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        pool->workers[i].cpu = bind_threads ? (int)((long)i*n_cpus/n_threads) % n_cpus : -1; /* spread workers between all CPUs (and so NUMA nodes) */
+        pool->workers[i].parked = 0;
+        pool->workers[i].wakeup = imcs_create_semaphore(0);
+    }
+    for (i = 0; i < n_threads; i++) {
+        pool->workers[i].thread = imcs_create_thread((imcs_thread_proc_t)imcs_thread_pool_worker, &pool->workers[i]);
     }
     return (struct imcs_thread_pool_t*)pool;
 }